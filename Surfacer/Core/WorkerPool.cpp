@@ -0,0 +1,162 @@
+//
+//  WorkerPool.cpp
+//  Surfacer
+//
+//  Created by Shamyl Zakariya on 10/17/12.
+//  Copyright 2012 TomorrowPlusX. All rights reserved.
+//
+
+#include "WorkerPool.h"
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace core {
+
+#pragma mark -
+#pragma mark WorkerPoolImpl
+
+class WorkerPoolImpl
+{
+	public:
+
+		WorkerPoolImpl( int threadCount ):
+			_running(0),
+			_stopping(false)
+		{
+			if ( threadCount < 0 )
+			{
+				threadCount = int(std::thread::hardware_concurrency()) - 1;
+			}
+
+			for ( int i = 0; i < threadCount; i++ )
+			{
+				_threads.push_back( std::thread( &WorkerPoolImpl::_work, this ));
+			}
+		}
+
+		~WorkerPoolImpl()
+		{
+			{
+				std::unique_lock< std::mutex > lock( _mutex );
+				_stopping = true;
+			}
+
+			_jobQueued.notify_all();
+
+			for ( std::size_t i = 0, N = _threads.size(); i < N; i++ )
+			{
+				_threads[i].join();
+			}
+		}
+
+		void add( const WorkerPool::job_type &job )
+		{
+			{
+				std::unique_lock< std::mutex > lock( _mutex );
+				_jobs.push_back( job );
+			}
+
+			_jobQueued.notify_one();
+		}
+
+		void wait()
+		{
+			std::unique_lock< std::mutex > lock( _mutex );
+
+			while( !_jobs.empty() )
+			{
+				_runNext( lock );
+			}
+
+			while( _running > 0 )
+			{
+				_jobsFinished.wait( lock );
+			}
+		}
+
+		std::size_t threadCount() const { return _threads.size(); }
+
+	private:
+
+		void _work()
+		{
+			std::unique_lock< std::mutex > lock( _mutex );
+
+			while( true )
+			{
+				while( _jobs.empty() && !_stopping )
+				{
+					_jobQueued.wait( lock );
+				}
+
+				if ( _jobs.empty() ) return;
+
+				_runNext( lock );
+			}
+		}
+
+		//
+		//	Pop the next job and run it with the lock released. Caller holds the lock, and
+		//	the queue must not be empty.
+		//
+
+		void _runNext( std::unique_lock< std::mutex > &lock )
+		{
+			WorkerPool::job_type job;
+			job.swap( _jobs.front() );
+			_jobs.pop_front();
+			_running++;
+
+			lock.unlock();
+			job();
+			lock.lock();
+
+			if ( --_running == 0 && _jobs.empty() )
+			{
+				_jobsFinished.notify_all();
+			}
+		}
+
+	private:
+
+		std::vector< std::thread > _threads;
+		std::deque< WorkerPool::job_type > _jobs;
+		std::mutex _mutex;
+		std::condition_variable _jobQueued, _jobsFinished;
+		std::size_t _running;
+		bool _stopping;
+
+};
+
+#pragma mark -
+#pragma mark WorkerPool
+
+WorkerPool::WorkerPool( int threadCount ):
+	_impl( new WorkerPoolImpl( threadCount ))
+{}
+
+WorkerPool::~WorkerPool()
+{
+	delete _impl;
+}
+
+void WorkerPool::add( const job_type &job )
+{
+	_impl->add( job );
+}
+
+void WorkerPool::wait()
+{
+	_impl->wait();
+}
+
+std::size_t WorkerPool::threadCount() const
+{
+	return _impl->threadCount();
+}
+
+} // end namespace core
@@ -0,0 +1,71 @@
+#pragma once
+
+//
+//  WorkerPool.h
+//  Surfacer
+//
+//  Created by Shamyl Zakariya on 10/17/12.
+//  Copyright 2012 TomorrowPlusX. All rights reserved.
+//
+
+#include <functional>
+
+namespace core {
+
+class WorkerPoolImpl;
+
+/**
+	@class WorkerPool
+	A fixed set of worker threads which execute queued jobs.
+
+	Jobs are queued with add() and run in no particular order. wait() blocks until every queued job
+	has finished, and the calling thread executes jobs while it waits, so a pool with zero worker threads
+	simply runs every job on the thread calling wait().
+
+	Jobs must not throw, and must not call add() or wait() on the pool running them.
+*/
+class WorkerPool
+{
+	public:
+
+		typedef std::function< void() > job_type;
+
+	public:
+
+		/**
+			Create a WorkerPool with @a threadCount worker threads. If @a threadCount is negative,
+			one fewer than the number of hardware threads is used, since the thread calling wait()
+			also executes jobs.
+		*/
+		explicit WorkerPool( int threadCount = -1 );
+		~WorkerPool();
+
+		/**
+			Queue @a job for execution by a worker thread
+		*/
+		void add( const job_type &job );
+
+		/**
+			Execute queued jobs on the calling thread until none remain, then block until
+			jobs running on worker threads have finished.
+		*/
+		void wait();
+
+		/**
+			Get the number of worker threads, not counting the thread calling wait()
+		*/
+		std::size_t threadCount() const;
+
+	private:
+
+		// non-copyable
+		WorkerPool( const WorkerPool & );
+		WorkerPool &operator = ( const WorkerPool & );
+
+	private:
+
+		WorkerPoolImpl *_impl;
+
+};
+
+} // end namespace core
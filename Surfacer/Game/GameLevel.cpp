@@ -166,6 +166,7 @@ void GameLevel::ready()
 			.connect( this, &GameLevel::_collision_Monster_Object );
 
 		terrain()->cutPerformed.connect( this, &GameLevel::_terrainWasCut );	
+		terrain()->debrisRetired.connect( this, &GameLevel::_terrainDebrisRetired );
 	}
 }
 
@@ -510,6 +511,24 @@ void GameLevel::_terrainWasCut( const Vec2rVec &positions, TerrainCutType::cut_t
 	}
 }
 
+void GameLevel::_terrainDebrisRetired( const Vec2rVec &positions, const Vec2r &velocity )
+{
+	//
+	//	Crumble retired debris to dust. Large chunks emit from a sampling of their voxels,
+	//	so retiring one doesn't flood the dust system
+	//
+
+	const std::size_t 
+		MaxBursts = 32,
+		Stride = std::max< std::size_t >(( positions.size() + MaxBursts - 1 ) / MaxBursts, 1 );
+
+	UniversalParticleSystemController::Emitter *emitter = _dustEffect->defaultEmitter();
+	for ( std::size_t i = 0; i < positions.size(); i += Stride )
+	{
+		emitter->emit( 4, positions[i], velocity );
+	}
+}
+
 void GameLevel::_createEffectEmitters()
 {
 	const real 
@@ -146,6 +146,7 @@ class GameLevel : public core::Level {
 		void _collision_Monster_Monster( const core::collision_info &info, bool &discard );		
 		void _collision_Monster_Object( const core::collision_info &info, bool &discard );		
 		void _terrainWasCut( const Vec2rVec &positions, TerrainCutType::cut_type cutType );
+		void _terrainDebrisRetired( const Vec2rVec &positions, const Vec2r &velocity );
 		void _createEffectEmitters();
 		
 		
@@ -0,0 +1,127 @@
+#pragma once
+
+//
+//  ComponentLabeling.h
+//  Surfacer
+//
+//  Created by Shamyl Zakariya on 10/17/12.
+//  Copyright 2012 TomorrowPlusX. All rights reserved.
+//
+
+#include "PackedVoxelStore.h"
+
+#include <vector>
+
+namespace game { namespace terrain { namespace labeling {
+
+namespace detail {
+
+	inline int find_root( std::vector< int > &parents, int label )
+	{
+		while( parents[label] != label )
+		{
+			// path halving
+			parents[label] = parents[ parents[label] ];
+			label = parents[label];
+		}
+
+		return label;
+	}
+
+	// join two label sets, keeping the lower label as root
+	inline void unite( std::vector< int > &parents, int a, int b )
+	{
+		a = find_root( parents, a );
+		b = find_root( parents, b );
+
+		if ( a < b ) parents[b] = a;
+		else if ( b < a ) parents[a] = b;
+	}
+
+}
+
+/**
+	Two-pass scanline union-find labeling of the connected components of @a store.
+
+	Voxel i is a member of some component if Test::operator(int) returns true for it and it has at least one link.
+	Members are connected through the store's connectivity mask - the same criteria floodfill::visit follows, so
+	each component is exactly the set of voxels one fill from any of its members would visit.
+
+	The first pass walks the store in index order, giving each member the label of its linked, already-scanned
+	neighbors ( west, and the three in the previous row ), recording equivalences as neighbors' labels differ.
+	The second resolves equivalences. On return, @a labels holds, per voxel, -1 for non-members or the
+	component id, numbered from zero in index order of each component's first voxel.
+
+	No state is shared between calls, so distinct stores may be labeled concurrently.
+
+	Return the number of components.
+*/
+
+template< class T >
+int label( const PackedVoxelStore &store, T &test, std::vector< int > &labels )
+{
+	const int count = store.count();
+	labels.assign( count, -1 );
+
+	//
+	//	The link directions leading to voxels which precede a voxel in index order
+	//
+
+	int previousDirs[4], previousDirCount = 0;
+	for ( int dir = 0; dir < 8; dir++ )
+	{
+		const Vec2i &d = Compass::dir(dir);
+		if ( d.y < 0 || ( d.y == 0 && d.x < 0 )) previousDirs[previousDirCount++] = dir;
+	}
+
+	//
+	//	First pass, provisional labels
+	//
+
+	std::vector< int > parents;
+
+	for ( int i = 0; i < count; i++ )
+	{
+		if ( !store.hasNeighbors(i) || !test(i) ) continue;
+
+		int l = -1;
+		for ( int k = 0; k < previousDirCount; k++ )
+		{
+			const int n = store.neighbor( i, previousDirs[k] );
+			if ( n >= 0 && labels[n] >= 0 )
+			{
+				if ( l < 0 ) l = labels[n];
+				else if ( labels[n] != l ) detail::unite( parents, l, labels[n] );
+			}
+		}
+
+		if ( l < 0 )
+		{
+			l = int(parents.size());
+			parents.push_back( l );
+		}
+
+		labels[i] = l;
+	}
+
+	//
+	//	Second pass, resolve each provisional label to its set's root, and number the roots consecutively
+	//
+
+	std::vector< int > ids( parents.size(), -1 );
+	int components = 0;
+
+	for ( int i = 0; i < count; i++ )
+	{
+		if ( labels[i] < 0 ) continue;
+
+		int &id = ids[ detail::find_root( parents, labels[i] ) ];
+		if ( id < 0 ) id = components++;
+
+		labels[i] = id;
+	}
+
+	return components;
+}
+
+}}} // end namespace game::terrain::labeling
@@ -0,0 +1,221 @@
+//
+//  CookedTerrain.cpp
+//  Surfacer
+//
+//  Created by Shamyl Zakariya on 10/17/12.
+//  Copyright 2012 TomorrowPlusX. All rights reserved.
+//
+
+#include "CookedTerrain.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace game { namespace terrain { namespace cooked {
+
+namespace {
+
+	const char Magic[4] = { 'S', 'F', 'C', 'T' };
+	const std::size_t Alignment = 8;
+
+	struct crc_table
+	{
+		uint32_t entries[256];
+
+		crc_table()
+		{
+			for ( uint32_t i = 0; i < 256; i++ )
+			{
+				uint32_t c = i;
+				for ( int k = 0; k < 8; k++ )
+				{
+					c = ( c & 1 ) ? 0xEDB88320 ^ ( c >> 1 ) : c >> 1;
+				}
+
+				entries[i] = c;
+			}
+		}
+	};
+
+	const crc_table CrcTable;
+
+}
+
+uint32_t Checksum( const void *bytes, std::size_t length, uint32_t crc )
+{
+	const uint8_t *b = static_cast< const uint8_t* >( bytes );
+
+	crc = ~crc;
+	for ( std::size_t i = 0; i < length; i++ )
+	{
+		crc = CrcTable.entries[ ( crc ^ b[i] ) & 0xFF ] ^ ( crc >> 8 );
+	}
+
+	return ~crc;
+}
+
+bool FileChecksum( const ci::fs::path &path, uint32_t &checksum )
+{
+	FILE *file = fopen( path.string().c_str(), "rb" );
+	if ( !file ) return false;
+
+	uint8_t buffer[ 64 * 1024 ];
+	uint32_t crc = 0;
+	std::size_t count;
+
+	while(( count = fread( buffer, 1, sizeof( buffer ), file )) > 0 )
+	{
+		crc = Checksum( buffer, count, crc );
+	}
+
+	const bool ok = !ferror( file );
+	fclose( file );
+
+	checksum = crc;
+	return ok;
+}
+
+#pragma mark -
+#pragma mark Writer
+
+void Writer::_append( const void *bytes, std::size_t length )
+{
+	if ( length )
+	{
+		const uint8_t *b = static_cast< const uint8_t* >( bytes );
+		_payload.insert( _payload.end(), b, b + length );
+	}
+}
+
+void Writer::_align()
+{
+	_payload.resize( ( _payload.size() + Alignment - 1 ) & ~( Alignment - 1 ), 0 );
+}
+
+bool Writer::save( const ci::fs::path &path, uint32_t sourceChecksum, uint32_t parametersChecksum ) const
+{
+	header h;
+	memset( &h, 0, sizeof( h ));
+	memcpy( h.magic, Magic, sizeof( Magic ));
+	h.version = Version;
+	h.sourceChecksum = sourceChecksum;
+	h.parametersChecksum = parametersChecksum;
+	h.payloadChecksum = Checksum( _payload.empty() ? NULL : &_payload[0], _payload.size() );
+	h.payloadSize = _payload.size();
+
+	FILE *file = fopen( path.string().c_str(), "wb" );
+	if ( !file ) return false;
+
+	bool ok = fwrite( &h, sizeof( h ), 1, file ) == 1;
+	if ( ok && !_payload.empty() )
+	{
+		ok = fwrite( &_payload[0], _payload.size(), 1, file ) == 1;
+	}
+
+	return ( fclose( file ) == 0 ) && ok;
+}
+
+#pragma mark -
+#pragma mark Reader
+
+Reader::Reader():
+	_mapping( NULL ),
+	_mappingSize( 0 ),
+	_payload( NULL ),
+	_cursor( NULL ),
+	_end( NULL ),
+	_ok( false )
+{}
+
+Reader::~Reader()
+{
+	_close();
+}
+
+bool Reader::open( const ci::fs::path &path, uint32_t sourceChecksum, uint32_t parametersChecksum )
+{
+	_close();
+
+	const int fd = ::open( path.string().c_str(), O_RDONLY );
+	if ( fd < 0 ) return false;
+
+	struct stat info;
+	if ( fstat( fd, &info ) == 0 && std::size_t( info.st_size ) >= sizeof( header ))
+	{
+		void *mapping = mmap( NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+		if ( mapping != MAP_FAILED )
+		{
+			_mapping = mapping;
+			_mappingSize = info.st_size;
+		}
+	}
+
+	// the mapping holds its own reference to the file
+	::close( fd );
+	if ( !_mapping ) return false;
+
+	header h;
+	memcpy( &h, _mapping, sizeof( h ));
+
+	if ( memcmp( h.magic, Magic, sizeof( Magic )) != 0 ||
+	     h.version != Version ||
+	     h.sourceChecksum != sourceChecksum ||
+	     h.parametersChecksum != parametersChecksum ||
+	     h.payloadSize != _mappingSize - sizeof( header ))
+	{
+		_close();
+		return false;
+	}
+
+	_payload = _cursor = static_cast< const uint8_t* >( _mapping ) + sizeof( header );
+	_end = _payload + h.payloadSize;
+
+	if ( Checksum( _payload, h.payloadSize ) != h.payloadChecksum )
+	{
+		_close();
+		return false;
+	}
+
+	_ok = true;
+	return true;
+}
+
+const uint8_t *Reader::_take( std::size_t length )
+{
+	if ( !_ok || std::size_t( _end - _cursor ) < length )
+	{
+		_ok = false;
+		return NULL;
+	}
+
+	const uint8_t *bytes = _cursor;
+	_cursor += length;
+	return bytes;
+}
+
+void Reader::_align()
+{
+	if ( !_ok ) return;
+
+	const std::size_t offset = _cursor - _payload, aligned = ( offset + Alignment - 1 ) & ~( Alignment - 1 );
+	_take( aligned - offset );
+}
+
+void Reader::_close()
+{
+	if ( _mapping )
+	{
+		munmap( _mapping, _mappingSize );
+	}
+
+	_mapping = NULL;
+	_mappingSize = 0;
+	_payload = _cursor = _end = NULL;
+	_ok = false;
+}
+
+}}} // end namespace game::terrain::cooked
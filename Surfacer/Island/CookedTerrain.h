@@ -0,0 +1,174 @@
+#pragma once
+
+//
+//  CookedTerrain.h
+//  Surfacer
+//
+//  Created by Shamyl Zakariya on 10/17/12.
+//  Copyright 2012 TomorrowPlusX. All rights reserved.
+//
+
+#include "Common.h"
+
+#include <cinder/Filesystem.h>
+#include <cstring>
+#include <vector>
+
+namespace game { namespace terrain { namespace cooked {
+
+/**
+	A cooked terrain file holds a Terrain's state as it stands once loading has finished - voxel planes, island
+	membership, perimeters, triangulations and greebling - so a level can start without decoding its level
+	image or tessellating. See Terrain::cook.
+
+	The file is a header followed by a payload. Arrays in the payload are 8-byte aligned so they can be used
+	in place from a memory mapping. The header records a checksum of the source level image file and of the
+	Terrain::init parameters the result depends on; a file which doesn't match either is stale and is ignored.
+	Values are written in native byte order and layout; the version must be bumped if any cooked type changes.
+*/
+
+const uint32_t Version = 2;
+
+struct header
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t sourceChecksum;
+	uint32_t parametersChecksum;
+	uint32_t payloadChecksum;
+	uint32_t reserved;
+	uint64_t payloadSize;
+};
+
+/**
+	CRC-32 of @a length bytes at @a bytes, continuing from @a crc
+*/
+uint32_t Checksum( const void *bytes, std::size_t length, uint32_t crc = 0 );
+
+/**
+	Compute the Checksum of the contents of file @a path, returning false if it can't be read
+*/
+bool FileChecksum( const ci::fs::path &path, uint32_t &checksum );
+
+/**
+	@class Writer
+	Accumulates a cooked payload in memory, and saves it with its header
+*/
+class Writer
+{
+	public:
+
+		Writer(){}
+
+		template< class T >
+		void write( const T &value )
+		{
+			_append( &value, sizeof( T ));
+		}
+
+		/**
+			Write the element count of @a values, then its elements as an aligned array
+		*/
+		template< class T >
+		void write( const std::vector< T > &values )
+		{
+			write( uint32_t( values.size() ));
+			writeArray( values.empty() ? NULL : &values[0], values.size() );
+		}
+
+		/**
+			Write @a count elements from @a values as an aligned array
+		*/
+		template< class T >
+		void writeArray( const T *values, std::size_t count )
+		{
+			_align();
+			_append( values, count * sizeof( T ));
+		}
+
+		/**
+			Write the header and payload to @a path, returning false on failure
+		*/
+		bool save( const ci::fs::path &path, uint32_t sourceChecksum, uint32_t parametersChecksum ) const;
+
+	private:
+
+		void _append( const void *bytes, std::size_t length );
+		void _align();
+
+	private:
+
+		std::vector< uint8_t > _payload;
+};
+
+/**
+	@class Reader
+	Memory-maps a cooked file, validates it, and reads back what Writer wrote, in order.
+	Reads past the end of the payload fail, and mark the Reader as not ok.
+*/
+class Reader
+{
+	public:
+
+		Reader();
+		~Reader();
+
+		/**
+			Map the file at @a path. Returns true if it's a cooked file of the current version, cooked from
+			a source with @a sourceChecksum with parameters matching @a parametersChecksum, and its payload is intact.
+		*/
+		bool open( const ci::fs::path &path, uint32_t sourceChecksum, uint32_t parametersChecksum );
+
+		bool ok() const { return _ok; }
+
+		template< class T >
+		bool read( T &value )
+		{
+			const uint8_t *bytes = _take( sizeof( T ));
+			if ( bytes ) memcpy( &value, bytes, sizeof( T ));
+			return bytes != NULL;
+		}
+
+		template< class T >
+		bool read( std::vector< T > &values )
+		{
+			uint32_t count = 0;
+			if ( !read( count )) return false;
+
+			const T *array = readArray< T >( count );
+			if ( !array ) return false;
+
+			values.assign( array, array + count );
+			return true;
+		}
+
+		/**
+			Get a pointer to @a count elements in the mapping, which remains valid until the Reader is destroyed.
+			Returns NULL if the payload is too short.
+		*/
+		template< class T >
+		const T *readArray( std::size_t count )
+		{
+			_align();
+			return reinterpret_cast< const T* >( _take( count * sizeof( T )));
+		}
+
+	private:
+
+		// non-copyable
+		Reader( const Reader & );
+		Reader &operator = ( const Reader & );
+
+		const uint8_t *_take( std::size_t length );
+		void _align();
+		void _close();
+
+	private:
+
+		void *_mapping;
+		std::size_t _mappingSize;
+		const uint8_t *_payload, *_cursor, *_end;
+		bool _ok;
+};
+
+}}} // end namespace game::terrain::cooked
@@ -10,6 +10,7 @@
  */
 
 #include "Terrain.h"
+#include "PackedVoxelStore.h"
 
 #include <list>
 #include <set>
@@ -109,4 +110,69 @@ bool visit( Voxel *origin, V &visitor, T &test )
 }
 
 
+/**
+	PackedVoxelStore variant of visit(). Voxels are addressed by index, and neighbors are followed through the
+	store's connectivity mask. Test::operator(int) will be passed -1 for unlinked neighbors.
+	
+	Visited voxels are marked in @a visited ( resized to one byte per voxel in the store if needed ) rather than with
+	the global visit tag, so concurrent fills over different stores are safe.
+
+	Return true if all reachable nodes were reached without the visitor aborting search
+*/
+
+template< class V, class T >
+bool visit( const PackedVoxelStore &store, int origin, V &visitor, T &test, std::vector< uint8_t > &visited )
+{
+	if ( visited.size() != std::size_t(store.count()) ) visited.assign( store.count(), 0 );
+
+	std::queue<int> Q;
+	
+	if ( !test(origin)) return true;
+	Q.push( origin );
+		
+	while( !Q.empty() )
+	{
+		int n = Q.front();
+		Q.pop();
+		
+		if ( test(n) && !visited[n] )
+		{
+			int w = n;
+			while( test( store.neighbor( w, Compass::West )))
+			{
+				w = store.neighbor( w, Compass::West );
+			}
+
+			// iterate from westernmost reachable to easternmost reachable
+			for ( int i = w; test(i); i = store.neighbor( i, Compass::East ))
+			{
+				if ( !visited[i] )
+				{
+					visited[i] = 1;
+					if ( !visitor( i )) return false;
+					
+					const int 
+						nw = store.neighbor( i, Compass::NorthWest ),
+						n = store.neighbor( i, Compass::North ),
+						ne = store.neighbor( i, Compass::NorthEast ),
+						sw = store.neighbor( i, Compass::SouthWest ),
+						s = store.neighbor( i, Compass::South ),
+						se = store.neighbor( i, Compass::SouthEast );
+
+					if ( test(nw) && !visited[nw] ) Q.push( nw );
+					if ( test(n ) && !visited[n ] ) Q.push( n  );
+					if ( test(ne) && !visited[ne] ) Q.push( ne );
+
+					if ( test(sw) && !visited[sw] ) Q.push( sw );
+					if ( test(s ) && !visited[s ] ) Q.push( s  );
+					if ( test(se) && !visited[se] ) Q.push( se );
+				}
+			}
+		}		
+	}
+	
+	return true;
+}
+
+
 }}} // end namespace game::terrain::floodfill
\ No newline at end of file
@@ -9,6 +9,15 @@
 //
 
 #include "Common.h"
+#include <cstring>
+#include <algorithm>
+
+#if defined(__SSE2__)
+	#include <emmintrin.h>
+	#define MARCHING_SQUARES_SSE2 1
+#else
+	#define MARCHING_SQUARES_SSE2 0
+#endif
 
 ///////////////////////////////////////////////////////////////////////
 // Adapted from "Polygonising A Scalar Field" by Paul Bourke
@@ -65,10 +74,23 @@ namespace marching_squares
 	{
 		Vec2r a,b;
 		
-		segment( void ) {}		
-		segment( const Vec2r &A, const Vec2r &B	):a(A),b(B){}		
+		// ids of the cell edges a and b lie on, when marched by marchGrid(); see edgeId(). Otherwise -1.
+		int edgeA, edgeB;
+		
+		segment( void ):edgeA(-1),edgeB(-1) {}		
+		segment( const Vec2r &A, const Vec2r &B	):a(A),b(B),edgeA(-1),edgeB(-1){}		
 	};
 	
+	/**
+		Get the id of a cell edge in a grid with @a stride samples per row. The horizontal edge from sample x,y to x+1,y
+		has id 2*(y*stride+x), and the vertical edge from x,y to x,y+1 has id 2*(y*stride+x)+1.
+		Every vertex marchGrid() generates lies on exactly one cell edge, and is shared by the two cells bordering that edge.
+	*/
+	inline int edgeId( int x, int y, int stride, bool vertical )
+	{
+		return 2 * ( y * stride + x ) + ( vertical ? 1 : 0 );
+	}
+	
 	#pragma mark -
 	#pragma mark MarchingSquares
 
@@ -247,4 +269,570 @@ namespace marching_squares
 		}	
 	}
 
+
+	#pragma mark -
+	#pragma mark Row Marching
+	
+	/**
+		@class isolevel
+		A compile-time isolevel of NUMERATOR / DENOMINATOR, in the 0->1 range. 
+		Used by marchGrid() so the per-sample threshold test can be folded to a constant for each grid type.
+	*/
+	template< int NUMERATOR, int DENOMINATOR >
+	struct isolevel
+	{
+		enum {
+			Numerator = NUMERATOR,
+			Denominator = DENOMINATOR
+		};
+		
+		static inline real value() { return real(NUMERATOR) / real(DENOMINATOR); }
+	};
+
+	/**
+		@class scalar_grid
+		A contiguous, row-major grid of samples for marchGrid(). Samples are either uint8_t, where 255 represents 1, or float in the 0->1 range.
+		Each row is padded so row kernels can read a full SIMD register past the last sample without bounds checks.
+		
+		The grid's origin is the coordinate of sample (0,0) in the space segments are emitted in.
+	*/
+	template< class T >
+	class scalar_grid
+	{
+		public:
+		
+			enum { Padding = 16 };
+			
+			typedef T value_type;
+		
+			scalar_grid():
+				_width(0),
+				_height(0),
+				_stride(0)
+			{}
+			
+			/**
+				Size the grid to width * height samples, all zero
+			*/
+			void set( const Vec2i &origin, int width, int height )
+			{
+				_origin = origin;
+				_width = width;
+				_height = height;
+				_stride = width + Padding;
+				_samples.assign( std::size_t(_stride) * std::size_t(height), T(0) );
+			}
+			
+			const Vec2i &origin() const { return _origin; }
+			int width() const { return _width; }
+			int height() const { return _height; }
+			int stride() const { return _stride; }
+			
+			inline T *row( int y ) { return &(_samples[ y * _stride ]); }
+			inline const T *row( int y ) const { return &(_samples[ y * _stride ]); }
+
+			/**
+				Get a sample by grid-local coordinate
+			*/
+			inline T &operator()( int x, int y ) { return _samples[ y * _stride + x ]; }
+			inline T operator()( int x, int y ) const { return _samples[ y * _stride + x ]; }
+		
+		private:
+		
+			Vec2i _origin;
+			int _width, _height, _stride;
+			std::vector< T > _samples;
+	};
+	
+	typedef scalar_grid< uint8_t > byte_grid;
+	typedef scalar_grid< float > float_grid;
+	
+	/**
+		@class row_kernel
+		Per-row classification and edge interpolation for marchGrid(), for grid sample type T and isolevel ISO.
+		
+		classify() computes the square index ( as in Polygonise ) of @a count cells spanning sample rows 
+		@a r0 and @a r1, and returns the number of cells which will emit segments.
+		
+		interpolate() computes, for @a count edges from samples @a a[i] to @a b[i], the parametric position 
+		along the edge where the isosurface crosses it. Edges which aren't crossed get garbage, but never NaN.
+	*/
+	template< class T, class ISO >
+	struct row_kernel
+	{
+		static inline bool below( T v ) { return v < T(ISO::value()); }
+		static inline float level() { return float( ISO::value() ); }
+		
+		static int classify( const T *r0, const T *r1, int count, uint8_t *cases )
+		{
+			int active = 0;
+			for ( int x = 0; x < count; x++ )
+			{
+				const uint8_t c = 
+					( below( r0[x]   ) ? 1 : 0 ) |
+					( below( r0[x+1] ) ? 2 : 0 ) |
+					( below( r1[x+1] ) ? 4 : 0 ) |
+					( below( r1[x]   ) ? 8 : 0 );
+					
+				cases[x] = c;
+				active += ( c != 0 && c != 15 ) ? 1 : 0;
+			}
+			
+			return active;
+		}
+		
+		static void interpolate( const T *a, const T *b, int count, float *mu )
+		{
+			const float iso = level();
+			for ( int i = 0; i < count; i++ )
+			{
+				const float va = float(a[i]), delta = float(b[i]) - va;
+				mu[i] = ( iso - va ) / ( delta != 0 ? delta : 1.0f );
+			}
+		}
+	};
+	
+	template< class ISO >
+	struct row_kernel< uint8_t, ISO >
+	{
+		enum {
+			// a byte sample v is below the isolevel N/D when v/255 < N/D, e.g., when v < ceil(255N/D)
+			Threshold = ( 255 * ISO::Numerator + ISO::Denominator - 1 ) / ISO::Denominator
+		};
+
+		static inline bool below( uint8_t v ) { return v < Threshold; }
+		static inline float level() { return float( 255 * ISO::value() ); }
+
+		static int classify( const uint8_t *r0, const uint8_t *r1, int count, uint8_t *cases )
+		{
+			int x = 0, active = 0;
+
+			#if MARCHING_SQUARES_SSE2
+			{
+				//
+				//	v < Threshold is equivalent to min(v,Threshold-1) == v, which sidesteps SSE2's lack of an unsigned byte compare.
+				//	The scratch grid's row padding makes the 16-byte reads at x+1 safe.
+				//
+
+				const __m128i
+					ThresholdMinusOne = _mm_set1_epi8( char( Threshold - 1 )),
+					Bit1 = _mm_set1_epi8(1),
+					Bit2 = _mm_set1_epi8(2),
+					Bit4 = _mm_set1_epi8(4),
+					Bit8 = _mm_set1_epi8(8),
+					Full = _mm_set1_epi8(15),
+					Zero = _mm_setzero_si128();
+
+				for ( ; x + 16 <= count; x += 16 )
+				{
+					const __m128i
+						a = _mm_loadu_si128( (const __m128i*)( r0 + x )),
+						b = _mm_loadu_si128( (const __m128i*)( r0 + x + 1 )),
+						c = _mm_loadu_si128( (const __m128i*)( r1 + x + 1 )),
+						d = _mm_loadu_si128( (const __m128i*)( r1 + x ));
+						
+					const __m128i square = _mm_or_si128( 
+						_mm_or_si128(
+							_mm_and_si128( _mm_cmpeq_epi8( _mm_min_epu8( a, ThresholdMinusOne ), a ), Bit1 ),
+							_mm_and_si128( _mm_cmpeq_epi8( _mm_min_epu8( b, ThresholdMinusOne ), b ), Bit2 )),
+						_mm_or_si128(
+							_mm_and_si128( _mm_cmpeq_epi8( _mm_min_epu8( c, ThresholdMinusOne ), c ), Bit4 ),
+							_mm_and_si128( _mm_cmpeq_epi8( _mm_min_epu8( d, ThresholdMinusOne ), d ), Bit8 )));
+							
+					_mm_storeu_si128( (__m128i*)( cases + x ), square );
+					
+					const int inactive = _mm_movemask_epi8( _mm_or_si128( _mm_cmpeq_epi8( square, Zero ), _mm_cmpeq_epi8( square, Full )));
+					active += 16 - __builtin_popcount( inactive );
+				}
+			}
+			#endif
+			
+			for ( ; x < count; x++ )
+			{
+				const uint8_t c = 
+					( below( r0[x]   ) ? 1 : 0 ) |
+					( below( r0[x+1] ) ? 2 : 0 ) |
+					( below( r1[x+1] ) ? 4 : 0 ) |
+					( below( r1[x]   ) ? 8 : 0 );
+					
+				cases[x] = c;
+				active += ( c != 0 && c != 15 ) ? 1 : 0;
+			}
+			
+			return active;
+		}
+
+		static void interpolate( const uint8_t *a, const uint8_t *b, int count, float *mu )
+		{
+			const float iso = level();
+			int i = 0;
+
+			#if MARCHING_SQUARES_SSE2
+			{
+				const __m128 
+					Iso = _mm_set1_ps( iso ),
+					One = _mm_set1_ps( 1.0f ),
+					ZeroF = _mm_setzero_ps();
+					
+				const __m128i Zero = _mm_setzero_si128();
+
+				for ( ; i + 4 <= count; i += 4 )
+				{
+					int32_t wa, wb;
+					std::memcpy( &wa, a + i, 4 );
+					std::memcpy( &wb, b + i, 4 );
+					
+					const __m128 
+						va = _mm_cvtepi32_ps( _mm_unpacklo_epi16( _mm_unpacklo_epi8( _mm_cvtsi32_si128( wa ), Zero ), Zero )),
+						vb = _mm_cvtepi32_ps( _mm_unpacklo_epi16( _mm_unpacklo_epi8( _mm_cvtsi32_si128( wb ), Zero ), Zero )),
+						delta = _mm_sub_ps( vb, va ),
+						flat = _mm_cmpeq_ps( delta, ZeroF ),
+						denominator = _mm_or_ps( _mm_andnot_ps( flat, delta ), _mm_and_ps( flat, One ));
+						
+					_mm_storeu_ps( mu + i, _mm_div_ps( _mm_sub_ps( Iso, va ), denominator ));
+				}
+			}
+			#endif
+			
+			for ( ; i < count; i++ )
+			{
+				const float va = float(a[i]), delta = float(b[i]) - va;
+				mu[i] = ( iso - va ) / ( delta != 0 ? delta : 1.0f );
+			}
+		}
+	};
+
+	/**
+		March the cells of a scalar_grid from @a cellMin ( inclusive ) to @a cellMax ( exclusive ), one row of cells at a time,
+		invoking the segment callback on each generated segment. Cell x,y spans samples x,y to x+1,y+1, in grid-local coordinates.
+		
+		Produces the same segments, in the same order, as march() over a VOXELSTORE returning the same 
+		values, but classifies cells and interpolates edge crossings in batches over contiguous rows.
+		Each edge crossing is computed once and shared by the two cells which border it.
+		
+		ISO is an isolevel<N,D>.
+		
+		SEGCALLBACK is an object with the following interface:
+
+			- void operator()( int x, int y, const marching_squares::segment &seg )
+			
+		where x,y are the coordinate of the cell's minimum corner, offset by the grid's origin.
+	*/
+	template< class ISO, class T, class SEGCALLBACK >
+	void marchGrid( const scalar_grid<T> &grid, const Vec2i &cellMin, const Vec2i &cellMax, SEGCALLBACK &sc )
+	{
+		typedef row_kernel< T, ISO > kernel;
+
+		const int
+			xStart = std::max( cellMin.x, 0 ),
+			yStart = std::max( cellMin.y, 0 ),
+			xEnd = std::min( cellMax.x, grid.width() - 1 ),
+			yEnd = std::min( cellMax.y, grid.height() - 1 ),
+			cellsWide = xEnd - xStart,
+			samplesWide = cellsWide + 1;
+			
+		if ( cellsWide < 1 || yEnd <= yStart ) return;
+		
+		const Vec2i origin = grid.origin();
+		
+		//
+		//	horizontal crossings are computed per sample row, and the top row of one row of cells
+		//	is the bottom row of the next, so we keep two and swap as we go.
+		//
+
+		std::vector< uint8_t > cases( cellsWide + scalar_grid<T>::Padding );
+		std::vector< float > 
+			horizontalA( samplesWide ), 
+			horizontalB( samplesWide ), 
+			vertical( samplesWide );
+			
+		float *bottom = &(horizontalA[0]),
+		      *top = &(horizontalB[0]);
+			  
+		int previousRow = yStart - 2;
+		segment segments[2];
+		Vec2r vertlist[4];
+		int edgelist[4];
+		const int stride = grid.width();
+			  
+		for ( int y = yStart; y < yEnd; y++ )
+		{
+			const T *r0 = grid.row(y) + xStart, *r1 = grid.row(y+1) + xStart;
+			
+			if ( !kernel::classify( r0, r1, cellsWide, &(cases[0]) )) 
+			{
+				continue;
+			}
+			
+			if ( previousRow == y - 1 )
+			{
+				std::swap( bottom, top );
+			}
+			else
+			{
+				kernel::interpolate( r0, r0 + 1, cellsWide, bottom );
+			}
+			
+			kernel::interpolate( r1, r1 + 1, cellsWide, top );
+			kernel::interpolate( r0, r1, samplesWide, &(vertical[0]) );
+			previousRow = y;
+			
+			const real 
+				y0 = origin.y + y,
+				y1 = y0 + 1;
+
+			for ( int i = 0; i < cellsWide; i++ )
+			{
+				const int squareIndex = cases[i];
+				if ( squareIndex == 0 || squareIndex == 15 ) continue;
+				
+				const int 
+					edges = EdgeTable[squareIndex],
+					x = origin.x + xStart + i;
+
+				const real 
+					x0 = x,
+					x1 = x0 + 1;
+					
+				const int gx = xStart + i;
+
+				if ( edges & 1 ) 
+				{
+					vertlist[0] = Vec2r( x0 + bottom[i], y0 );
+					edgelist[0] = edgeId( gx, y, stride, false );
+				}
+
+				if ( edges & 2 ) 
+				{
+					vertlist[1] = Vec2r( x1, y0 + vertical[i+1] );
+					edgelist[1] = edgeId( gx+1, y, stride, true );
+				}
+
+				if ( edges & 4 ) 
+				{
+					vertlist[2] = Vec2r( x0 + top[i], y1 );
+					edgelist[2] = edgeId( gx, y+1, stride, false );
+				}
+
+				if ( edges & 8 ) 
+				{
+					vertlist[3] = Vec2r( x0, y0 + vertical[i] );
+					edgelist[3] = edgeId( gx, y, stride, true );
+				}
+
+				int nSegments = 0;
+				for ( int j = 0; SegmentTable[squareIndex][j] != -1; j += 2 ) 
+				{
+					const int ea = SegmentTable[squareIndex][j], eb = SegmentTable[squareIndex][j+1];
+					segments[nSegments].a = vertlist[ea];
+					segments[nSegments].b = vertlist[eb];
+					segments[nSegments].edgeA = edgelist[ea];
+					segments[nSegments].edgeB = edgelist[eb];
+					nSegments++;
+				}
+
+				for ( int s = 0; s < nSegments; s++ )
+				{
+					sc( x, origin.y + y, segments[s] );
+				}
+			}
+		}
+	}
+
+	/**
+		March every cell of a scalar_grid, one row at a time. See marchGrid( grid, cellMin, cellMax, sc ) above.
+	*/
+	template< class ISO, class T, class SEGCALLBACK >
+	void marchGrid( const scalar_grid<T> &grid, SEGCALLBACK &sc )
+	{
+		marchGrid< ISO >( grid, Vec2i(0,0), Vec2i( grid.width() - 1, grid.height() - 1 ), sc );
+	}
+
+	#pragma mark -
+	#pragma mark Edge Linking
+	
+	/**
+		@class edge_linker
+		Links segments generated by marchGrid() into loops, using the ids of the cell edges their endpoints lie on.
+		
+		Since each cell edge is the start of at most one segment, segments are found by their start edge id 
+		in an open-addressing hash table sized to the segment count - linking is linear time, and the only 
+		allocations are the linker's own arrays, which are reused across calls.
+	*/
+	class edge_linker
+	{
+		public:
+		
+			edge_linker()
+			{}
+			
+			void clear()
+			{
+				_entries.clear();
+			}
+			
+			std::size_t size() const { return _entries.size(); }
+			
+			void reserve( std::size_t count )
+			{
+				_entries.reserve( count );
+			}
+			
+			/**
+				Add a segment running from cell edge @a fromEdge to @a toEdge, where @a fromVertex
+				is the position of the segment's start, in caller-defined integral units.
+			*/
+			inline void add( int fromEdge, int toEdge, const Vec2i &fromVertex )
+			{
+				_entries.push_back( entry( fromEdge, toEdge, fromVertex ));
+			}
+			
+			/**
+				Link the segments into loops of vertices, appending them to @a loops. 
+				
+				To match linking by vertex through a std::map<Vec2i,...,Vec2iComparator>, each loop starts at its lowest 
+				vertex by Vec2iComparator, loops are ordered by their lowest vertex, and repeated consecutive vertices 
+				( from segments which collapsed to a single point ) are removed.
+				
+				Returns false if any chain of segments failed to close.
+			*/
+			bool link( std::vector< std::vector< Vec2i > > &loops )
+			{
+				const std::size_t count = _entries.size();
+				if ( !count ) return true;
+				
+				_buildTable();
+				_visited.assign( count, 0 );
+				
+				std::vector< std::pair< Vec2i, std::size_t > > lowestVertices;
+				std::vector< std::vector< Vec2i > > unordered;
+				Vec2iComparator less;
+				bool closed = true;
+				
+				for ( std::size_t start = 0; start < count; start++ )
+				{
+					if ( _visited[start] ) continue;
+					
+					unordered.push_back( std::vector< Vec2i >() );
+					std::vector< Vec2i > &loop = unordered.back();
+					
+					std::size_t lowest = 0;
+					int current = int(start);
+					
+					while( true )
+					{
+						const entry &e = _entries[current];
+						_visited[current] = 1;
+						
+						if ( loop.empty() || loop.back() != e.vertex )
+						{
+							if ( !loop.empty() && less( e.vertex, loop[lowest] )) lowest = loop.size();
+							loop.push_back( e.vertex );
+						}
+						
+						const int next = _find( e.to );
+						if ( next < 0 || _visited[next] )
+						{
+							if ( next != int(start) ) closed = false;
+							break;
+						}
+						
+						current = next;
+					}
+					
+					//
+					//	the loop's closing vertex may repeat its first
+					//
+					
+					if ( loop.size() > 1 && loop.back() == loop.front() ) 
+					{
+						loop.pop_back();
+						if ( lowest == loop.size() ) lowest = 0;
+					}
+					
+					std::rotate( loop.begin(), loop.begin() + lowest, loop.end() );
+					lowestVertices.push_back( std::make_pair( loop.front(), unordered.size() - 1 ));
+				}
+				
+				std::sort( lowestVertices.begin(), lowestVertices.end(), lowest_vertex_comparator() );
+				
+				loops.reserve( loops.size() + unordered.size() );
+				for ( std::size_t i = 0, N = lowestVertices.size(); i < N; i++ )
+				{
+					loops.push_back( std::vector< Vec2i >() );
+					loops.back().swap( unordered[ lowestVertices[i].second ] );
+				}
+				
+				return closed;
+			}
+			
+		private:
+		
+			struct entry 
+			{
+				int from, to;
+				Vec2i vertex;
+				
+				entry( int f, int t, const Vec2i &v ):
+					from(f),
+					to(t),
+					vertex(v)
+				{}
+			};
+			
+			struct lowest_vertex_comparator
+			{
+				Vec2iComparator less;
+				
+				inline bool operator()( const std::pair< Vec2i, std::size_t > &a, const std::pair< Vec2i, std::size_t > &b ) const
+				{
+					return less( a.first, b.first );
+				}
+			};
+			
+			static inline unsigned int _hash( int edge )
+			{
+				return unsigned(edge) * 2654435761U;
+			}
+			
+			void _buildTable()
+			{
+				std::size_t capacity = 16;
+				while( capacity < _entries.size() * 2 ) capacity <<= 1;
+				
+				_mask = capacity - 1;
+				_table.assign( capacity, -1 );
+				
+				for ( std::size_t i = 0, N = _entries.size(); i < N; i++ )
+				{
+					std::size_t slot = _hash( _entries[i].from ) & _mask;
+					while( _table[slot] >= 0 && _entries[ _table[slot] ].from != _entries[i].from ) 
+					{
+						slot = ( slot + 1 ) & _mask;
+					}
+					
+					_table[slot] = int(i);
+				}
+			}
+			
+			inline int _find( int edge ) const
+			{
+				std::size_t slot = _hash( edge ) & _mask;
+				while( _table[slot] >= 0 )
+				{
+					if ( _entries[ _table[slot] ].from == edge ) return _table[slot];
+					slot = ( slot + 1 ) & _mask;
+				}
+				
+				return -1;
+			}
+		
+		private:
+		
+			std::vector< entry > _entries;
+			std::vector< int > _table;
+			std::vector< uint8_t > _visited;
+			std::size_t _mask;
+	};
+
 }
\ No newline at end of file
@@ -0,0 +1,223 @@
+#pragma once
+
+//
+//  PackedVoxelStore.h
+//  Surfacer
+//
+//  Created by Shamyl Zakariya on 10/17/12.
+//  Copyright 2012 TomorrowPlusX. All rights reserved.
+//
+
+#include "Voxel.h"
+
+namespace game { namespace terrain {
+
+#pragma mark -
+#pragma mark PackedVoxelStore
+
+/**
+	@class PackedVoxelStore
+	A structure-of-arrays alternative to OrdinalVoxelStore.
+
+	Where OrdinalVoxelStore holds one fat Voxel per ordinal position ( positions, neighbor and
+	island pointers, etc ), PackedVoxelStore holds only what cutting, flood filling and marching
+	need, as contiguous one-byte planes:
+		- occupation, 0->255
+		- strength, 0->255
+		- connectivity, one bit per Compass::Direction, set when the voxel is linked to its neighbor in that direction
+
+	Voxels are addressed by index ( y * width + x ), and neighbors are found by index arithmetic
+	instead of by pointer. Links to out-of-bounds neighbors are never set, so a set connectivity bit
+	always refers to a valid neighbor index.
+*/
+class PackedVoxelStore
+{
+	protected:
+
+		int _width, _height;
+		real _scale, _rScale;
+		std::vector< uint8_t > _occupation, _strength, _connectivity;
+		int _neighborOffsets[8];
+
+	public:
+
+		PackedVoxelStore():
+			_width(0),
+			_height(0),
+			_scale(1),
+			_rScale(1)
+		{
+			for ( int i = 0; i < 8; i++ ) _neighborOffsets[i] = 0;
+		}
+
+		~PackedVoxelStore()
+		{}
+
+		/**
+			Initialize the store to hold width * height empty voxels, each fully connected to its in-bounds neighbors
+		*/
+		void set( int width, int height, real scale )
+		{
+			_width = width;
+			_height = height;
+			_scale = scale;
+			_rScale = 1 / scale;
+
+			const std::size_t count = std::size_t(width) * std::size_t(height);
+			_occupation.assign( count, 0 );
+			_strength.assign( count, 0 );
+			_connectivity.assign( count, 0 );
+
+			for ( int i = 0; i < 8; i++ )
+			{
+				const Vec2i &d = Compass::dir(i);
+				_neighborOffsets[i] = d.y * _width + d.x;
+			}
+
+			for ( int y = 0; y < _height; y++ )
+			{
+				for ( int x = 0; x < _width; x++ )
+				{
+					uint8_t mask = 0;
+					for ( int i = 0; i < 8; i++ )
+					{
+						const Vec2i &d = Compass::dir(i);
+						if ( contains( x + d.x, y + d.y )) mask |= uint8_t(1 << i);
+					}
+
+					_connectivity[ y * _width + x ] = mask;
+				}
+			}
+		}
+
+		/**
+			Copy occupation, strength and connectivity from an OrdinalVoxelStore of the same dimensions.
+			Voxels in unallocated tiles of @a store are copied as empty and unconnected.
+		*/
+		void assign( const OrdinalVoxelStore &store )
+		{
+			set( store.width(), store.height(), store.scale() );
+
+			for ( int y = 0; y < _height; y++ )
+			{
+				for ( int x = 0; x < _width; x++ )
+				{
+					const Voxel *v = store.voxelAtUnsafe(x,y);
+					const int i = index(x,y);
+					
+					if ( !v )
+					{
+						_occupation[i] = _strength[i] = _connectivity[i] = 0;
+						continue;
+					}
+
+					uint8_t mask = 0;
+					for ( int d = 0; d < 8; d++ )
+					{
+						if ( v->neighbors[d] ) mask |= uint8_t(1 << d);
+					}
+
+					_occupation[i] = uint8_t( std::max( std::min( v->occupation, 255 ), 0 ));
+					_strength[i] = uint8_t( std::max( std::min( v->strength, 255 ), 0 ));
+					_connectivity[i] = mask;
+				}
+			}
+		}
+
+		inline bool contains( int x, int y ) const
+		{
+			return x >= 0 && x < _width && y >= 0 && y < _height;
+		}
+
+		inline int index( int x, int y ) const { return y * _width + x; }
+		inline int index( const Vec2i &a ) const { return index( a.x, a.y ); }
+		inline Vec2i ordinalPosition( int i ) const { return Vec2i( i % _width, i / _width ); }
+
+		/**
+			Get the scaled position of voxel @a i, e.g., the position a voxel in the static
+			group would have, per IslandGroup::centroidRelativePosition
+		*/
+		inline Vec2r position( int i ) const
+		{
+			return Vec2r( real( i % _width ), real( i / _width )) * _scale;
+		}
+
+		inline int occupation( int i ) const { return _occupation[i]; }
+		inline int strength( int i ) const { return _strength[i]; }
+		inline uint8_t connectivity( int i ) const { return _connectivity[i]; }
+
+		inline void setOccupation( int i, int occupation ) { _occupation[i] = uint8_t( std::max( std::min( occupation, 255 ), 0 )); }
+		inline void setStrength( int i, int strength ) { _strength[i] = uint8_t( std::max( std::min( strength, 255 ), 0 )); }
+		
+		/**
+			Set the connectivity mask of voxel @a i, e.g., when copying a subset of another store.
+			Links to out-of-bounds neighbors must not be set.
+		*/
+		inline void setConnectivity( int i, uint8_t mask ) { _connectivity[i] = mask; }
+
+		inline real volume( int i ) const { return real(_occupation[i]) / real(255); }
+		inline bool empty( int i ) const { return _occupation[i] == 0; }
+		inline bool fixed( int i ) const { return _strength[i] == 255; }
+
+		/**
+			Get the index of the neighbor of @a i in direction @a dir, or -1 if @a i is not linked to that neighbor
+		*/
+		inline int neighbor( int i, int dir ) const
+		{
+			return (_connectivity[i] & (1 << dir)) ? i + _neighborOffsets[dir] : -1;
+		}
+
+		inline bool connected( int i, int dir ) const { return _connectivity[i] & (1 << dir); }
+		inline bool hasNeighbors( int i ) const { return _connectivity[i] != 0; }
+
+		// mutual disconnection from neighbors
+		inline void disconnect( int i )
+		{
+			uint8_t mask = _connectivity[i];
+			for ( int dir = 0; mask; dir++, mask >>= 1 )
+			{
+				if ( mask & 1 )
+				{
+					_connectivity[ i + _neighborOffsets[dir] ] &= uint8_t(~(1 << ((dir + 4) % 8)));
+				}
+			}
+
+			_connectivity[i] = 0;
+			_occupation[i] = 0;
+		}
+
+		inline void disconnect( int i, int dir )
+		{
+			if ( _connectivity[i] & (1 << dir))
+			{
+				_connectivity[ i + _neighborOffsets[dir] ] &= uint8_t(~(1 << ((dir + 4) % 8)));
+				_connectivity[i] &= uint8_t(~(1 << dir));
+			}
+
+			// mark unoccupied if we're orphaned
+			if ( !_connectivity[i] ) _occupation[i] = 0;
+		}
+
+		/**
+			Get the occupation value at a voxel coord, 0 -> 1. Returns 0 for out-of-bounds coordinates.
+			Matches the marching squares VOXELSTORE valueAt() interface.
+		*/
+		inline real valueAt( int x, int y ) const
+		{
+			return contains(x,y) ? volume( index(x,y)) : real(0);
+		}
+
+		int width() const { return _width; }
+		int height() const { return _height; }
+		int count() const { return _width * _height; }
+		real scale() const { return _scale; }
+		Vec2i size() const { return Vec2i( _width, _height ); }
+
+		/**
+			Bytes of storage per voxel held by this store
+		*/
+		static std::size_t bytesPerVoxel() { return 3 * sizeof( uint8_t ); }
+
+};
+
+}} // end namespace game::terrain
@@ -9,6 +9,8 @@
 
 #include "Terrain.h"
 
+#include <algorithm>
+#include <limits>
 #include <queue>
 
 #include <cinder/app/App.h>
@@ -22,6 +24,11 @@
 #include "TerrainRendering.h"
 #include "GameConstants.h"
 #include "Stopwatch.h"
+#include "CookedTerrain.h"
+
+// when 1, dynamic groups take area, mass and moment from their voxels' occupation, as point masses on the 
+// ordinal grid; when 0, from their islands' triangulations
+#define VOXEL_MASS_PROPERTIES 1
 
 
 using namespace ci;
@@ -37,68 +44,23 @@ namespace
 	};
 	
 	/**
-		Gather all the islands reachable from @a island into @a group, removing those islands from the pool @a all
+		Gather all the islands reachable from @a island into @a group, removing those islands from the pool @a all.
+		The walk is breadth-first over Island::adjacentIslands(), so in GatherMode_EarlyExitForFixed it stops
+		at the fixed island nearest @a island, rather than walking the rest of the static terrain.
 		@return true if any island in the group is fixed
 	*/
-	
-	bool GatherIslandGroupRecursive( Island *island, std::set< Island* > &group, std::set< Island* > &all, GatherMode mode )
-	{
-		bool fixed = island->fixed();
-
-		all.erase( island );
-		group.insert( island );
-
-		if ( fixed && mode == GatherMode_EarlyExitForFixed ) return true;
-
-		//
-		// get this island's neighbors
-		//
-		
-		std::set< Island* > neighbors;
-		foreach( Voxel *v, island->voxels() )
-		{
-			if ( v->numIslands > 1 ) 
-			{
-				for ( int i = 0, n = v->numIslands; i < n; i++ )
-				{
-					if ( v->islands[i] && (v->islands[i] != island))
-					{
-						neighbors.insert( v->islands[i] );
-					}
-				}
-			}
-		}
-		
-		//
-		//	for each neighbor we found, add to our group and recurse if that neighbor hasn't been reached before
-		//	note that if any neighbor is fixed, this group must be fixed
-		//
-
-		foreach( Island *neighbor, neighbors )
-		{
-			if ( group.insert( neighbor ).second )
-			{
-				if ( GatherIslandGroupRecursive( neighbor, group, all, mode ) ) 
-				{
-					fixed = true;
-					if ( mode == GatherMode_EarlyExitForFixed ) return true;
-				}
-			}
-		}	
-		
-		return fixed;
-	}
 
 	bool GatherIslandGroupIterative( Island *island, std::set< Island* > &group, std::set< Island* > &all, GatherMode mode )
 	{
 		bool fixed = false;
-		std::queue< Island* > stack;
-		stack.push( island );
+		std::queue< Island* > queue;
+		queue.push( island );
+		group.insert( island );
 		
-		while( !stack.empty() )
+		while( !queue.empty() )
 		{
-			Island *island = stack.front();
-			stack.pop();
+			Island *island = queue.front();
+			queue.pop();
 
 			if ( island->fixed() ) 
 			{
@@ -106,7 +68,6 @@ namespace
 			}
 
 			all.erase( island );
-			group.insert( island );
 			
 			//
 			//	If fixed, and we're early exiting for fixed, get out of here
@@ -114,18 +75,11 @@ namespace
 
 			if ( fixed && mode == GatherMode_EarlyExitForFixed ) return true;
 			
-			foreach( Voxel *voxel, island->voxels())
+			foreach( Island *neighbor, island->adjacentIslands() )
 			{
-				if ( voxel->numIslands > 1 ) 
+				if ( group.insert( neighbor ).second )
 				{
-					for ( int i = 0, n = voxel->numIslands; i < n; i++ )
-					{
-						Island *neighbor = voxel->islands[i];
-						if ( neighbor && (neighbor != island) && group.insert( neighbor ).second )
-						{
-							stack.push(neighbor);
-						}
-					}
+					queue.push( neighbor );
 				}
 			}
 		}
@@ -135,7 +89,62 @@ namespace
 	
 	inline bool GatherIslandGroup( Island *island, std::set< Island* > &group, std::set< Island* > &all, GatherMode mode )
 	{
-		return GatherIslandGroupRecursive(island, group, all, mode );
+		return GatherIslandGroupIterative( island, group, all, mode );
+	}
+	
+	/**
+		Islands' collision detail is reevaluated at this interval, rather than every step
+	*/
+	const seconds_t CollisionDetailUpdateInterval = 0.25;
+	
+	/**
+		The debris budget is enforced at this interval
+	*/
+	const seconds_t DebrisBudgetUpdateInterval = 0.25;
+	
+	/**
+		cpBodyEachArbiter callback for the static group's body, adding to the foci the bounds of each static island 
+		in contact with a non-static body - debris, an entity, a prop, anything which might rest on it
+	*/
+	void gather_static_contact( cpBody *staticBody, cpArbiter *arbiter, void *data )
+	{
+		std::vector< cpBB > *foci = static_cast< std::vector< cpBB >* >( data );
+		cpShape *a = NULL, *b = NULL;
+		cpArbiterGetShapes( arbiter, &a, &b );
+
+		cpShape *island = cpShapeGetBody( a ) == staticBody ? a : b,
+		        *other = island == a ? b : a;
+
+		if ( cpShapeGetBody( island ) == staticBody && !cpBodyIsStatic( cpShapeGetBody( other )) && cpShapeGetUserData( island ))
+		{
+			foci->push_back( static_cast< Island* >( cpShapeGetUserData( island ))->aabb() );
+		}
+	}
+
+	/**
+		Orders debris candidates by score, breaking ties by voxel count and then by creation order rather than
+		by address, so the same groups are retired from run to run, and replays retire the same debris
+	*/
+	struct debris_candidate_order
+	{
+		bool operator()( const std::pair< real, DynamicIslandGroup* > &a, const std::pair< real, DynamicIslandGroup* > &b ) const
+		{
+			if ( a.first != b.first ) return a.first < b.first;
+			if ( a.second->voxelCount() != b.second->voxelCount() ) return a.second->voxelCount() < b.second->voxelCount();
+			return a.second->instanceId() < b.second->instanceId();
+		}
+	};
+
+	/**
+		Distance between the nearest edges of @a a and @a b, or zero if they overlap
+	*/
+	inline real BBDistance( const cpBB &a, const cpBB &b )
+	{
+		const real 
+			dx = std::max( std::max( a.l - b.r, b.l - a.r ), real(0) ),
+			dy = std::max( std::max( a.b - b.t, b.b - a.t ), real(0) );
+			
+		return std::sqrt( dx * dx + dy * dy );
 	}
 	
 }
@@ -147,6 +156,7 @@ namespace
 /*
 		IslandGroup *_group;
 		OrdinalVoxelStore *_store;
+		uint16_t _membershipId;
 		island_group_dynamics _gd;
 
 		bool _usable, _fixed, _entirelyFixed;
@@ -165,17 +175,23 @@ Island::Island(
 	_renderer( NULL ),
 	_group(NULL),
 	_store(store),
+	_membershipId( store->registerIsland( this )),
 	_usable(true),
 	_fixed(true),
-	_entirelyFixed(false)
+	_entirelyFixed(false),
+	_hasUntranslatedTriangulation(false),
+	_coarseCollision(false),
+	_greeblingLevel(-1),
+	_hasUntranslatedGreebling(false),
+	_greeblingOffset(0,0),
+	_greeblingTranslated(false)
 {
 	setName( "Island (Initialization Template)" );
 	setVisibilityDetermination( VisibilityDetermination::NEVER_DRAW );
+	_clearDirty();
 
 	const Vec2i surfaceSize( surface.getWidth(), surface.getHeight()),
 				surfaceExtent( surfaceSize.x - 1, surfaceSize.y - 1 );
-				
-	const real scale = _store->scale();
 		  
 	const uint8_t pixelInc = surface.getPixelInc();
 
@@ -208,7 +224,7 @@ Island::Island(
 				
 			if ( Red > 0 )
 			{
-				Voxel *voxel = store->voxelAt(x,y);
+				Voxel *voxel = store->allocate(x,y);
 				
 				if ( voxel )
 				{
@@ -216,20 +232,20 @@ Island::Island(
 					//	If the voxel has no owner, we know it needs to be initialized. Then add this Island to owners list
 					//
 
-					if ( voxel->numIslands == 0 )
+					if ( voxel->islandCount == 0 )
 					{
 						voxel->occupation = Red;
 						voxel->strength = Green;
 						voxel->id = Blue;
-						voxel->centroidRelativePosition = voxel->worldPosition = Vec2r( voxel->ordinalPosition.x, voxel->ordinalPosition.y ) * scale;
 					}
 
 					//
 					//	take posession
 					//
 
-					voxel->addToIsland(this);
+					store->addToIsland( voxel, _membershipId );
 					_voxels.push_back( voxel );
+					if ( voxel->islandId == _membershipId ) _massMoments.add( voxel );
 				}
 			}
 
@@ -242,6 +258,7 @@ Island::Island(
 	}
 
 	// no need to assign renderers since this is a throwaway island
+	_linkAdjacentIslands();
 }
 
 Island::Island( OrdinalVoxelStore *store, const std::vector<Voxel*> &voxels ):
@@ -249,14 +266,22 @@ Island::Island( OrdinalVoxelStore *store, const std::vector<Voxel*> &voxels ):
 	_renderer( new IslandRenderer() ),
 	_group(NULL),
 	_store( store ),
+	_membershipId( store->registerIsland( this )),
 	_usable(true),
 	_fixed(false),
-	_entirelyFixed(true)
+	_entirelyFixed(true),
+	_hasUntranslatedTriangulation(false),
+	_coarseCollision(false),
+	_greeblingLevel(-1),
+	_hasUntranslatedGreebling(false),
+	_greeblingOffset(0,0),
+	_greeblingTranslated(false)
 {
 	setName( "Island" );
 	addComponent( _renderer );
 	setLayer( RenderLayer::TERRAIN );
 	setVisibilityDetermination( VisibilityDetermination::FRUSTUM_CULLING ); // frustum is set by parent IslandGroup
+	_clearDirty();
 
 	//
 	//	we're computing local min/max with stack locals, because this proved 
@@ -277,9 +302,12 @@ Island::Island( OrdinalVoxelStore *store, const std::vector<Voxel*> &voxels ):
 	_voxels.reserve( voxels.size() );
 	foreach( Voxel *v, voxels )
 	{
-		v->addToIsland(this);
+		_store->addToIsland( v, _membershipId );
 		_voxels.push_back(v);
 
+		// a voxel shared with other islands is weighed only by its first owner
+		if ( v->islandId == _membershipId ) _massMoments.add( v );
+
 		//
 		//	if any voxels have max strength, this is a static 'fixed' island.
 		//	And if any do NOT, this is not an 'entirely fixed' Island
@@ -301,46 +329,79 @@ Island::Island( OrdinalVoxelStore *store, const std::vector<Voxel*> &voxels ):
 	}
 
 	_vertexBoundsOrdinal = vertexBoundsLocal;		
+	_linkAdjacentIslands();
 }
 
 
 Island::~Island()
-{}
+{
+	foreach( Island *neighbor, _adjacentIslands )
+	{
+		neighbor->_adjacentIslands.erase( this );
+	}
+}
 
 void Island::releaseVoxels()
 {
 	//
 	//	Remove self from each of our voxels, disconnecting those who
 	//	lose ownership. We do not delete voxels, as they are owned by the world's store.
+	//	Then return our membership id to the store for reuse.
 	//
 
 	foreach( Voxel *v, _voxels )
 	{
-		v->removeFromIsland(this);
-		if ( v->numIslands == 0 ) 
+		_store->removeFromIsland( v, _membershipId );
+		if ( v->islandCount == 0 ) 
 		{
 			v->disconnect();
 		}
 	}
 	
 	_voxels.clear();
+	_store->unregisterIsland( _membershipId );
+	_membershipId = 0;
+}
+
+void Island::_linkAdjacentIslands()
+{
+	foreach( Voxel *v, _voxels )
+	{
+		if ( v->islandCount > 1 )
+		{
+			for ( int i = 0, n = v->islandCount; i < n; i++ )
+			{
+				Island *neighbor = _store->islandOf( v, i );
+				if ( neighbor && neighbor != this && _adjacentIslands.insert( neighbor ).second )
+				{
+					neighbor->_adjacentIslands.insert( this );
+				}
+			}
+		}
+	}
 }
 
 Voxel *Island::findVoxelClosestTo( const Vec2r &worldPosition, real distThreshold ) const
 {
 	Voxel *found = NULL;
 	real foundDist2 = FLT_MAX;
-	const real distThreshold2 = distThreshold * distThreshold;
 	
-	Vec2r islandLocalPosition = this->group()->modelviewInverse() * worldPosition;
+	//
+	//	Compare in ordinal space, where voxel positions are known without computing them
+	//
+
+	const real 
+		oneOverScale = 1 / _store->scale(),
+		distThreshold2 = distThreshold * distThreshold * oneOverScale * oneOverScale;
+
+	const Vec2r ordinalPosition = ( this->group()->modelviewInverse() * worldPosition - this->group()->ordinalToCentroidRelativeOffset() ) * oneOverScale;
 
 	for( std::vector< Voxel* >::const_iterator 
 		voxel(_voxels.begin()), end( _voxels.end());
 		voxel != end; 
 		++voxel )
 	{
-		// use voxel->centroidRelativePosition
-		real d2 = islandLocalPosition.distanceSquared( (*voxel)->centroidRelativePosition );
+		real d2 = ordinalPosition.distanceSquared( Vec2r( (*voxel)->ordinalPosition ));
 		if ( d2 < distThreshold2 )
 		{
 			if ( d2 < foundDist2 )
@@ -374,10 +435,11 @@ island_group_dynamics::island_group_dynamics( class IslandGroup *group )
 		linearVelocity = group->linearVelocity();
 		angle = group->angle();
 		angularVelocity = group->angularVelocity();
+		ordinalToCentroidRelativeOffset = group->ordinalToCentroidRelativeOffset();
 	}
 	else
 	{
-		position = linearVelocity = Vec2r(0,0);
+		position = linearVelocity = ordinalToCentroidRelativeOffset = Vec2r(0,0);
 		angle = angularVelocity = 0;
 	}
 }
@@ -410,6 +472,7 @@ IslandGroup::IslandGroup( cpSpace *space, Terrain *terrain, int gameObjectType )
 	_terrain( terrain ),
 	_space( space ),
 	_body(NULL),
+	_ordinalToCentroidRelativeOffset(0,0),
 	_modelviewInverseDirty(true),
 	_sleeping(true),
 	_area(0),
@@ -449,6 +512,11 @@ const Mat4r & IslandGroup::modelviewInverse()
 	return _modelviewInverse;
 }
 
+Vec2r IslandGroup::centroidRelativePosition( const Voxel *v ) const
+{
+	return Vec2r( v->ordinalPosition ) * _terrain->voxelStore().scale() + _ordinalToCentroidRelativeOffset;
+}
+
 real IslandGroup::angle() const
 {
 	return cpBodyGetAngle( body() );
@@ -489,6 +557,79 @@ void IslandGroup::freeCollisionShapes()
 	_modelview.setToIdentity();
 }
 
+void IslandGroup::_createCollisionShapes( Island *island )
+{
+	const real elasticity = _terrain->initializer().elasticity,
+	           friction = _terrain->initializer().friction;
+
+	cpShapeVec &shapes = _shapesByIsland[island];
+	std::vector< cpVect > polygonVertices;
+
+	const std::vector< Vec2rVec > &polygons = ( island->_coarseCollision && !island->_coarseCollisionPolygons.empty() ) ?
+		island->_coarseCollisionPolygons :
+		island->collisionPolygons();
+
+	foreach( const Vec2rVec &polygon, polygons )
+	{
+		polygonVertices.resize( polygon.size() );
+		for ( std::size_t i = 0, N = polygon.size(); i < N; i++ )
+		{
+			polygonVertices[i] = cpv( polygon[i] );
+		}
+		
+		if ( cpPolyValidate( &polygonVertices.front(), int(polygonVertices.size()) ) )
+		{
+			cpShape *polyShape = cpPolyShapeNew( _body, int(polygonVertices.size()), &polygonVertices.front(), cpvzero );
+			
+			cpShapeSetUserData( polyShape, island );
+			cpShapeSetElasticity( polyShape, elasticity );
+			cpShapeSetFriction( polyShape, friction );
+			cpShapeSetLayers( polyShape, CollisionLayerMask::TERRAIN );
+			cpShapeSetCollisionType( polyShape, CollisionType::TERRAIN );
+								
+			cpSpaceAddShape( _space, polyShape );
+			shapes.push_back(polyShape);
+		}
+	}
+}
+
+void IslandGroup::_setCollisionDetail( Island *island, bool coarse )
+{
+	IslandShapeVecMap::iterator pos = _shapesByIsland.find( island );
+	if ( pos == _shapesByIsland.end() || island->_coarseCollision == coarse ) return;
+
+	//
+	//	Coarse polygons made by the last prepareGeometry are kept while at full detail; if there 
+	//	aren't any, make them now. If the island simplifies to nothing, it keeps full detail shapes.
+	//
+
+	if ( coarse && island->_coarseCollisionPolygons.empty() && 
+	     !island->_createCoarseCollisionPolygons( _ordinalToCentroidRelativeOffset ))
+	{
+		return;
+	}
+
+	foreach( cpShape *shape, pos->second )
+	{
+		cpSpaceRemoveShape( _space, shape );
+		cpShapeFree( shape );
+	}
+
+	_shapesByIsland.erase( pos );
+
+	island->_coarseCollision = coarse;
+	_createCollisionShapes( island );
+}
+
+void IslandGroup::updatePhysics()
+{
+	WorkerPool &pool = _terrain->workerPool();
+
+	_beginUpdatePhysics( pool );
+	pool.wait();
+	_finishUpdatePhysics();
+}
+
 void IslandGroup::updateAabb()
 {
 	cpBB bounds = cpBBInvalid;
@@ -581,11 +722,6 @@ StaticIslandGroup::StaticIslandGroup( cpSpace *space, Terrain *world ):
 StaticIslandGroup::~StaticIslandGroup()
 {}
 
-void StaticIslandGroup::updatePhysics()
-{
-	updateAabb();
-}
-
 bool StaticIslandGroup::addIsland( Island *island )
 {
 	//
@@ -605,57 +741,19 @@ bool StaticIslandGroup::addIsland( Island *island )
 	if ( hasIsland( island ) ) return true;
 
 	//
-	//	Add the island, and triangulate. If triangulation fails, cleanup and bail.
-	//	Note, this island is static, so it can be triangulated off the default voxels' 
-	//	world-space centroidRelativePositions. 
-	//	When an island becomes dynamic ( can only go fixed->dynamic, not the other way around ) 
-	//	we will have to compute centroidRelativePositions for rigid bodies
+	//	Add the island; it will be triangulated and given collision shapes in updatePhysics.
 	//
 
 	IslandGroup::addIsland( island );
-
-	if ( island->triangulate() )
-	{
-		//
-		//	Create collision shapes for this Island, and mark ownership
-		//
-		
-		cpVect triangleVertices[3];
-		
-		foreach( const triangle &tri, island->triangulation() )
-		{
-			tri.vertices( triangleVertices );
-			cpShape *polyShape = cpPolyShapeNew( _body, 3, triangleVertices, cpvzero );
-
-			cpShapeSetUserData( polyShape, island );
-			cpShapeSetElasticity( polyShape, _terrain->initializer().elasticity );
-			cpShapeSetFriction( polyShape, _terrain->initializer().friction );
-			cpShapeSetLayers( polyShape, CollisionLayerMask::TERRAIN );
-			cpShapeSetCollisionType( polyShape, CollisionType::TERRAIN );
-			
-			cpSpaceAddShape( _space, polyShape );
-			
-			_shapesByIsland[island].push_back(polyShape);
-		}
-	}
-	else
-	{
-		//
-		// we can't use this island
-		//
-
-		removeIsland( island );
-		island->releaseVoxels();
-		delete island;
-
-		return false;
-	}			
+	_pendingIslands.insert( island );
 
 	return true;
 }
 
 bool StaticIslandGroup::removeIsland( Island *island )
 {
+	_pendingIslands.erase( island );
+
 	if ( IslandGroup::removeIsland( island ))
 	{
 		#warning Chipmunk workaround - activating all bodies touching level body
@@ -669,17 +767,63 @@ bool StaticIslandGroup::removeIsland( Island *island )
 
 
 
+void StaticIslandGroup::_beginUpdatePhysics( WorkerPool &pool )
+{
+	//
+	//	Note, these islands are static, so they can be triangulated off their voxels' scaled ordinal
+	//	positions, which are their world positions. When an island becomes dynamic ( can only go 
+	//	fixed->dynamic, not the other way around ) its group gives them an offset to its centroid
+	//
+
+	foreach( Island *island, _pendingIslands )
+	{
+		pool.add( boost::bind( &Island::prepareGeometry, island, (Vec2r const *) NULL ));
+	}
+}
+
+void StaticIslandGroup::_finishUpdatePhysics()
+{
+	std::set< Island* > pending;
+	pending.swap( _pendingIslands );
+
+	foreach( Island *island, pending )
+	{
+		if ( island->commitGeometry() )
+		{
+			_createCollisionShapes( island );
+		}
+		else
+		{
+			//
+			// we can't use this island
+			//
+
+			removeIsland( island );
+			island->releaseVoxels();
+			delete island;
+		}
+	}
+
+	updateAabb();
+}
+
 #pragma mark -
 #pragma mark DynamicIslandGroup
 
 /*
-		bool _physicsDirty;
+		bool _physicsDirty, _physicsUpdatePending;
 		island_group_dynamics _inheritedDynamics;
+		Vec2r _pendingPosition, _pendingOrdinalToCentroidRelativeOffset;
+		seconds_t _lastAwakeTime;
+		std::size_t _voxelCount;
 */
 
 DynamicIslandGroup::DynamicIslandGroup( cpSpace *space, Terrain *world ):
 	IslandGroup( space, world, GameObjectType::ISLAND_DYNAMIC_GROUP ),
-	_physicsDirty( true )
+	_physicsDirty( true ),
+	_physicsUpdatePending( false ),
+	_lastAwakeTime( 0 ),
+	_voxelCount( 0 )
 {
 	setName( "DynamicIslandGroup");
 }
@@ -687,7 +831,10 @@ DynamicIslandGroup::DynamicIslandGroup( cpSpace *space, Terrain *world ):
 DynamicIslandGroup::DynamicIslandGroup( cpSpace *space, Terrain *world, const island_group_dynamics &parentGD ):
 	IslandGroup( space, world, GameObjectType::ISLAND_DYNAMIC_GROUP ),
 	_physicsDirty( true ),
-	_inheritedDynamics( parentGD )
+	_physicsUpdatePending( false ),
+	_inheritedDynamics( parentGD ),
+	_lastAwakeTime( 0 ),
+	_voxelCount( 0 )
 {
 	setName( "DynamicIslandGroup");
 }
@@ -703,6 +850,8 @@ void DynamicIslandGroup::update( const time_state &time )
 
 		if ( !_sleeping )
 		{
+			_lastAwakeTime = time.time;
+
 			//
 			//	update modelview for GL rendering, and mark inverse as dirty for lazy computation if needed
 			//
@@ -715,7 +864,21 @@ void DynamicIslandGroup::update( const time_state &time )
 	}
 }
 
-void DynamicIslandGroup::updatePhysics()
+void DynamicIslandGroup::setPose( const Vec2r &position, real angle )
+{
+	if ( !_body ) return;
+	
+	cpBodySetPos( _body, cpv( position ));
+	cpBodySetAngle( _body, angle );
+	cpSpaceReindexShapesForBody( _space, _body );
+
+	cpBody_ToMatrix( _body, _modelview );
+	_modelviewInverseDirty = true;
+	
+	updateAabb();
+}
+
+void DynamicIslandGroup::_beginUpdatePhysics( WorkerPool &pool )
 {
 	//
 	//	Here's the quick and dirty of what's about to happen:
@@ -724,7 +887,8 @@ void DynamicIslandGroup::updatePhysics()
 	//	We need to UNROTATE them for tesselation to work correctly. And finally,
 	//	when creating a new body, we need to set the position and re-rotate, and
 	//	add the velocity of the parent island group to maintain linear & angular vel.
-	//	This is done by bringing the voxels to world space, then back to centroid-relative
+	//	Voxels don't store positions - every voxel of a group shares one rigid transform from 
+	//	its ordinal grid - so this is done once for the centroid, not for each voxel.
 	//
 	
 
@@ -736,10 +900,6 @@ void DynamicIslandGroup::updatePhysics()
 	
 	if ( _physicsDirty )
 	{
-		const real density = _terrain->initializer().density,
-		           elasticity = _terrain->initializer().elasticity,
-		           friction = _terrain->initializer().friction;
-	
 		//
 		//	If this is an existing group being rebuilt, retain our transform;
 		//	Otherwise, use what was passed to our constructor.
@@ -757,102 +917,118 @@ void DynamicIslandGroup::updatePhysics()
 		freeCollisionShapes();
 		
 		//
-		//	First, compute worldPosition for each vertex, and while doing so compute a
-		//	rough centroid as average of worldPositions. That centroid will be the
-		//	body() position.
+		//	Find the centre of mass of our voxels in scaled ordinal space, from each island's cached occupation-weighted
+		//	moments, so the body() origin is the centre of mass. Each voxel counts once, for its first owner.
 		//
 
-		Vec2r position;
-		
+		const real scale = _terrain->voxelStore().scale();
+		voxel_mass_moments moments;
+		std::size_t count = 0;
+
+		foreach( Island *island, _islands )
 		{
-			util::Transform parentTransform( _inheritedDynamics.position, _inheritedDynamics.angle );
+			moments += island->massMoments();
+			count += island->voxels().size();
+		}
 
-			Vec2r accum(0,0);
-			std::size_t tick = 0;
+		const Vec2r centroid = moments.occupation > 0 ? 
+			Vec2r( moments.firstX, moments.firstY ) * ( scale / moments.occupation ) : 
+			Vec2r(0,0);
 
-			foreach( Island *island, _islands )
-			{
-				foreach( Voxel *v, island->voxels() )
-				{
-					if ( v->islands[0] == island )
-					{
-						v->worldPosition = parentTransform * v->centroidRelativePosition;
+		_voxelCount = count;
 
-						accum += v->worldPosition;
-						tick++;
-					}
-				}
-			}
-			
-			position = accum / tick;			
-		}
-		
 		//
-		//	Now, we want to update the centroidRelativePosition of each vertex to reflect the new centroid,
-		//	and also we want to rotate them in the inverse of the parent rotation such that the centroidRelativePositions
-		//	are back in an unrotated coordinate system. This is necessary for tesselation. We also need to compute the
-		//	offset from ordinalSpace to centroidRelativeSpace for tesselation to create voxels in centroidRelative space.
+		//	Our voxels were placed in the world by the inherited transform and offset, so that's where the
+		//	centroid is too. Centroid-relative positions are kept unrotated, which is necessary for tesselation,
+		//	so the offset from ordinal space to centroid-relative space is just a translation.
 		//
 
-		Vec2r centroidRelativePositionMin( FLT_MAX, FLT_MAX );
-		Vec2r ordinalPositionMin( FLT_MAX, FLT_MAX );
-		const real scale = _terrain->voxelStore().scale();
+		util::Transform parentTransform( _inheritedDynamics.position, _inheritedDynamics.angle );
 
-		{
-			util::Transform unrotate( Vec2r(0,0), -_inheritedDynamics.angle );
-
-			foreach( Island *island, _islands )
-			{
-				foreach( Voxel *v, island->voxels() )
-				{
-					if ( v->islands[0] == island )
-					{
-						v->centroidRelativePosition = unrotate * (v->worldPosition - position);
+		_pendingPosition = parentTransform * ( centroid + _inheritedDynamics.ordinalToCentroidRelativeOffset );
+		_pendingOrdinalToCentroidRelativeOffset = -centroid;
+		_physicsUpdatePending = true;
+		
+		//
+		//	Triangulate our islands on the worker pool; _finishUpdatePhysics picks up the results
+		//
 
-						centroidRelativePositionMin = ::min( centroidRelativePositionMin, v->centroidRelativePosition );
-						ordinalPositionMin = ::min( ordinalPositionMin, Vec2r(v->ordinalPosition) * scale );
-					}
-				}
-			}
+		foreach( Island *island, _islands )
+		{
+			pool.add( boost::bind( &Island::prepareGeometry, island, &_pendingOrdinalToCentroidRelativeOffset ));
 		}
+	}
+}
+
+void DynamicIslandGroup::_finishUpdatePhysics()
+{
+	if ( _physicsUpdatePending )
+	{
+		const real density = _terrain->initializer().density;
+		const Vec2r position = _pendingPosition;
+		_ordinalToCentroidRelativeOffset = _pendingOrdinalToCentroidRelativeOffset;
 
 		real 
+			area = 0,
 			mass = 0, 
 			moment = 0;
 		
-		Vec2r 
-			ordinalToCentroidRelativeOffset = centroidRelativePositionMin - ordinalPositionMin;
+		#if VOXEL_MASS_PROPERTIES
+
+			//
+			//	Each voxel is a square point mass at its scaled ordinal position, of the voxel's area times its
+			//	occupation. Each usable island's cached moments on the ordinal grid are summed, and moved to the 
+			//	centre of mass afterwards, so no voxel is visited. They're the moments the centre of mass was found from.
+			//
+
+			voxel_mass_moments moments;
+
+		#else
+
+			cpVect triangleVertices[3];
+
+		#endif
 		
 		//
-		//	triangulate our islands and determine mass and moment. 
+		//	Determine mass and moment of our triangulated islands.
 		//	discard any islands which couldn't triangulate.
 		//	
 
-		cpVect triangleVertices[3];
 		std::set< Island* > usableIslands;
 		foreach( Island *island, _islands )
 		{
-			if ( island->triangulate( &ordinalToCentroidRelativeOffset ))
+			if ( island->commitGeometry() )
 			{
 				usableIslands.insert( island );
 
-				foreach( const triangle &tri, island->triangulation() )
-				{
-					tri.vertices( triangleVertices );
+				#if VOXEL_MASS_PROPERTIES
 
-					//
-					//	For some reason, cpAreaForPoly and cpMomentForPoly are returning negative values.
-					//
+					moments += island->massMoments();
 
-					real pMass = density * std::abs( cpAreaForPoly( 3, triangleVertices ));
-					mass += pMass;
+				#else
 
-					real pMoment = cpMomentForPoly( pMass, 3, triangleVertices, cpvzero );
-					if ( !std::isnan( pMoment ))
+					foreach( const triangle &tri, island->triangulation() )
 					{
-						moment += std::abs( pMoment );
+						tri.vertices( triangleVertices );
+
+						//
+						//	For some reason, cpAreaForPoly and cpMomentForPoly are returning negative values.
+						//
+
+						real pArea = std::abs( cpAreaForPoly( 3, triangleVertices )),
+						     pMass = density * pArea;
+
+						area += pArea;
+						mass += pMass;
+
+						real pMoment = cpMomentForPoly( pMass, 3, triangleVertices, cpvzero );
+						if ( !std::isnan( pMoment ))
+						{
+							moment += std::abs( pMoment );
+						}
 					}
-				}					
+
+				#endif
 			}
 			else
 			{
@@ -862,6 +1038,31 @@ void DynamicIslandGroup::updatePhysics()
 			}
 		}
 		
+		#if VOXEL_MASS_PROPERTIES
+
+			//
+			//	A voxel at ordinal position p sits at r = p * scale + offset relative to the body, so the sum of
+			//	w |r|^2 expands to scale^2 sum( w |p|^2 ) + 2 scale offset . sum( w p ) + |offset|^2 sum( w ). 
+			//	Each voxel is a square of side scale, adding scale^2 / 6 per unit mass about its own center.
+			//
+
+			const double
+				scale = _terrain->voxelStore().scale(),
+				cellArea = scale * scale / 255,
+				ox = _ordinalToCentroidRelativeOffset.x,
+				oy = _ordinalToCentroidRelativeOffset.y,
+				distanceSquaredSum = 
+					scale * scale * moments.second + 
+					2 * scale * ( ox * moments.firstX + oy * moments.firstY ) + 
+					( ox * ox + oy * oy ) * moments.occupation;
+
+			area = cellArea * moments.occupation;
+			mass = density * area;
+			moment = density * cellArea * ( std::max( distanceSquaredSum, 0.0 ) + moments.occupation * scale * scale / 6 );
+
+		#endif
+
+		_area = area;
 		_mass = mass;
 		_moment = moment;
 		
@@ -897,31 +1098,14 @@ void DynamicIslandGroup::updatePhysics()
 			//	Now add collision shapes
 			//
 
-			cpVect triangleVertices[3];
 			foreach( Island *island, _islands )
 			{
-				foreach( const triangle &tri, island->triangulation() )
-				{
-					tri.vertices( triangleVertices );
-					
-					if ( cpPolyValidate( triangleVertices, 3 ) )
-					{
-						cpShape *polyShape = cpPolyShapeNew( _body, 3, triangleVertices, cpvzero );
-						
-						cpShapeSetUserData( polyShape, island );
-						cpShapeSetElasticity( polyShape, elasticity );
-						cpShapeSetFriction( polyShape, friction );
-						cpShapeSetLayers( polyShape, CollisionLayerMask::TERRAIN );
-						cpShapeSetCollisionType( polyShape, CollisionType::TERRAIN );
-											
-						cpSpaceAddShape( _space, polyShape );
-						_shapesByIsland[island].push_back(polyShape);
-					}
-				}
+				_createCollisionShapes( island );
 			}
 		}
 
 		_physicsDirty = false;
+		_physicsUpdatePending = false;
 		
 		//
 		//	Update matrices, aabbs, etc.
@@ -1027,6 +1211,10 @@ Terrain::Terrain():
 	_staticGroup(NULL),
 	_deferredGeometryUpdateTime(-1),
 	_geometryUpdateDeferralTime(0.25),
+	_cutRecording(NULL),
+	_nextCollisionDetailUpdateTime(0),
+	_nextDebrisBakeTime(0),
+	_nextDebrisBudgetTime(0),
 	_renderVoxelsInDebug(false)
 {
 	setName( "Terrain" );
@@ -1042,6 +1230,13 @@ Terrain::initialize( const init &initializer )
 {
 	GameObject::initialize(initializer);
 	_initializer = initializer;
+	
+	//
+	//	Hysteresis must leave a full detail radius, or islands which go coarse would never return to full detail
+	//
+	
+	_initializer.collisionDetailHysteresis = std::max< real >( std::min< real >( _initializer.collisionDetailHysteresis, 
+		_initializer.collisionDetailDistance * real(0.5) ), 0 );
 }
 
 void Terrain::addedToLevel( Level *level )
@@ -1057,9 +1252,6 @@ void Terrain::addedToLevel( Level *level )
 
 	ResourceManager *rm = level->resourceManager();
 
-	// make a local copy, since Island needs a non-const Surface &
-	ci::Surface levelImage = rm->getSurface( _initializer.levelImage );
-
 	_materialTex = rm->getTexture( _initializer.materialTexture );
 	_materialTex.setWrap( GL_REPEAT, GL_REPEAT );
 	
@@ -1076,11 +1268,46 @@ void Terrain::addedToLevel( Level *level )
 		setDrawPasses(2);
 	}
 
+	//
+	//	Sanity check
+	//
+	
+	assert( !_staticGroup );
+	assert( _dynamicGroups.empty() );
+	
+	_staticGroup = new StaticIslandGroup(_space, this);
+	addChild( _staticGroup );
+	
+	_workerPool.reset( new WorkerPool( _initializer.geometryWorkerThreads ));
+
+	//
+	//	If a cooked terrain matching the level image is available, load from it
+	//
+
+	ci::fs::path levelImagePath, cookedTerrainPath;
+	uint32_t levelImageChecksum = 0;
+	
+	const bool cooking = !_initializer.cookedTerrain.empty() && 
+		rm->findPath( _initializer.levelImage, levelImagePath ) && 
+		cooked::FileChecksum( levelImagePath, levelImageChecksum );
+	
+	if ( cooking && 
+	     rm->findPath( _initializer.cookedTerrain, cookedTerrainPath ) && 
+		 _loadCooked( cookedTerrainPath, levelImageChecksum ))
+	{
+		_capturePristineState();
+		return;
+	}
+
+	// make a local copy, since Island needs a non-const Surface &
+	ci::Surface levelImage = rm->getSurface( _initializer.levelImage );
+
 	gl::Texture::Format mipmappingFormat;
 	mipmappingFormat.enableMipmapping(true);
 	mipmappingFormat.setMinFilter( GL_LINEAR_MIPMAP_LINEAR );
 	mipmappingFormat.setMagFilter( GL_LINEAR );	
-	_modulationTex = gl::Texture( _createModulationSurface( levelImage ), mipmappingFormat );
+	_modulationSurface = _createModulationSurface( levelImage );
+	_modulationTex = gl::Texture( _modulationSurface, mipmappingFormat );
 	
 	
 	//
@@ -1094,10 +1321,12 @@ void Terrain::addedToLevel( Level *level )
 	height = std::min( height, levelImage.getHeight());
 	
 	//
-	//	Initialize the voxel store
+	//	Initialize the voxel store - tiles match sectors when sectors are in use, since the tile grid is laid
+	//	from the same origin, and are only allocated when an Island template takes ownership of voxels in them
 	//
 
-	_voxels.set( width, height, _initializer.scale );
+	const bool sectored = _initializer.sectorSize.x > 0 && _initializer.sectorSize.y > 0;
+	_voxels.set( width, height, _initializer.scale, sectored ? _initializer.sectorSize : Vec2i(64,64), _initializer.origin );
 	
 	//
 	//	Mark our bounds
@@ -1106,24 +1335,14 @@ void Terrain::addedToLevel( Level *level )
 	const real AABBInset = 1/_initializer.scale;
 	setAabb( cpBBNew(0, 0, width*_initializer.scale - AABBInset, (height-1)*_initializer.scale - AABBInset));
 
-	//
-	//	Sanity check
-	//
-	
-	assert( !_staticGroup );
-	assert( _dynamicGroups.empty() );
-	
-	_staticGroup = new StaticIslandGroup(_space, this);
-	addChild( _staticGroup );
-
 
 	//
 	//	the island(s) created here via the Surface constructor aren't tesselated, nor are they
-	//	given physics bodies; instead, they're immediately passed to _partitionIsland and the real gameplay islands are created
+	//	given physics bodies; instead, they're immediately passed to _partitionEach and the real gameplay islands are created
 	//
 	
 	std::set< Island* > islandTemplates;
-	if ( _initializer.sectorSize.x > 0 && _initializer.sectorSize.y > 0 )
+	if ( sectored )
 	{
 		for ( int y = _initializer.origin.y; y < height; y += _initializer.sectorSize.y )
 		{
@@ -1146,10 +1365,7 @@ void Terrain::addedToLevel( Level *level )
 	//
 
 	std::set< Island* > newIslands;
-	foreach( Island *island, islandTemplates )
-	{
-		_partitionIsland( island, newIslands );
-	}
+	_partitionEach( islandTemplates, newIslands );
 	
 	//
 	//	Now walk island connectivity to build an initial set of static and
@@ -1157,6 +1373,23 @@ void Terrain::addedToLevel( Level *level )
 	//
 
 	_createIslandGroups( newIslands );	
+	
+	//
+	//	Partitioning discards voxels which didn't make it into a usable island; free any tiles left unowned
+	//
+	
+	_voxels.compact();
+	
+	//
+	//	Cook the freshly loaded terrain, so the next load can skip all of the above
+	//
+	
+	if ( cooking && _initializer.recookTerrain )
+	{
+		cook();
+	}
+	
+	_capturePristineState();
 }
 
 
@@ -1187,6 +1420,8 @@ void Terrain::update( const time_state &time )
 		
 		_touchedScaledWorldPositionsByCut.clear();
 	}
+	
+	_updateCollisionDetail( time );
 }
 
 void Terrain::prepareForBatchDraw( const render_state &state, GameObject * )
@@ -1234,24 +1469,52 @@ void Terrain::cleanupAfterBatchDraw( const render_state &state, GameObject *, Ga
 
 void Terrain::updateGeometry( const time_state &time )
 {
+	//
+	//	Publish the result of an async partition, if one has completed. Until then, the old islands
+	//	and their collision shapes remain in play.
+	//
+	
+	_finishAsyncPartition( false );
+
 	//
 	//	If deferred geometry updates are pending, _deferredGeometryUpdateTime will be > 0; if enough time
 	//	has passed since the oldest cut to justify a geometry update, perform it and reset.
+	//	An async partition in flight holds on to its islands, so further updates wait until it's been published.
 	//
 
-	if (_deferredGeometryUpdateTime > 0)
+	if (_deferredGeometryUpdateTime > 0 && !_asyncPartition )
 	{
 		if ( time.time > _deferredGeometryUpdateTime )
 		{
 			if ( !_dirtyIslands.empty() )
 			{
-				_partitionIslands( _dirtyIslands );
+				if ( _initializer.asyncGeometryUpdates )
+				{
+					_beginAsyncPartition( _dirtyIslands );
+				}
+				else
+				{
+					_partitionIslands( _dirtyIslands );
+				}
+
 				_dirtyIslands.clear();
 			}
 			
 			_deferredGeometryUpdateTime = -1;
 		}
 	}
+	
+	//
+	//	Bake long-resting debris back into the static terrain, if enabled
+	//
+	
+	_bakeRestingDebris( time );
+	
+	//
+	//	Retire debris exceeding the budget, if one is set
+	//
+	
+	_retireExcessDebris( time );
 }
 
 void Terrain::_gatherAllIslands()
@@ -1298,14 +1561,12 @@ void Terrain::_createIslandGroups( std::set< Island* > all )
 	//	Now that we're done, update physics representations
 	//
 	
-	_staticGroup->updatePhysics();
+	_updateGroupPhysics();
 	_staticGroup->prune();
 		
 	std::set< DynamicIslandGroup* > remainingDynamicGroups;
 	foreach( DynamicIslandGroup* dg, _dynamicGroups )
 	{
-		dg->updatePhysics();
-		
 		if ( dg->prune() )
 		{
 			remainingDynamicGroups.insert( dg );
@@ -1401,14 +1662,12 @@ void Terrain::_updateIslandGroups( std::set< Island* > newIslands )
 	//	Update physics representations
 	//
 	
-	_staticGroup->updatePhysics();
+	_updateGroupPhysics();
 	_staticGroup->prune();
 
 	std::set< DynamicIslandGroup* > remainingDynamicGroups;
 	foreach( DynamicIslandGroup* dg, _dynamicGroups )
 	{
-		dg->updatePhysics();
-		
 		if ( dg->prune() )
 		{
 			remainingDynamicGroups.insert( dg );
@@ -1429,6 +1688,250 @@ void Terrain::_updateIslandGroups( std::set< Island* > newIslands )
 	_gatherAllIslands();
 }
 
+void Terrain::_updateGroupPhysics()
+{
+	//
+	//	Queue geometry preparation for every group's islands before waiting on any of them,
+	//	so a cut which affects several groups keeps all the worker threads busy. Bodies and 
+	//	collision shapes are then created here, on the main thread, since chipmunk isn't thread-safe.
+	//
+
+	_staticGroup->_beginUpdatePhysics( *_workerPool );
+	foreach( DynamicIslandGroup* dg, _dynamicGroups )
+	{
+		dg->_beginUpdatePhysics( *_workerPool );
+	}
+
+	_workerPool->wait();
+
+	//
+	//	Sum the time the workers spent preparing each island's geometry
+	//
+
+	std::vector< Island* > prepared( _staticGroup->_pendingIslands.begin(), _staticGroup->_pendingIslands.end() );
+	foreach( DynamicIslandGroup* dg, _dynamicGroups )
+	{
+		if ( dg->_physicsUpdatePending ) prepared.insert( prepared.end(), dg->_islands.begin(), dg->_islands.end() );
+	}
+
+	foreach( Island *island, prepared )
+	{
+		const terrain_phase_timings &t = island->_preparationTimings;
+		_phaseTimings.perimeters += t.perimeters;
+		_phaseTimings.triangulation += t.triangulation;
+		_phaseTimings.collisionPolygons += t.collisionPolygons;
+		_phaseTimings.islandsPrepared += t.islandsPrepared;
+	}
+
+	Stopwatch timer;
+
+	_staticGroup->_finishUpdatePhysics();
+	foreach( DynamicIslandGroup* dg, _dynamicGroups )
+	{
+		dg->_finishUpdatePhysics();
+	}
+
+	_phaseTimings.collisionShapes += timer.mark();
+}
+
+void Terrain::_updateCollisionDetail( const time_state &time )
+{
+	const real 
+		CoarseDistance = _initializer.collisionDetailDistance,
+		FullDetailDistance = CoarseDistance - _initializer.collisionDetailHysteresis;
+
+	if ( CoarseDistance <= 0 || time.time < _nextCollisionDetailUpdateTime ) return;
+	_nextCollisionDetailUpdateTime = time.time + CollisionDetailUpdateInterval;
+	
+	//
+	//	Gather the bounds of the player and monsters, and of static islands any non-static body is resting or 
+	//	moving on, so nothing settles onto a coarse shape; if there are none, there's nothing to measure against
+	//
+
+	_gatherEntityBounds( _collisionDetailFoci );
+	
+	if ( _staticGroup->body() )
+	{
+		cpBodyEachArbiter( _staticGroup->body(), gather_static_contact, &_collisionDetailFoci );
+	}
+	
+	if ( _collisionDetailFoci.empty() ) return;
+	
+	//
+	//	Islands switch to coarse collision beyond CoarseDistance, and back to full detail inside FullDetailDistance, 
+	//	so an entity lingering near the threshold doesn't rebuild shapes over and over
+	//
+
+	std::set< IslandGroup* > changedGroups;
+	foreach( Island *island, _allIslands )
+	{
+		real distance = std::numeric_limits< real >::max();
+		foreach( const cpBB &focus, _collisionDetailFoci )
+		{
+			distance = std::min( distance, BBDistance( island->aabb(), focus ));
+		}
+
+		const bool 
+			coarse = island->coarseCollision(),
+			wantsCoarse = coarse ? distance >= FullDetailDistance : distance > CoarseDistance;
+		
+		if ( wantsCoarse != coarse )
+		{
+			island->group()->_setCollisionDetail( island, wantsCoarse );
+			changedGroups.insert( island->group() );
+		}
+	}
+	
+	foreach( IslandGroup *group, changedGroups )
+	{
+		group->updateAabb();
+	}
+}
+
+void Terrain::_retireExcessDebris( const time_state &time )
+{
+	const std::size_t 
+		MaxGroups = std::max( _initializer.maxDebrisGroups, 0 ),
+		MaxVoxels = std::max( _initializer.maxDebrisVoxels, 0 );
+
+	const real MinArea = _initializer.minDebrisArea;
+
+	if (( MaxGroups == 0 && MaxVoxels == 0 && MinArea <= 0 ) || time.time < _nextDebrisBudgetTime ) return;
+	_nextDebrisBudgetTime = time.time + DebrisBudgetUpdateInterval;
+	
+	//
+	//	An async partition holds on to its islands, so wait for it to be published
+	//
+	
+	if ( _asyncPartition ) return;
+	
+	//
+	//	Score each group which can be retired by its area over its distance to the nearest player or monster,
+	//	so the smallest and farthest are retired first. Groups under MinArea are scored below all others, and
+	//	retired regardless of the budget. Groups with islands awaiting a partition are left for a later pass.
+	//
+
+	_gatherEntityBounds( _debrisFoci );
+	_debrisCandidates.clear();
+
+	std::size_t groups = _dynamicGroups.size(), voxels = 0;
+	foreach( DynamicIslandGroup *dg, _dynamicGroups )
+	{
+		voxels += dg->voxelCount();
+
+		bool dirty = false;
+		foreach( Island *island, dg->islands() )
+		{
+			if ( _dirtyIslands.count( island ))
+			{
+				dirty = true;
+				break;
+			}
+		}
+		
+		if ( dirty ) continue;
+
+		real distance = _debrisFoci.empty() ? 0 : std::numeric_limits< real >::max();
+		foreach( const cpBB &focus, _debrisFoci )
+		{
+			distance = std::min( distance, BBDistance( dg->aabb(), focus ));
+		}
+
+		const real score = dg->area() < MinArea ? -1 : dg->area() / ( 1 + distance );
+		_debrisCandidates.push_back( std::make_pair( score, dg ));
+	}
+	
+	std::sort( _debrisCandidates.begin(), _debrisCandidates.end(), debris_candidate_order() );
+	
+	//
+	//	Retire, crumbling each group to dust by way of debrisRetired
+	//
+
+	const real Scale = _voxels.scale();
+	std::size_t retired = 0;
+
+	for ( std::vector< std::pair< real, DynamicIslandGroup* > >::const_iterator 
+		candidate( _debrisCandidates.begin()), end( _debrisCandidates.end()); 
+		candidate != end; 
+		++candidate )
+	{
+		const bool overBudget = 
+			( MaxGroups > 0 && groups > MaxGroups ) || 
+			( MaxVoxels > 0 && voxels > MaxVoxels );
+
+		if ( candidate->first >= 0 && !overBudget ) break;
+		
+		DynamicIslandGroup *dg = candidate->second;
+		const Mat4r &modelview = dg->modelview();
+		const Vec2r offset = dg->ordinalToCentroidRelativeOffset();
+
+		_retiredDebrisPositions.clear();
+		foreach( Island *island, dg->islands() )
+		{
+			foreach( Voxel *v, island->voxels() )
+			{
+				if ( v->islandId == island->membershipId() && v->occupation >= MinimumVoxelOccupation )
+				{
+					_retiredDebrisPositions.push_back( modelview * ( Vec2r( v->ordinalPosition ) * Scale + offset ));
+				}
+			}
+		}
+		
+		debrisRetired( _retiredDebrisPositions, dg->linearVelocity() );
+
+		groups--;
+		voxels -= std::min( voxels, dg->voxelCount() );
+
+		_voxels.compact( _destroyDynamicGroup( dg ));
+		retired++;
+	}
+	
+	if ( retired > 0 )
+	{
+		_gatherAllIslands();
+	}
+}
+
+Recti Terrain::_destroyDynamicGroup( DynamicIslandGroup *group )
+{
+	Recti bounds;
+	bounds.x1 = bounds.y1 = INT_MAX;
+	bounds.x2 = bounds.y2 = INT_MIN;
+
+	std::set< Island* > islands = group->islands();
+	foreach( Island *island, islands )
+	{
+		const Recti islandBounds = island->voxelBoundsOrdinal();
+		bounds.x1 = std::min( bounds.x1, islandBounds.x1 );
+		bounds.y1 = std::min( bounds.y1, islandBounds.y1 );
+		bounds.x2 = std::max( bounds.x2, islandBounds.x2 );
+		bounds.y2 = std::max( bounds.y2, islandBounds.y2 );
+
+		group->removeIsland( island );
+		island->releaseVoxels();
+		delete island;
+	}
+
+	_dynamicGroups.erase( group );
+	removeChild( group );
+	delete group;
+	
+	return bounds;
+}
+
+void Terrain::_gatherEntityBounds( std::vector< cpBB > &bounds ) const
+{
+	bounds.clear();
+	foreach( GameObject *object, level()->objects() )
+	{
+		if ( GameObjectType::isEntity( object->type() ))
+		{
+			const cpBB &bb = object->aabb();
+			if ( bb.l <= bb.r && bb.b <= bb.t ) bounds.push_back( bb );
+		}
+	}
+}
+
 #pragma mark -
 #pragma mark Terrain Rendering
 
@@ -18,23 +18,33 @@
 
 #include <cinder/Function.h>
 #include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include "Common.h"
 #include "GameObject.h"
 #include "LineSegment.h"
 #include "Viewport.h"
 #include "GameConstants.h"
+#include "WorkerPool.h"
 
 #include "Voxel.h"
 
 namespace game { namespace terrain {
 
 class Island;
+struct island_perimeter_cache;
+struct island_partition;
+struct async_partition;
 class IslandGroup;
 class StaticIslandGroup;
 class DynamicIslandGroup;
 class Terrain;
 
+namespace cooked {
+	class Writer;
+	class Reader;
+}
+
 enum terrain_render_pass {
 
 	SOLID_GEOMETRY_PASS		= 0,
@@ -99,17 +109,19 @@ struct triangle
 /**
 	Represents the transform and velocity of an IslandGroup
 	Used to pass on position and momentum from one DynamicIslandGroup to
-	its children.
+	its children. The ordinal to centroid-relative offset is passed on too,
+	since with the transform it places the parent's voxels in the world.
 */
 
 struct island_group_dynamics {
 
-	Vec2r position, linearVelocity;
+	Vec2r position, linearVelocity, ordinalToCentroidRelativeOffset;
 	real angle, angularVelocity;
 
 	island_group_dynamics():
 		position( 0,0 ), 
 		linearVelocity( 0,0 ),
+		ordinalToCentroidRelativeOffset( 0,0 ),
 		angle( 0 ),
 		angularVelocity( 0 )
 	{}
@@ -123,6 +135,54 @@ inline std::ostream &operator << ( std::ostream &os, const island_group_dynamics
 	return os << "[position (" << igd.position.x << ", " << igd.position.y << ") angle: " << igd.angle << "]";
 }
 
+#pragma mark -
+#pragma mark voxel_mass_moments
+
+/**
+	@struct voxel_mass_moments
+	Sums of voxel occupation, and of its first and second moments about the ordinal origin, from which
+	DynamicIslandGroup finds its centre of mass and moment of inertia without visiting every voxel.
+	Double precision, since second moments of ordinal positions get large.
+*/
+
+struct voxel_mass_moments {
+
+	double occupation, firstX, firstY, second;
+
+	voxel_mass_moments():
+		occupation(0),
+		firstX(0),
+		firstY(0),
+		second(0)
+	{}
+
+	void add( const Voxel *v )
+	{
+		if ( v->occupation > 0 )
+		{
+			const double 
+				x = v->ordinalPosition.x,
+				y = v->ordinalPosition.y,
+				w = v->occupation;
+
+			occupation += w;
+			firstX += w * x;
+			firstY += w * y;
+			second += w * ( x * x + y * y );
+		}
+	}
+
+	voxel_mass_moments &operator += ( const voxel_mass_moments &m )
+	{
+		occupation += m.occupation;
+		firstX += m.firstX;
+		firstY += m.firstY;
+		second += m.second;
+		return *this;
+	}
+
+};
+
 /**
 	@struct perimeter_greeble_particle
 	Island draws greebling shapes around its perimeter. The perimeter_greeble_particle
@@ -136,6 +196,57 @@ struct perimeter_greeble_vertex {
 	ci::Vec4f color;
 };
 
+#pragma mark -
+#pragma mark terrain_phase_timings
+
+/**
+	@struct terrain_phase_timings
+	Seconds spent in each phase of cutting and updating terrain geometry. Perimeter, triangulation and collision 
+	polygon times are summed over islands prepared on the WorkerPool, so they measure processor time rather than 
+	elapsed time when the pool has threads. Greebling is made lazily as islands are drawn, and its time is summed
+	over each Island::updatePerimeterGreebling which made or translated greebling.
+*/
+struct terrain_phase_timings {
+
+	seconds_t cutApplication, partition, perimeters, triangulation, greebling, collisionPolygons, collisionShapes;
+	std::size_t cuts, partitions, islandsPrepared;
+
+	terrain_phase_timings():
+		cutApplication(0),
+		partition(0),
+		perimeters(0),
+		triangulation(0),
+		greebling(0),
+		collisionPolygons(0),
+		collisionShapes(0),
+		cuts(0),
+		partitions(0),
+		islandsPrepared(0)
+	{}
+
+};
+
+#pragma mark -
+#pragma mark disk_stencil
+
+/**
+	@struct disk_stencil
+	The voxels a Terrain::cutDisk of some radius touches, and how much the disk overlaps each, as offsets from the voxel
+	at the disk's center. Built by cutting::BuildDiskStencil for each quantized radius and sub-voxel center position a 
+	Terrain cuts with, and cached so repeated cuts just stamp it.
+*/
+struct disk_stencil {
+
+	struct cell {
+		Vec2i offset;
+		real overlap;	// from 0 for none to 1 for complete
+		bool clears;	// the disk overlaps the voxel so completely it's emptied
+	};
+
+	std::vector< cell > cells;
+
+};
+
 #pragma mark -
 #pragma mark Island
 
@@ -184,6 +295,17 @@ class Island : public core::GameObject
 		*/
 		const OrdinalVoxelStore *voxelStore() const { return _store; }
 		
+		/**
+			Get the id this Island is registered with in the voxel store, which its voxels record their membership by.
+			Zero once the island has released its voxels.
+		*/
+		uint16_t membershipId() const { return _membershipId; }
+		
+		/**
+			Return true if @a v is one of this Island's voxels
+		*/
+		inline bool owns( const Voxel *v ) const { return _store->partOfIsland( v, _membershipId ); }
+		
 		/**
 			Get the rectangle bounding the voxels used in this Island.
 			The rectangle bounds the Island's voxels' ordinalPositions. The ordinalPositions
@@ -191,6 +313,14 @@ class Island : public core::GameObject
 		*/
 		ci::Recti voxelBoundsOrdinal() const { return _vertexBoundsOrdinal; }
 		
+		/**
+			Get the occupation-weighted moments of this Island's voxels, from which DynamicIslandGroup finds its centre 
+			of mass and moment of inertia. They're summed when the Island is made; voxel occupation only changes 
+			by cutting, which repartitions the Island into new ones. A voxel shared with other Islands is only 
+			counted by its first owner, so no voxel is weighed twice.
+		*/
+		const voxel_mass_moments &massMoments() const { return _massMoments; }
+		
 		/**
 			FInds the voxel owned by this island which is closest to @a worldPosition and closer than
 			@a distThreshold
@@ -203,9 +333,31 @@ class Island : public core::GameObject
 		const std::vector< triangle > &triangulation() const { return _triangulation; }
 		
 		/**
-			Get this island's perimeter greebling particle array, in centroid-relative coordinate space
+			Get the convex polygons this Island's collision shapes are made from. These cover the same area 
+			as triangulation(), and are either its triangles, or those triangles merged into larger convex polygons.
+		*/
+		const std::vector< Vec2rVec > &collisionPolygons() const { return _collisionPolygons; }
+		
+		/**
+			Return true if this Island's collision shapes are made from a coarsely simplified perimeter, because 
+			it's far from any entity. See Terrain::init::collisionDetailDistance.
+		*/
+		bool coarseCollision() const { return _coarseCollision; }
+		
+		/**
+			Get this island's perimeter greebling particle array, in centroid-relative coordinate space.
+			This is empty until updatePerimeterGreebling() has been called since the island's geometry was last prepared.
 		*/
 		const std::vector< perimeter_greeble_vertex > &perimeterGreebleVertices() const { return _perimeterGreebleVertices; }
+		
+		/**
+			Greebling is made lazily, by IslandRenderer, so only islands which are drawn are greebled. Make this 
+			island's greebling for viewport @a zoom if it has none, or if what it has was made for a zoom in a different
+			density level; greebles are spaced more sparsely and drawn larger as the view zooms out.
+			Must be called on the main thread.
+			@return true if perimeterGreebleVertices() changed
+		*/
+		bool updatePerimeterGreebling( real zoom );
 
 		/**
 			Return true if this Island can be used, e.g., has a viable triangulation
@@ -223,6 +375,12 @@ class Island : public core::GameObject
 		*/
 		bool entirelyFixed() const { return _entirelyFixed; }
 		
+		/**
+			Get the Islands which share voxels with this one. Shared voxels are only assigned when an Island is created,
+			so the set is built then, and Islands remove themselves from their neighbors' sets when destroyed.
+		*/
+		const std::set< Island* > &adjacentIslands() const { return _adjacentIslands; }
+		
 		/**
 			Set the IslandGroup membership of this Island
 		*/
@@ -239,6 +397,21 @@ class Island : public core::GameObject
 			@return true if the Island is usable
 		*/
 		bool triangulate( Vec2r const *ordinalToCentroidRelativeOffset = NULL );
+		
+		/**
+			The first half of triangulate(): create perimeters, triangulation and collision polygons for this Island's shape.
+			This touches neither GL nor chipmunk, and only writes to this Island's own state, so it may be run
+			on a worker thread, concurrently with prepareGeometry() on other Islands. 
+			Call commitGeometry() on the main thread afterwards.
+		*/
+		void prepareGeometry( Vec2r const *ordinalToCentroidRelativeOffset );
+		
+		/**
+			The second half of triangulate(): release the renderer's state for the previous geometry.
+			Must be called on the main thread.
+			@return true if the Island is usable
+		*/
+		bool commitGeometry();
 
 	private:
 	
@@ -246,12 +419,91 @@ class Island : public core::GameObject
 		friend class Terrain;
 
 		bool _createVoxelPerimeters(); // implemented in Island_perimeter.cpp
+		
+		/**
+			Note that the voxel at @a ordinal was modified; the next call to _createVoxelPerimeters
+			will re-march only the cells around the modified voxels, if it can.
+		*/
+		inline void _markDirty( const Vec2i &ordinal )
+		{
+			_dirtyRectOrdinal.x1 = std::min( _dirtyRectOrdinal.x1, ordinal.x );
+			_dirtyRectOrdinal.y1 = std::min( _dirtyRectOrdinal.y1, ordinal.y );
+			_dirtyRectOrdinal.x2 = std::max( _dirtyRectOrdinal.x2, ordinal.x );
+			_dirtyRectOrdinal.y2 = std::max( _dirtyRectOrdinal.y2, ordinal.y );
+		}
+		
+		inline bool _dirty() const { return _dirtyRectOrdinal.x1 <= _dirtyRectOrdinal.x2; }
+		
+		void _clearDirty();
+		
+		/**
+			Take @a parent's marching squares state and dirty region. Called when partitioning 
+			@a parent produced only this Island, so it can update its perimeters incrementally.
+		*/
+		void _inheritPerimeters( Island *parent );
+		
+		/**
+			March a perimeter for voxels at @a ordinals with @a occupations, which need not be owned by an Island,
+			and so can be run off the main thread against a snapshot of voxel state. Populates @a cache, which can be
+			handed to an Island made of the same voxels via _adoptGeometry, and @a perimeters.
+			@return true if the perimeters are usable
+		*/
+		static bool _createDetachedPerimeters( const std::vector< Vec2i > &ordinals, 
+		                                       const std::vector< uint8_t > &occupations,
+		                                       real scale,
+		                                       boost::shared_ptr< island_perimeter_cache > &cache,
+		                                       std::vector< Vec2rVec > &perimeters );
+		
+		/**
+			Take marching state from _createDetachedPerimeters, and a triangulation of its perimeters made at zero offset. 
+			The next triangulate() translates @a untranslatedTriangulation rather than triangulating from scratch.
+		*/
+		void _adoptGeometry( const boost::shared_ptr< island_perimeter_cache > &cache, std::vector< triangle > &untranslatedTriangulation );
+
+		/**
+			Take greeble vertices made at zero offset and the densest level, e.g., by Terrain::cook. They're used 
+			by updatePerimeterGreebling at that level, rather than greebling from scratch.
+		*/
+		void _adoptGreebling( std::vector< perimeter_greeble_vertex > &untranslatedGreebleVertices );
+
+		/**
+			Serialize marching state, as made by _createDetachedPerimeters, for a cooked terrain file
+		*/
+		static void _writePerimeterCache( cooked::Writer &writer, const boost::shared_ptr< island_perimeter_cache > &cache );
+
+		/**
+			Read marching state written by _writePerimeterCache. Returns false if @a reader runs short.
+		*/
+		static bool _readPerimeterCache( cooked::Reader &reader, boost::shared_ptr< island_perimeter_cache > &cache );
+
 		bool _triangulate( Vec2r const *ordinalToCentroidRelativeOffset );
-		void _triangulatePerimeters( const std::vector< Vec2rVec > &ordinalSpacePerimeter, 
-		                             const Vec2r &offset, 
-		                             std::vector< triangle > &triangulation );
+		static void _triangulatePerimeters( const OrdinalVoxelStore &store,
+		                                    const std::vector< Vec2rVec > &ordinalSpacePerimeter, 
+		                                    const Vec2r &offset, 
+		                                    std::vector< triangle > &triangulation );
 
-		void _createPerimeterGreebling( Vec2r const *ordinalToCentroidRelativeOffset );
+		/**
+			Make greebling for density @a level at zero offset, into _untranslatedGreebleVertices
+		*/
+		void _createPerimeterGreebling( int level );
+		
+		void _createCollisionPolygons();
+		
+		/**
+			Populate @a polygons with convex collision polygons covering @a triangulation
+		*/
+		void _createCollisionPolygons( const std::vector< triangle > &triangulation, std::vector< Vec2rVec > &polygons ) const;
+		
+		/**
+			Make _coarseCollisionPolygons by simplifying _voxelPerimeters per Terrain::init::coarseCollisionSimplification 
+			and triangulating them at @a ordinalToCentroidRelativeOffset. Returns false if nothing usable remains.
+		*/
+		bool _createCoarseCollisionPolygons( const Vec2r &ordinalToCentroidRelativeOffset );
+		
+		/**
+			Record adjacency between this Island and each Island sharing its voxels, in both directions
+		*/
+		void _linkAdjacentIslands();
 
 		
 		void _setGroupDynamics( const island_group_dynamics &igd )
@@ -269,17 +521,47 @@ class Island : public core::GameObject
 		class IslandRenderer *_renderer;
 		IslandGroup *_group;
 		OrdinalVoxelStore *_store;
+		uint16_t _membershipId;
 		island_group_dynamics _gd;
 
 		bool _usable, _fixed, _entirelyFixed;
 		ci::Recti _vertexBoundsOrdinal;
+		voxel_mass_moments _massMoments;
 		std::vector<Voxel*> _voxels;
+		std::set< Island* > _adjacentIslands;
 		std::vector< Vec2rVec > _voxelPerimeters;
 		std::vector< triangle > _triangulation;
 		
+		std::vector< Vec2rVec > _collisionPolygons;
+		
+		// collision polygons from coarsely simplified perimeters, and whether collision shapes are made from them
+		std::vector< Vec2rVec > _coarseCollisionPolygons;
+		bool _coarseCollision;
+		
+		// triangulation at zero offset, made off the main thread by an async partition
+		std::vector< triangle > _untranslatedTriangulation;
+		bool _hasUntranslatedTriangulation;
+		
+		// ordinal bounds of voxels modified since last perimeter generation, and the marching state to update incrementally
+		ci::Recti _dirtyRectOrdinal;
+		boost::shared_ptr< island_perimeter_cache > _perimeterCache;
+		
 		// perimeter greeble particle voxels, in centroid-relative space
 		std::vector< perimeter_greeble_vertex > _perimeterGreebleVertices;
 		
+		// time spent in each phase of the last prepareGeometry
+		terrain_phase_timings _preparationTimings;
+		
+		// greeble vertices at zero offset made for density _greeblingLevel ( -1 if none ); _hasUntranslatedGreebling 
+		// if they were adopted from a cooked terrain, and should survive the next prepareGeometry
+		std::vector< perimeter_greeble_vertex > _untranslatedGreebleVertices;
+		int _greeblingLevel;
+		bool _hasUntranslatedGreebling;
+		
+		// offset _perimeterGreebleVertices were translated to, if _greeblingTranslated
+		Vec2r _greeblingOffset;
+		bool _greeblingTranslated;
+		
 };
 
 #pragma mark -
@@ -306,13 +588,36 @@ class IslandGroup : public core::GameObject
 		const Mat4r &modelview() const { return _modelview; }
 		const Mat4r &modelviewInverse();
 
+		/**
+			Get the offset from a member voxel's scaled ordinal position to its centroid-relative position.
+			Centroid-relative positions are unrotated, so this is the same for every voxel in the group,
+			and zero for the static group.
+		*/
+		const Vec2r &ordinalToCentroidRelativeOffset() const { return _ordinalToCentroidRelativeOffset; }
+
+		/**
+			Get the position of member voxel @a v relative to the group's centroid, unrotated. Voxels don't store
+			their positions; every voxel of a group shares its transform, so they're derived from ordinalPosition.
+		*/
+		Vec2r centroidRelativePosition( const Voxel *v ) const;
+
+		/**
+			Get the world space position of member voxel @a v
+		*/
+		Vec2r worldPosition( const Voxel *v ) const { return _modelview * centroidRelativePosition( v ); }
+
 		real angle() const;
 		real angularVelocity() const;
 		Vec2r position() const;
 		Vec2r linearVelocity() const;
 		
 		void freeCollisionShapes();
-		virtual void updatePhysics(){}
+		
+		/**
+			Rebuild this group's physics representation if its islands changed. Island geometry is prepared
+			on the Terrain's WorkerPool. Terrain updates all groups at once, so their islands share the pool.
+		*/
+		void updatePhysics();
 		virtual void updateAabb();
 
 		/**
@@ -351,6 +656,31 @@ class IslandGroup : public core::GameObject
 	protected:
 	
 		friend class Terrain;
+		
+		/**
+			First phase of updatePhysics, run on the main thread. Queue an Island::prepareGeometry 
+			job on @a pool for each island needing new geometry.
+		*/
+		virtual void _beginUpdatePhysics( core::WorkerPool &pool ){}
+
+		/**
+			Final phase of updatePhysics, run on the main thread after the jobs queued 
+			by _beginUpdatePhysics have completed. Build bodies and collision shapes.
+		*/
+		virtual void _finishUpdatePhysics(){}
+		
+		/**
+			Add a collision shape to _body for each of @a island's collision polygons, and record their ownership.
+			If the island has coarse collision, its coarse collision polygons are used when it has any.
+		*/
+		void _createCollisionShapes( Island *island );
+		
+		/**
+			Replace @a island's collision shapes with shapes made from its coarse, or full detail, collision polygons
+		*/
+		void _setCollisionDetail( Island *island, bool coarse );
+	
+	protected:
 	
 		typedef std::vector< cpShape* > cpShapeVec;
 		typedef std::map< Island*, cpShapeVec > IslandShapeVecMap;
@@ -360,6 +690,7 @@ class IslandGroup : public core::GameObject
 		cpBody *_body;
 		IslandShapeVecMap _shapesByIsland;
 		Mat4r _modelview, _modelviewInverse;
+		Vec2r _ordinalToCentroidRelativeOffset;
 		bool _modelviewInverseDirty, _sleeping;
 		real _area, _mass, _moment;
 
@@ -374,10 +705,25 @@ class StaticIslandGroup : public IslandGroup
 		virtual ~StaticIslandGroup();
 
 		virtual bool fixed() const { return true; }
-		virtual void updatePhysics();
 
+		/**
+			Add an island to the static group. Its geometry and collision shapes are created 
+			on the next call to updatePhysics(), which deletes it if it turns out to be unusable.
+		*/
 		virtual bool addIsland( Island *island );
 		virtual bool removeIsland( Island *island );
+		
+	protected:
+	
+		friend class Terrain;
+	
+		virtual void _beginUpdatePhysics( core::WorkerPool &pool );
+		virtual void _finishUpdatePhysics();
+		
+	protected:
+	
+		// islands added since the last updatePhysics
+		std::set< Island* > _pendingIslands;
 };
 
 
@@ -393,7 +739,6 @@ class DynamicIslandGroup : public IslandGroup
 		virtual bool fixed() const { return false; }
 
 		virtual void update( const core::time_state &time );
-		virtual void updatePhysics();
 		
 		virtual bool addIsland( Island *island );
 		virtual bool removeIsland( Island *island );
@@ -408,11 +753,250 @@ class DynamicIslandGroup : public IslandGroup
 		*/
 		void sanitize( std::vector< DynamicIslandGroup* > &newGroups );
 		
+		/**
+			Get the level time at which this group's body was last seen awake
+		*/
+		seconds_t lastAwakeTime() const { return _lastAwakeTime; }
+		
+		/**
+			Get the number of voxels held by this group's islands, as of its last physics update
+		*/
+		std::size_t voxelCount() const { return _voxelCount; }
+		
+		/**
+			Move this group's body to @a position and @a angle, as replaying a recorded cut does, updating
+			modelview and bounds at once rather than at the next update()
+		*/
+		void setPose( const Vec2r &position, real angle );
+		
+	protected:
+	
+		friend class Terrain;
+	
+		virtual void _beginUpdatePhysics( core::WorkerPool &pool );
+		virtual void _finishUpdatePhysics();
+		
 	protected:
 	
-		bool _physicsDirty;
+		bool _physicsDirty, _physicsUpdatePending;
 		island_group_dynamics _inheritedDynamics;
 		
+		// body position and ordinal to centroid-relative offset computed by _beginUpdatePhysics
+		Vec2r _pendingPosition, _pendingOrdinalToCentroidRelativeOffset;
+		
+		seconds_t _lastAwakeTime;
+		std::size_t _voxelCount;
+};
+
+#pragma mark -
+#pragma mark terrain_snapshot
+
+/**
+	@struct terrain_snapshot
+	A Terrain's voxel planes, island membership and island group transforms, as captured by Terrain::snapshot.
+	Everything is encoded against the terrain as it was loaded, so a snapshot of a mostly uncut terrain is small.
+*/
+struct terrain_snapshot
+{
+	struct group_state
+	{
+		bool fixed;
+		island_group_dynamics dynamics;
+	};
+
+	// count of tiles changed since load, then per changed tile its index ( as a gap from the previous one ) and the
+	// run-length encoded XOR of its occupation, strength, id and connectivity planes against its loaded planes
+	std::vector< uint8_t > voxels;
+
+	// per island: group index, then either the index + 1 of an identical loaded island, or 0 and its voxel runs
+	std::vector< uint8_t > islands;
+
+	// group_state of the static group, then of each dynamic group
+	std::vector< group_state > groups;
+
+	/**
+		Bytes held by the encoded state
+	*/
+	std::size_t size() const
+	{
+		return voxels.size() + islands.size() + groups.size() * sizeof( group_state );
+	}
+};
+
+#pragma mark -
+#pragma mark recorded_cut
+
+/**
+	@struct recorded_group_pose
+	Where a dynamic island group was when a cut was recorded: the world position of one of its voxels, referred to
+	by the voxel's ordinal position, and the group's angle.
+*/
+struct recorded_group_pose : public core::util::JsonInitializable {
+
+	Vec2i island;
+	Vec2r position;
+	real angle;
+	
+	recorded_group_pose():
+		island(-1,-1),
+		position(0,0),
+		angle(0)
+	{}
+	
+	//JsonInitializable
+	virtual void initialize( const ci::JsonTree &v )
+	{
+		JSON_READ(v,island);
+		JSON_READ(v,position);
+		JSON_READ(v,angle);
+	}
+
+};
+
+/**
+	@struct recorded_cut
+	A call to Terrain::cutLine, cutDisk or cutTerrain, recorded by Terrain::setCutRecording for Terrain::replayCut.
+	Islands are referred to by the ordinal position of one of their voxels, and resolved to whichever island
+	owns that voxel at replay. The poses of dynamic groups near the cut are recorded too, since physics isn't 
+	stepped during replay; replayCut moves the groups back where they were, so the cut lands on the same voxels.
+*/
+struct recorded_cut : public core::util::JsonInitializable {
+
+	enum kind {
+		LINE,
+		DISK,
+		TERRAIN
+	};
+
+	kind type;
+	seconds_t time;
+	Vec2r start, end;		// line start and end; disk position is start
+	real size;				// line thickness or disk radius
+	real strength;
+	TerrainCutType::cut_type cutType;
+	Vec2i restrictToIsland;	// ( -1, -1 ) if none
+	Vec2i cuttingIsland;	// for TERRAIN cuts
+	std::vector< recorded_group_pose > poses;
+	
+	recorded_cut():
+		type(LINE),
+		time(0),
+		start(0,0),
+		end(0,0),
+		size(0),
+		strength(0),
+		cutType(TerrainCutType::MANUAL),
+		restrictToIsland(-1,-1),
+		cuttingIsland(-1,-1)
+	{}
+	
+	static const char *typeName( kind type )
+	{
+		switch( type )
+		{
+			case LINE: return "line";
+			case DISK: return "disk";
+			case TERRAIN: return "terrain";
+		}
+		
+		return "line";
+	}
+
+	//JsonInitializable
+	virtual void initialize( const ci::JsonTree &v )
+	{
+		std::string typeName;
+		if ( core::util::read( v, "type", typeName ))
+		{
+			if ( typeName == "disk" ) type = DISK;
+			else if ( typeName == "terrain" ) type = TERRAIN;
+			else type = LINE;
+		}
+
+		JSON_READ(v,time);
+		JSON_READ(v,start);
+		JSON_READ(v,end);
+		JSON_READ(v,size);
+		JSON_READ(v,strength);
+		JSON_CAST_READ(v,TerrainCutType::cut_type,int,cutType);
+		JSON_READ(v,restrictToIsland);
+		JSON_READ(v,cuttingIsland);
+		
+		if ( v.hasChild("poses"))
+		{
+			const ci::JsonTree ps( v["poses"] );
+			for ( ci::JsonTree::ConstIter pose(ps.begin()),end(ps.end()); pose != end; ++pose )
+			{
+				recorded_group_pose groupPose;
+				groupPose.initialize(*pose);
+				poses.push_back(groupPose);
+			}
+		}
+	}
+	
+};
+
+#pragma mark -
+#pragma mark cut_primitive
+
+/**
+	@struct cut_primitive
+	One cut of a Terrain::cutBatch - a line as passed to Terrain::cutLine, a disk as passed to Terrain::cutDisk, 
+	or a cutting island as passed to Terrain::cutTerrain. Use the factory functions to make them.
+*/
+struct cut_primitive {
+
+	enum kind {
+		LINE,
+		DISK,
+		TERRAIN
+	};
+
+	kind type;
+	Vec2r start, end;		// line start and end in world space; disk position is start
+	real size;				// line thickness or disk radius
+	real strength;
+	Island *cuttingIsland;	// for TERRAIN cuts
+	
+	cut_primitive():
+		type(LINE),
+		start(0,0),
+		end(0,0),
+		size(0),
+		strength(0),
+		cuttingIsland(NULL)
+	{}
+
+	static cut_primitive line( const Vec2r &start, const Vec2r &end, real thickness, real strength )
+	{
+		cut_primitive cut;
+		cut.type = LINE;
+		cut.start = start;
+		cut.end = end;
+		cut.size = thickness;
+		cut.strength = strength;
+		return cut;
+	}
+
+	static cut_primitive disk( const Vec2r &position, real radius, real strength )
+	{
+		cut_primitive cut;
+		cut.type = DISK;
+		cut.start = cut.end = position;
+		cut.size = radius;
+		cut.strength = strength;
+		return cut;
+	}
+
+	static cut_primitive terrain( Island *cuttingIsland, real strength )
+	{
+		cut_primitive cut;
+		cut.type = TERRAIN;
+		cut.strength = strength;
+		cut.cuttingIsland = cuttingIsland;
+		return cut;
+	}
+
 };
 
 #pragma mark -
@@ -439,6 +1023,45 @@ class Terrain : public core::GameObject, public core::BatchDrawDelegate
 			real greebleSize;
 			bool greebleTextureIsMask;
 			
+			// number of threads preparing island geometry, in addition to the main thread; -1 sizes to the hardware
+			int geometryWorkerThreads;
+			
+			// if true, collision shapes are made by merging each island's triangulation into convex polygons, rather than one per triangle
+			bool mergeCollisionPolygons;
+			
+			// if true, deferred geometry updates partition and triangulate on a background thread, and are published in a later frame
+			bool asyncGeometryUpdates;
+			
+			// if set, islands and their geometry are loaded from this cooked file ( found like levelImage ) when it matches levelImage
+			ci::fs::path cookedTerrain;
+			
+			// if true, and cookedTerrain is set but missing or stale, the terrain is cooked to it after loading from levelImage.
+			// Meant for development only - shipped levels should carry a cooked file made offline with Terrain::cook()
+			bool recookTerrain;
+			
+			// islands farther than this from every player and monster get coarse collision shapes, unless a 
+			// non-static body is touching them; zero disables
+			real collisionDetailDistance;
+			
+			// islands with coarse collision return to full detail once within collisionDetailDistance - collisionDetailHysteresis;
+			// clamped to at most half of collisionDetailDistance
+			real collisionDetailHysteresis;
+			
+			// simplification threshold for coarse collision perimeters, in voxels; compare PerimeterOptimizationLinearDistanceThreshold
+			real coarseCollisionSimplification;
+			
+			// dynamic island groups which have slept in contact with static terrain for this many seconds are baked into it; zero disables
+			seconds_t debrisBakeTime;
+			
+			// when there are more dynamic island groups than this, the smallest and farthest from any player or monster are retired; zero is unlimited
+			int maxDebrisGroups;
+			
+			// when dynamic island groups hold more voxels than this in total, the smallest and farthest are retired; zero is unlimited
+			int maxDebrisVoxels;
+			
+			// dynamic island groups with less area than this are retired; zero disables
+			real minDebrisArea;
+			
 			init():
 				sectorSize(64,64),
 				origin(0,0),
@@ -449,7 +1072,18 @@ class Terrain : public core::GameObject, public core::BatchDrawDelegate
 				elasticity(0),
 				friction(0.5),
 				greebleSize(0.5),
-				greebleTextureIsMask(true)
+				greebleTextureIsMask(true),
+				geometryWorkerThreads(-1),
+				mergeCollisionPolygons(true),
+				asyncGeometryUpdates(false),
+				recookTerrain(false),
+				collisionDetailDistance(0),
+				collisionDetailHysteresis(8),
+				coarseCollisionSimplification(2),
+				debrisBakeTime(0),
+				maxDebrisGroups(0),
+				maxDebrisVoxels(0),
+				minDebrisArea(0)
 			{}
 						
 			//JsonInitializable
@@ -469,6 +1103,18 @@ class Terrain : public core::GameObject, public core::BatchDrawDelegate
 				JSON_READ(v,greebleTextureAtlas);
 				JSON_READ(v,greebleSize);
 				JSON_READ(v,greebleTextureIsMask);				
+				JSON_READ(v,geometryWorkerThreads);
+				JSON_READ(v,mergeCollisionPolygons);
+				JSON_READ(v,asyncGeometryUpdates);
+				JSON_READ(v,cookedTerrain);
+				JSON_READ(v,recookTerrain);
+				JSON_READ(v,collisionDetailDistance);
+				JSON_READ(v,collisionDetailHysteresis);
+				JSON_READ(v,coarseCollisionSimplification);
+				JSON_READ(v,debrisBakeTime);
+				JSON_READ(v,maxDebrisGroups);
+				JSON_READ(v,maxDebrisVoxels);
+				JSON_READ(v,minDebrisArea);
 			}
 
 						
@@ -498,6 +1144,14 @@ class Terrain : public core::GameObject, public core::BatchDrawDelegate
 			Such a cut causes one or more Islands to transition from fixed to dynamic.
 		*/
 		signals::signal< void( Island* ) > cutTransitionedIslandFromStaticToDynamic;
+		
+		/**
+			Emitted when a dynamic island group is retired to keep within the debris budget ( see init::maxDebrisGroups ),
+			passing the world space positions of its occupied voxels, and its linear velocity. The group is deleted right after.
+			
+			You can use this to crumble the group into a particle effect.
+		*/
+		signals::signal< void( const Vec2rVec &, const Vec2r & ) > debrisRetired;
 
 	
 	public:
@@ -531,6 +1185,11 @@ class Terrain : public core::GameObject, public core::BatchDrawDelegate
 						
 		const std::vector< Island* > &allIslands() const { return _allIslands; }
 		
+		/**
+			Get the WorkerPool used to prepare island geometry
+		*/
+		core::WorkerPool &workerPool() const { return *_workerPool; }
+		
 		/**
 			Cut a line through the terrain
 
@@ -579,6 +1238,80 @@ class Terrain : public core::GameObject, public core::BatchDrawDelegate
 			real strength,
 			TerrainCutType::cut_type cutType,
 			Island *restrictToIsland = NULL );
+
+		/**
+			Apply @a cuts as if by cutLine, cutDisk and cutTerrain, but filter the islands they might touch once for
+			the whole batch, and apply every line touching an island in a single pass over its affected voxels. Disks
+			stamp the same stencils cutDisk does, after the lines, so a disk cuts the same voxels either way; they're 
+			applied to the islands they touch, unless @a restrictToIsland is given.
+			Lines are unchunked, since only the voxels under each are visited.
+
+			@return mask of CutResult describing the effect the cuts had, together
+		*/
+		unsigned int cutBatch(
+			const std::vector< cut_primitive > &cuts,
+			TerrainCutType::cut_type cutType,
+			Island *restrictToIsland = NULL );
+			
+		/**
+			Write the terrain's voxels, islands and their geometry to a cooked file at @a path, which a later
+			load with init::cookedTerrain naming it will use instead of decoding levelImage and tessellating.
+			Pending geometry updates are completed first. Returns false if the file couldn't be written.
+		*/
+		bool cook( const ci::fs::path &path );
+
+		/**
+			Cook the terrain to init::cookedTerrain, found like levelImage, or beside levelImage if it doesn't exist yet.
+			This is the offline cooking step; cook the level as loaded, before it's been cut.
+		*/
+		bool cook();
+		
+		/**
+			Capture the terrain's voxel occupation, strength and connectivity, island membership, and the transform
+			and velocity of each dynamic island group into @a state. Pending geometry updates are completed first.
+		*/
+		void snapshot( terrain_snapshot &state );
+		
+		/**
+			Replace the terrain's islands and groups with those captured in @a state, without re-partitioning.
+			Returns false, having changed nothing, if @a state wasn't captured from this terrain.
+		*/
+		bool restore( const terrain_snapshot &state );
+			
+		/**
+			Complete any deferred or in-flight partitioning now, rather than waiting for updateGeometry
+		*/
+		void completeGeometryUpdates();
+		
+		seconds_t geometryUpdateDeferralTime() const { return _geometryUpdateDeferralTime; }
+		
+		/**
+			Get the time spent in each phase of cutting and geometry updates since the last resetPhaseTimings()
+		*/
+		const terrain_phase_timings &phaseTimings() const { return _phaseTimings; }
+		void resetPhaseTimings() { _phaseTimings = terrain_phase_timings(); }
+		
+		/**
+			Add time an Island spent in updatePerimeterGreebling to phaseTimings()
+		*/
+		void addGreeblingTime( seconds_t seconds ) { _phaseTimings.greebling += seconds; }
+		
+		/**
+			Get a snapshot of the terrain as it was when loading completed. It's made from the loaded state
+			snapshots are encoded against, the first time it's asked for.
+		*/
+		const terrain_snapshot &loadedState();
+		
+		/**
+			While @a recording is non-NULL, every cut is appended to it with the level time it was made at
+		*/
+		void setCutRecording( std::vector< recorded_cut > *recording ) { _cutRecording = recording; }
+		std::vector< recorded_cut > *cutRecording() const { return _cutRecording; }
+		
+		/**
+			Perform a recorded cut. Returns its CutResult mask; zero if it refers to an island which no longer exists.
+		*/
+		unsigned int replayCut( const recorded_cut &cut );
 			
 		void setRenderVoxelsInDebug( bool rv ) { _renderVoxelsInDebug = rv; }
 		bool renderVoxelsInDebug() const { return _renderVoxelsInDebug; }
@@ -586,18 +1319,135 @@ class Terrain : public core::GameObject, public core::BatchDrawDelegate
 	protected:
 			
 		void _markDeferredGeometryUpdateNeeded();
-			
+		
+		/**
+			Load voxels and islands from the cooked file at @a path, if it was cooked from a level image with
+			@a sourceChecksum and with the current init parameters. Returns false, having changed nothing, if not.
+		*/
+		bool _loadCooked( const ci::fs::path &path, uint32_t sourceChecksum );
+		
+		/**
+			Checksum of the init values a cooked terrain depends on
+		*/
+		uint32_t _cookingParametersChecksum() const;
+		
+		/**
+			Record the voxel planes and island membership snapshots are encoded against. Called once loading completes.
+		*/
+		void _capturePristineState();
+		
+		/**
+			Fill @a planes with the occupation, strength, id and connectivity masks of the voxels of tile @a t,
+			one tile-sized plane after the other. An unallocated tile is all zero.
+		*/
+		void _gatherTilePlanes( std::size_t t, uint8_t *planes ) const;
+		
+		/**
+			Append the state of the static group, then of each dynamic group, to @a groups, recording each group's index
+		*/
+		void _gatherGroupStates( std::vector< terrain_snapshot::group_state > &groups, std::map< IslandGroup*, std::size_t > &groupIndices ) const;
+		
 		/**
+			Append a cut to _cutRecording
+		*/
+		void _recordCut( recorded_cut::kind type, const Vec2r &start, const Vec2r &end, real size, real strength, 
+		                 TerrainCutType::cut_type cutType, Island *restrictToIsland, Island *cuttingIsland );
 			
+		/**
+			Partition @a islands into new Islands. If @a partitioned is non-NULL, it holds the result of an async partition
+			of exactly these islands, and its voxel groupings and geometry are used rather than partitioning here.
 			Implemented in Terrain_cutting.cpp
 		*/
-		void _partitionIslands( std::set< Island* > &islands );
+		void _partitionIslands( std::set< Island* > &islands, async_partition *partitioned = NULL );
 
 		/**
-			
+			Partition each of @a islands with _partitionIsland, populating @a newIslands. The islands are deleted.
+			Implemented in Terrain_cutting.cpp
+		*/
+		void _partitionEach( const std::set< Island* > &islands, std::set< Island* > &newIslands );
+
+		/**
+			Split @a island into an Island per connected group of its voxels, populating @a newIslands, and delete it.
+			If @a labeled is non-NULL it is @a island's snapshot, already labeled by _labelSnapshot.
+			Implemented in Terrain_cutting.cpp
+		*/
+		void _partitionIsland( Island *island, std::set< Island* > &newIslands, const island_partition *labeled = NULL );
+		
+		/**
+			Move @a voxels from @a moribundIsland to a new Island, returning it, or NULL if there are too few voxels for one.
 			Implemented in Terrain_cutting.cpp
 		*/
-		void _partitionIsland( Island *island, std::set< Island* > &newIslands );
+		Island *_createPartitionedIsland( Island *moribundIsland, const std::vector< Voxel* > &voxels );
+		
+		/**
+			Snapshot the voxel state of @a islands and partition and triangulate them on a background thread.
+			The result is published by _finishAsyncPartition. Implemented in Terrain_cutting.cpp
+		*/
+		void _beginAsyncPartition( const std::set< Island* > &islands );
+		
+		/**
+			Publish the running async partition, if any. If @a wait is false and it hasn't completed, do nothing.
+			If any of its islands were cut again while it ran, they're partitioned synchronously instead.
+			@return true if no async partition is running on return. Implemented in Terrain_cutting.cpp
+		*/
+		bool _finishAsyncPartition( bool wait );
+
+		/**
+			Background half of an async partition: label and triangulate one island's snapshot. Doesn't touch live voxels.
+			Implemented in Terrain_cutting.cpp
+		*/
+		static void _partitionSnapshot( island_partition &partition, const OrdinalVoxelStore *store );
+		static void _runAsyncPartition( async_partition *partition, const OrdinalVoxelStore *store );
+
+		/**
+			Record what partitioning reads from each of @a island's voxels into @a partition. Implemented in Terrain_cutting.cpp
+		*/
+		static void _snapshotIsland( Island *island, island_partition &partition );
+
+		/**
+			Find the connected groups of voxels in @a partition's snapshot. Thread-safe. Implemented in Terrain_cutting.cpp
+		*/
+		static void _labelSnapshot( island_partition *partition, real scale );
+
+		/**
+			Main thread half of an async partition: create the Islands found by _partitionSnapshot, and delete the partitioned island.
+			Implemented in Terrain_cutting.cpp
+		*/
+		void _adoptPartition( island_partition &partition, std::set< Island* > &newIslands );
+		
+		/**
+			Mark @a voxel as modified by a cut, in each Island which owns it
+		*/
+		void _markVoxelDirty( Voxel *voxel );
+
+		/**
+			Gather into _cutVoxels the voxels of @a island within @a radius of the ordinal space segment @a a -> @a b,
+			by rasterizing the swept capsule over the island's ordinal bounds. Implemented in Terrain_cutting.cpp
+		*/
+		const std::vector< Voxel* > &_gatherCutVoxels( Island *island, const Vec2r &a, const Vec2r &b, real radius );
+
+		/**
+			cutLine's path for more than one candidate island, when the WorkerPool has threads. Applies _chunkedCuttingLine
+			a chunk at a time; each of @a islands' voxels under the chunk are cut on the pool, except voxels linked to another 
+			island's, which are cut on this thread before the next chunk, in the order cutLine would have. 
+			Distances are in voxels, as cutLine computes them.
+			Implemented in Terrain_cutting.cpp
+		*/
+		unsigned int _cutLineInParallel( 
+			const std::vector< Island* > &islands,
+			real minDist,
+			real maxDist,
+			real oneOverMaxMinusMin,
+			real reach,
+			real strength,
+			Vec2iSet &touchedScaledWorldPositions );
+
+		/**
+			Get the cached disk_stencil for a disk of @a radius ordinal units centered at the ordinal position @a center, 
+			quantized to cutting::DiskStencilPhaseSteps of a voxel, building it if needed. @a origin receives the voxel 
+			the stencil's offsets are relative to. Used by cutDisk and cutBatch alike. Implemented in Terrain_cutting.cpp
+		*/
+		const disk_stencil &_diskStencil( real radius, const Vec2r &center, Vec2i &origin );
 		
 		/**
 			Gathers all islands into _allIslands vector
@@ -616,6 +1466,48 @@ class Terrain : public core::GameObject, public core::BatchDrawDelegate
 			to that group.	
 		*/
 		void _updateIslandGroups( std::set< Island* > newIslands );
+		
+		/**
+			Update the physics representations of the static group and all dynamic groups, preparing
+			the geometry of every group's islands together on the WorkerPool.
+		*/
+		void _updateGroupPhysics();
+		
+		/**
+			Give islands far from every player and monster coarse collision shapes, and islands near one, or near a static 
+			island a non-static body is touching, full detail shapes. See Terrain::init::collisionDetailDistance.
+		*/
+		void _updateCollisionDetail( const core::time_state &time );
+		
+		/**
+			Bake dynamic groups which have slept in contact with static terrain for init::debrisBakeTime into the static group.
+			Implemented in Terrain_baking.cpp
+		*/
+		void _bakeRestingDebris( const core::time_state &time );
+		
+		/**
+			Resample @a group's voxels into static space at its current pose, as a new Island added to the static group,
+			and delete @a group. Returns the new Island, or NULL, having changed nothing, if the resampled voxels are out of 
+			bounds, overlap another island's, or share none with the static group's islands. Implemented in Terrain_baking.cpp
+		*/
+		Island *_bakeGroup( DynamicIslandGroup *group );
+		
+		/**
+			Retire dynamic groups smaller than init::minDebrisArea, then the smallest and farthest from any player or monster
+			until the init::maxDebrisGroups and init::maxDebrisVoxels budgets are met, emitting debrisRetired for each.
+		*/
+		void _retireExcessDebris( const core::time_state &time );
+		
+		/**
+			Remove @a group from _dynamicGroups and delete it, along with its islands, releasing their voxels.
+			Returns the ordinal bounds of the released voxels, for the caller to compact once it's done with them.
+		*/
+		ci::Recti _destroyDynamicGroup( DynamicIslandGroup *group );
+		
+		/**
+			Populate @a bounds with the aabbs of the level's players and monsters
+		*/
+		void _gatherEntityBounds( std::vector< cpBB > &bounds ) const;
 
 		/**
 			Create a ci::Surface (which will be used as source for a ci::gl::Texture ) which will 
@@ -660,19 +1552,47 @@ class Terrain : public core::GameObject, public core::BatchDrawDelegate
 		StaticIslandGroup* _staticGroup;
 		std::set< DynamicIslandGroup* > _dynamicGroups;
 		std::vector< Island* > _allIslands;
+		boost::shared_ptr< core::WorkerPool > _workerPool;
 				
 		// rendering ivars
 		ci::gl::Texture _materialTex, _modulationTex, _greebleTexAtlas;
+		ci::Surface _modulationSurface;	// source of _modulationTex, kept for cook()
 		ci::gl::GlslProg _solidMaterialShader, _greebleShader;
 		
 		// deferred cutting state
 		seconds_t _deferredGeometryUpdateTime, _geometryUpdateDeferralTime;
 		std::set< Island* > _dirtyIslands;
+		boost::shared_ptr< async_partition > _asyncPartition;
 
 		Vec2rVec _chunkedCuttingLine, _touchedVoxelWorldPositions;	
+		std::vector< Voxel* > _cutVoxels;
+		std::map< int, disk_stencil > _diskStencils;
 		
 		std::map< TerrainCutType::cut_type, Vec2iSet > _touchedScaledWorldPositionsByCut;
 		
+		// cutting instrumentation and recording
+		terrain_phase_timings _phaseTimings;
+		std::vector< recorded_cut > *_cutRecording;
+		
+		// per-tile voxel planes ( empty for tiles unallocated at load ), encoded island memberships with their group
+		// indices, and group states as loaded, which snapshots are encoded against; and the loaded state, made on demand
+		terrain_snapshot _loadedState;
+		std::vector< std::vector< uint8_t > > _pristineTiles;
+		std::vector< std::vector< uint8_t > > _pristineIslands;
+		std::map< uint32_t, std::size_t > _pristineIslandsByChecksum;
+		std::vector< std::size_t > _pristineIslandGroups;
+		std::vector< terrain_snapshot::group_state > _pristineGroups;
+		
+		// collision level of detail; entity bounds are gathered into _collisionDetailFoci on each update
+		seconds_t _nextCollisionDetailUpdateTime;
+		std::vector< cpBB > _collisionDetailFoci;
+		
+		// debris baking and budgeting
+		seconds_t _nextDebrisBakeTime, _nextDebrisBudgetTime;
+		std::vector< cpBB > _debrisFoci;
+		std::vector< std::pair< real, DynamicIslandGroup* > > _debrisCandidates;
+		Vec2rVec _retiredDebrisPositions;
+		
 		bool _renderVoxelsInDebug;
 };
 
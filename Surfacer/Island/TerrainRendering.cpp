@@ -195,19 +195,20 @@ void IslandRenderer::_render_DebugVoxels( Island *island, const render_state &st
 		fixedVoxelColor( Color::white(), 0.75 );
 
 	// draw all voxels
+	const IslandGroup *group = island->group();
 	foreach( Voxel *v, island->voxels() )
 	{
 		gl::color( v->fixed() ? fixedVoxelColor : voxelColor );
 
-		if ( v->numIslands == 1 ) 
+		if ( v->islandCount == 1 ) 
 		{
-			gl::drawSolidCircle( v->centroidRelativePosition, v->volume() * 0.5f * scale, 8 );
+			gl::drawSolidCircle( group->centroidRelativePosition( v ), v->volume() * 0.5f * scale, 8 );
 		}
 		else			
 		{
-			int ii = v->islandIndex(island);				
+			int ii = island->voxelStore()->islandIndex( v, island->membershipId() );
 			Vec2r offset = offsets[ ii % 4 ];
-			gl::drawStrokedCircle( v->centroidRelativePosition + offset, v->volume() * 0.125f * scale, 8 );
+			gl::drawStrokedCircle( group->centroidRelativePosition( v ) + offset, v->volume() * 0.125f * scale, 8 );
 		}
 	}
 }
@@ -235,10 +236,21 @@ void IslandRenderer::_render_Greebling_Game( Island *island, const render_state
 		maskTexCoordOffset = 2 * sizeof(ci::Vec2f),
 		colorOffset = 3 * sizeof(ci::Vec2f);
 		
-	if ( !_greeblingVbo )
+	//
+	//	Islands are greebled on first draw, and regreebled when the zoom changes density level
+	//
+
+	if ( island->updatePerimeterGreebling( state.viewport.zoom() ))
 	{
-		const std::vector< perimeter_greeble_vertex > &vertices = island->perimeterGreebleVertices();
+		FreeVbo( _greeblingVbo );
+		_greeblingVboVertexCount = 0;
+	}
+
+	const std::vector< perimeter_greeble_vertex > &vertices = island->perimeterGreebleVertices();
+	if ( vertices.empty() ) return;
 
+	if ( !_greeblingVbo )
+	{
 		glGenBuffers( 1, &_greeblingVbo );
 		glBindBuffer( GL_ARRAY_BUFFER, _greeblingVbo );
 		glBufferData( GL_ARRAY_BUFFER, 
@@ -288,6 +300,12 @@ void IslandRenderer::_render_Greebling_Development( Island *island, const render
 
 	color.a = alpha;
 	
+	if ( island->updatePerimeterGreebling( state.viewport.zoom() ))
+	{
+		FreeVbo( _greeblingVbo );
+		_greeblingVboVertexCount = 0;
+	}
+
 	const std::vector< perimeter_greeble_vertex > &vertices(island->perimeterGreebleVertices());
 	for ( int i = 0, N = vertices.size(); i < N; i+=4 )
 	{
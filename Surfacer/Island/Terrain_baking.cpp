@@ -0,0 +1,367 @@
+//
+//  Terrain_baking.cpp
+//  Surfacer
+//
+//  Created by Shamyl Zakariya on 10/17/12.
+//  Copyright 2012 TomorrowPlusX. All rights reserved.
+//
+
+#include "Terrain.h"
+
+#include "Level.h"
+
+using namespace ci;
+using namespace core;
+namespace game { namespace terrain {
+
+#pragma mark -
+#pragma mark Debris Baking
+
+namespace {
+
+	// how often sleeping dynamic groups are checked for baking
+	const seconds_t DebrisBakeInterval = 1;
+
+	struct static_contact_finder
+	{
+		cpBody *staticBody;
+		bool found;
+
+		static_contact_finder( cpBody *sb ):
+			staticBody( sb ),
+			found( false )
+		{}
+	};
+
+	void find_static_contact( cpBody *body, cpArbiter *arbiter, void *data )
+	{
+		static_contact_finder *finder = static_cast< static_contact_finder* >( data );
+		cpBody *a = NULL, *b = NULL;
+		cpArbiterGetBodies( arbiter, &a, &b );
+
+		if ( a == finder->staticBody || b == finder->staticBody ) finder->found = true;
+	}
+
+	/**
+		A voxel of a dynamic group resampled into static space
+	*/
+	struct baked_voxel
+	{
+		int occupation, strength, id;
+
+		// true if the voxel is to be part of the baked island
+		bool included;
+
+		// true if the voxel is the fringe of another island, which the baked island will share; its links belong to that island
+		bool shared;
+
+		baked_voxel():
+			occupation(0),
+			strength(0),
+			id(0),
+			included(false),
+			shared(false)
+		{}
+	};
+
+	inline bool OwnedOutsideGroup( const OrdinalVoxelStore &store, const Voxel *v, const IslandGroup *group )
+	{
+		for ( std::size_t i = 0; i < v->islandCount; i++ )
+		{
+			if ( !group->hasIsland( store.islandOf( v, i ))) return true;
+		}
+
+		return false;
+	}
+
+	inline bool OwnedByGroup( const OrdinalVoxelStore &store, const Voxel *v, const IslandGroup *group )
+	{
+		for ( std::size_t i = 0; i < v->islandCount; i++ )
+		{
+			if ( group->hasIsland( store.islandOf( v, i ))) return true;
+		}
+
+		return false;
+	}
+
+	inline Voxel *GroupVoxelAt( const OrdinalVoxelStore &store, const IslandGroup *group, int x, int y )
+	{
+		Voxel *v = store.voxelAt( x, y );
+		return ( v && v->islandCount > 0 && group->hasIsland( store.island( v->islandId ))) ? v : NULL;
+	}
+
+}
+
+void Terrain::_bakeRestingDebris( const time_state &time )
+{
+	const seconds_t BakeTime = _initializer.debrisBakeTime;
+	if ( BakeTime <= 0 || time.time < _nextDebrisBakeTime ) return;
+	_nextDebrisBakeTime = time.time + DebrisBakeInterval;
+
+	//
+	//	Islands awaiting a partition may belong to a resting group; wait until they've been published
+	//
+
+	if ( _asyncPartition || !_dirtyIslands.empty() ) return;
+
+	std::vector< DynamicIslandGroup* > resting;
+	foreach( DynamicIslandGroup *dg, _dynamicGroups )
+	{
+		if ( dg->body() && dg->sleeping() && time.time - dg->lastAwakeTime() >= BakeTime )
+		{
+			static_contact_finder finder( _staticGroup->body() );
+			cpBodyEachArbiter( dg->body(), find_static_contact, &finder );
+
+			if ( finder.found ) resting.push_back( dg );
+		}
+	}
+
+	if ( resting.empty() ) return;
+
+	std::size_t baked = 0;
+	foreach( DynamicIslandGroup *dg, resting )
+	{
+		if ( _bakeGroup( dg )) baked++;
+	}
+
+	if ( baked > 0 )
+	{
+		//
+		//	Triangulate the baked islands and give them collision shapes
+		//
+
+		_updateGroupPhysics();
+		_staticGroup->prune();
+		_gatherAllIslands();
+	}
+}
+
+Island *Terrain::_bakeGroup( DynamicIslandGroup *group )
+{
+	const real
+		Scale = _voxels.scale(),
+		OneOverScale = 1 / Scale;
+
+	const Vec2r Offset = group->ordinalToCentroidRelativeOffset();
+	const Mat4r &modelview = group->modelview(), &modelviewInverse = group->modelviewInverse();
+
+	//
+	//	Find the static space ordinal extent of the group's voxels at its resting pose, with a margin for the fringe
+	//
+
+	cpBB worldBounds = cpBBInvalid;
+	foreach( Island *island, group->islands() )
+	{
+		foreach( Voxel *v, island->voxels() )
+		{
+			if ( v->occupation > 0 )
+			{
+				cpBBExpand( worldBounds, modelview * ( Vec2r( v->ordinalPosition ) * Scale + Offset ));
+			}
+		}
+	}
+
+	if ( worldBounds.l > worldBounds.r ) return NULL;
+
+	const int
+		x1 = int( std::floor( worldBounds.l * OneOverScale )) - 1,
+		y1 = int( std::floor( worldBounds.b * OneOverScale )) - 1,
+		x2 = int( std::ceil( worldBounds.r * OneOverScale )) + 1,
+		y2 = int( std::ceil( worldBounds.t * OneOverScale )) + 1,
+		width = x2 - x1 + 1,
+		height = y2 - y1 + 1;
+
+	//
+	//	Resample the group's voxels at the center of each static voxel, bilinearly filtering occupation, and taking
+	//	strength and id from the nearest occupied voxel
+	//
+
+	std::vector< baked_voxel > resampled( width * height );
+	bool occupied = false;
+
+	for ( int y = y1; y <= y2; y++ )
+	{
+		for ( int x = x1; x <= x2; x++ )
+		{
+			const Vec2r source = (( modelviewInverse * ( Vec2r( x, y ) * Scale )) - Offset ) * OneOverScale;
+			const int sx = int( std::floor( source.x )), sy = int( std::floor( source.y ));
+			const real fx = source.x - sx, fy = source.y - sy;
+
+			Voxel *corners[4] = {
+				GroupVoxelAt( _voxels, group, sx, sy ),
+				GroupVoxelAt( _voxels, group, sx + 1, sy ),
+				GroupVoxelAt( _voxels, group, sx, sy + 1 ),
+				GroupVoxelAt( _voxels, group, sx + 1, sy + 1 )
+			};
+
+			const real weights[4] = {
+				( 1 - fx ) * ( 1 - fy ),
+				fx * ( 1 - fy ),
+				( 1 - fx ) * fy,
+				fx * fy
+			};
+
+			baked_voxel &bv = resampled[ ( y - y1 ) * width + ( x - x1 ) ];
+			real occupation = 0, nearestWeight = 0;
+
+			for ( int i = 0; i < 4; i++ )
+			{
+				if ( corners[i] )
+				{
+					occupation += weights[i] * corners[i]->occupation;
+
+					if ( corners[i]->occupation > 0 && weights[i] > nearestWeight )
+					{
+						nearestWeight = weights[i];
+						bv.strength = corners[i]->strength;
+						bv.id = corners[i]->id;
+					}
+				}
+			}
+
+			bv.occupation = std::min( int( occupation + real(0.5) ), 255 );
+			if ( bv.occupation >= MinimumVoxelOccupation ) occupied = true;
+		}
+	}
+
+	if ( !occupied ) return NULL;
+
+	//
+	//	The baked island is made of the occupied voxels and their fringe, as a partition would gather. Voxels owned
+	//	by another island can't be taken over: if one of them is occupied where the group is too, the group is
+	//	interpenetrating; if it's only fringe, the baked island shares it, which makes the two adjacent.
+	//	That adjacency is what lets a later cut sever the baked island from the terrain it rests on, and make it dynamic again.
+	//	Where the group is occupied over the other island's fringe, the shared voxel takes the group's occupation.
+	//	The group is only baked if it shares a voxel with the static group, since an island with no fixed voxels
+	//	and no adjacency to static terrain would be unreachable by _updateIslandGroups, and never fall again.
+	//
+
+	bool sharesStaticVoxels = false;
+
+	for ( int y = y1; y <= y2; y++ )
+	{
+		for ( int x = x1; x <= x2; x++ )
+		{
+			baked_voxel &bv = resampled[ ( y - y1 ) * width + ( x - x1 ) ];
+
+			bool gather = bv.occupation >= MinimumVoxelOccupation;
+			for ( int d = 0; d < 8 && !gather; d++ )
+			{
+				const Vec2i n = Vec2i( x, y ) + Compass::dir(d);
+				if ( n.x >= x1 && n.x <= x2 && n.y >= y1 && n.y <= y2 )
+				{
+					gather = resampled[ ( n.y - y1 ) * width + ( n.x - x1 ) ].occupation >= MinimumVoxelOccupation;
+				}
+			}
+
+			if ( !gather ) continue;
+			if ( !_voxels.contains( x, y )) return NULL;
+
+			Voxel *v = _voxels.voxelAt( x, y );
+			if ( v && OwnedOutsideGroup( _voxels, v, group ))
+			{
+				if ( v->occupation >= MinimumVoxelOccupation )
+				{
+					if ( bv.occupation >= MinimumVoxelOccupation ) return NULL;
+					continue;
+				}
+
+				bv.shared = true;
+				if ( OwnedByGroup( _voxels, v, _staticGroup )) sharesStaticVoxels = true;
+			}
+
+			bv.included = true;
+		}
+	}
+
+	if ( !sharesStaticVoxels ) return NULL;
+
+	//
+	//	We're committed. Dispose of the group, its body and its islands, releasing their voxels.
+	//
+
+	const Recti sourceBounds = _destroyDynamicGroup( group );
+
+	//
+	//	Write the resampled voxels into static space. Newly allocated tiles are left unlinked, so voxels the baked
+	//	island doesn't include aren't left linked but unowned. Voxels the baked island takes sole ownership of are
+	//	disconnected from any stale neighbors first. Shared fringe voxels keep their links; if the group is occupied
+	//	there they take its occupation, and their owners are marked dirty so their perimeters are re-marched.
+	//
+
+	std::vector< Voxel* > bakedVoxels;
+	bool sharedVoxelsFilled = false;
+
+	for ( int y = y1; y <= y2; y++ )
+	{
+		for ( int x = x1; x <= x2; x++ )
+		{
+			const baked_voxel &bv = resampled[ ( y - y1 ) * width + ( x - x1 ) ];
+			if ( !bv.included ) continue;
+
+			Voxel *v = _voxels.allocate( x, y, false );
+			if ( !bv.shared )
+			{
+				v->disconnect();
+				v->occupation = bv.occupation;
+				v->strength = bv.strength;
+				v->id = bv.id;
+			}
+			else if ( bv.occupation >= MinimumVoxelOccupation )
+			{
+				v->occupation = bv.occupation;
+				v->strength = bv.strength;
+				v->id = bv.id;
+
+				_markVoxelDirty( v );
+				for ( std::size_t i = 0; i < v->islandCount; i++ )
+				{
+					_dirtyIslands.insert( _voxels.islandOf( v, i ));
+				}
+
+				sharedVoxelsFilled = true;
+			}
+
+			bakedVoxels.push_back( v );
+		}
+	}
+
+	if ( sharedVoxelsFilled )
+	{
+		_markDeferredGeometryUpdateNeeded();
+	}
+
+	//
+	//	Link the baked voxels to one another; links between two shared voxels belong to their owners
+	//
+
+	foreach( Voxel *v, bakedVoxels )
+	{
+		const baked_voxel &bv = resampled[ ( v->ordinalPosition.y - y1 ) * width + ( v->ordinalPosition.x - x1 ) ];
+		if ( bv.shared ) continue;
+
+		for ( int d = 0; d < 8; d++ )
+		{
+			const Vec2i n = v->ordinalPosition + Compass::dir(d);
+			if ( n.x >= x1 && n.x <= x2 && n.y >= y1 && n.y <= y2 && resampled[ ( n.y - y1 ) * width + ( n.x - x1 ) ].included )
+			{
+				Voxel *neighbor = _voxels.voxelAt( n );
+				v->neighbors[d] = neighbor;
+				neighbor->neighbors[(d + 4) % 8] = v;
+			}
+		}
+	}
+
+	Island *island = new Island( &_voxels, bakedVoxels );
+	_staticGroup->addIsland( island );
+
+	//
+	//	Free any tiles the group occupied which are now unowned
+	//
+
+	_voxels.compact( sourceBounds );
+
+	return island;
+}
+
+}} // end namespace game::terrain
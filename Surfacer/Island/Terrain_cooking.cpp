@@ -0,0 +1,435 @@
+//
+//  Terrain_cooking.cpp
+//  Surfacer
+//
+//  Created by Shamyl Zakariya on 10/17/12.
+//  Copyright 2012 TomorrowPlusX. All rights reserved.
+//
+
+#include "Terrain.h"
+#include "CookedTerrain.h"
+
+#include <cinder/app/App.h>
+#include <cinder/gl/gl.h>
+
+#include "Level.h"
+
+using namespace ci;
+using namespace core;
+namespace game { namespace terrain {
+
+/*
+	Cooked payload layout, in order:
+
+		int32 width, height; Vec2i tileSize, tileOrigin
+		modulation surface: int32 width, height; RGB bytes
+		uint32 indices of allocated tiles
+		per voxel of each allocated tile, in tile then row-major order, one array per field:
+			uint8 occupation, uint8 strength, uint8 id, uint8 connectivity mask, int32 rand
+		uint32 island count, then per island:
+			uint32 voxel indices ( y * width + x )
+			perimeter cache ( see Island::_writePerimeterCache )
+			triangulation at zero offset
+			greeble vertices at zero offset
+*/
+
+namespace {
+
+	struct cooked_island
+	{
+		std::vector< uint32_t > voxels;
+		boost::shared_ptr< island_perimeter_cache > perimeterCache;
+		std::vector< triangle > triangulation;
+		std::vector< perimeter_greeble_vertex > greebleVertices;
+	};
+
+	inline uint8_t ClampToByte( int v )
+	{
+		return uint8_t( std::max( 0, std::min( v, 255 )));
+	}
+
+	template< class T >
+	uint32_t ChecksumValue( const T &value, uint32_t crc )
+	{
+		return cooked::Checksum( &value, sizeof( T ), crc );
+	}
+
+}
+
+#pragma mark -
+#pragma mark Terrain Cooking
+
+uint32_t Terrain::_cookingParametersChecksum() const
+{
+	const int32_t
+		realSize = sizeof( real ),
+		greebling = _initializer.greebleTextureAtlas.empty() ? 0 : 1,
+		greebleTextureIsMask = _initializer.greebleTextureIsMask ? 1 : 0;
+
+	uint32_t crc = ChecksumValue( realSize, 0 );
+	crc = ChecksumValue( _initializer.scale, crc );
+	crc = ChecksumValue( _initializer.sectorSize, crc );
+	crc = ChecksumValue( _initializer.origin, crc );
+	crc = ChecksumValue( _initializer.extent, crc );
+	crc = ChecksumValue( _initializer.greebleSize, crc );
+	crc = ChecksumValue( greebling, crc );
+	crc = ChecksumValue( greebleTextureIsMask, crc );
+
+	//
+	//	Cooked greeble vertices depend on the atlas' contents, not just its name
+	//
+
+	if ( greebling )
+	{
+		ci::fs::path atlasPath;
+		uint32_t atlasChecksum = 0;
+		if ( level() && level()->resourceManager()->findPath( _initializer.greebleTextureAtlas, atlasPath ))
+		{
+			cooked::FileChecksum( atlasPath, atlasChecksum );
+		}
+
+		crc = ChecksumValue( atlasChecksum, crc );
+	}
+
+	return crc;
+}
+
+bool Terrain::cook()
+{
+	ResourceManager *rm = level()->resourceManager();
+
+	ci::fs::path levelImagePath, cookedTerrainPath;
+	if ( _initializer.cookedTerrain.empty() || !rm->findPath( _initializer.levelImage, levelImagePath ))
+	{
+		app::console() << "Terrain::cook - no cookedTerrain, or unable to find levelImage \"" << _initializer.levelImage << "\"" << std::endl;
+		return false;
+	}
+
+	if ( !rm->findPath( _initializer.cookedTerrain, cookedTerrainPath ))
+	{
+		cookedTerrainPath = levelImagePath.parent_path() / _initializer.cookedTerrain;
+	}
+
+	return cook( cookedTerrainPath );
+}
+
+bool Terrain::cook( const ci::fs::path &path )
+{
+	ResourceManager *rm = level()->resourceManager();
+
+	ci::fs::path levelImagePath;
+	uint32_t sourceChecksum = 0;
+	if ( !rm->findPath( _initializer.levelImage, levelImagePath ) || !cooked::FileChecksum( levelImagePath, sourceChecksum ))
+	{
+		app::console() << "Terrain::cook - unable to read levelImage \"" << _initializer.levelImage << "\"" << std::endl;
+		return false;
+	}
+
+	//
+	//	Complete any pending geometry updates, so every island's geometry reflects its voxels
+	//
+
+	completeGeometryUpdates();
+
+	_gatherAllIslands();
+
+	cooked::Writer writer;
+	const int width = _voxels.width(), height = _voxels.height();
+	writer.write( int32_t( width ));
+	writer.write( int32_t( height ));
+	writer.write( _voxels.tileSize() );
+	writer.write( _voxels.tileOrigin() );
+
+	//
+	//	Modulation surface
+	//
+
+	{
+		const int32_t sw = _modulationSurface ? _modulationSurface.getWidth() : 0,
+		              sh = _modulationSurface ? _modulationSurface.getHeight() : 0;
+
+		std::vector< uint8_t > rgb;
+		rgb.reserve( sw * sh * 3 );
+
+		if ( _modulationSurface )
+		{
+			Surface::Iter iter = _modulationSurface.getIter();
+			while( iter.line() )
+			{
+				while( iter.pixel() )
+				{
+					rgb.push_back( iter.r() );
+					rgb.push_back( iter.g() );
+					rgb.push_back( iter.b() );
+				}
+			}
+		}
+
+		writer.write( sw );
+		writer.write( sh );
+		writer.writeArray( rgb.empty() ? NULL : &rgb[0], rgb.size() );
+	}
+
+	//
+	//	Voxel planes, for allocated tiles only
+	//
+
+	const Vec2i tileSize = _voxels.tileSize();
+	const std::size_t tileArea = tileSize.x * tileSize.y;
+
+	std::vector< uint32_t > tiles;
+	for ( std::size_t t = 0, N = _voxels.tileCount(); t < N; t++ )
+	{
+		if ( _voxels.tile(t) ) tiles.push_back( t );
+	}
+
+	writer.write( tiles );
+
+	const std::size_t voxelCount = tiles.size() * tileArea;
+	std::vector< uint8_t > occupation( voxelCount ), strength( voxelCount ), id( voxelCount ), connectivity( voxelCount );
+	std::vector< int32_t > rand( voxelCount );
+
+	std::size_t i = 0;
+	foreach( uint32_t t, tiles )
+	{
+		for ( const Voxel *v = _voxels.tile(t), *end = v + tileArea; v != end; ++v, ++i )
+		{
+			uint8_t mask = 0;
+			for ( int dir = 0; dir < 8; dir++ )
+			{
+				if ( v->neighbors[dir] ) mask |= 1 << dir;
+			}
+
+			occupation[i] = ClampToByte( v->occupation );
+			strength[i] = ClampToByte( v->strength );
+			id[i] = ClampToByte( v->id );
+			connectivity[i] = mask;
+			rand[i] = v->rand;
+		}
+	}
+
+	writer.writeArray( occupation.empty() ? NULL : &occupation[0], voxelCount );
+	writer.writeArray( strength.empty() ? NULL : &strength[0], voxelCount );
+	writer.writeArray( id.empty() ? NULL : &id[0], voxelCount );
+	writer.writeArray( connectivity.empty() ? NULL : &connectivity[0], voxelCount );
+	writer.writeArray( rand.empty() ? NULL : &rand[0], voxelCount );
+
+	//
+	//	Islands. Geometry is written at zero offset; static islands are already there, dynamic
+	//	islands' geometry is relative to their group's centroid.
+	//
+
+	writer.write( uint32_t( _allIslands.size() ));
+
+	std::vector< uint32_t > voxelIndices;
+	std::vector< triangle > triangulation;
+	std::vector< perimeter_greeble_vertex > greebleVertices;
+
+	foreach( Island *island, _allIslands )
+	{
+		voxelIndices.clear();
+		foreach( Voxel *v, island->voxels() )
+		{
+			voxelIndices.push_back( v->ordinalPosition.y * width + v->ordinalPosition.x );
+		}
+
+		writer.write( voxelIndices );
+		Island::_writePerimeterCache( writer, island->_perimeterCache );
+
+		const Vec2r offset = island->group()->ordinalToCentroidRelativeOffset();
+		const Vec2f translation( -offset.x, -offset.y );
+
+		triangulation = island->_triangulation;
+		foreach( triangle &tri, triangulation )
+		{
+			tri.a.position += translation;
+			tri.b.position += translation;
+			tri.c.position += translation;
+		}
+
+		//
+		//	Greebling is made lazily, so islands which haven't been drawn may have none; cook the densest level
+		//
+
+		greebleVertices.clear();
+		if ( !_initializer.greebleTextureAtlas.empty() )
+		{
+			if ( island->_greeblingLevel != 0 ) island->_createPerimeterGreebling( 0 );
+			greebleVertices = island->_untranslatedGreebleVertices;
+		}
+
+		writer.write( triangulation );
+		writer.write( greebleVertices );
+	}
+
+	if ( !writer.save( path, sourceChecksum, _cookingParametersChecksum() ))
+	{
+		app::console() << "Terrain::cook - unable to write \"" << path << "\"" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool Terrain::_loadCooked( const ci::fs::path &path, uint32_t sourceChecksum )
+{
+	cooked::Reader reader;
+	if ( !reader.open( path, sourceChecksum, _cookingParametersChecksum() ))
+	{
+		return false;
+	}
+
+	//
+	//	Read and validate everything before touching the voxel store, so a bad file leaves us
+	//	free to load from the level image. Voxel planes are used in place from the mapping.
+	//
+
+	int32_t width = 0, height = 0, surfaceWidth = 0, surfaceHeight = 0;
+	Vec2i tileSize, tileOrigin;
+	std::vector< uint32_t > tiles;
+
+	reader.read( width );
+	reader.read( height );
+	reader.read( tileSize );
+	reader.read( tileOrigin );
+	reader.read( surfaceWidth );
+	reader.read( surfaceHeight );
+
+	if ( !reader.ok() || width <= 0 || height <= 0 || tileSize.x <= 0 || tileSize.y <= 0 || surfaceWidth < 0 || surfaceHeight < 0 )
+	{
+		return false;
+	}
+
+	const uint8_t *rgb = reader.readArray< uint8_t >( std::size_t( surfaceWidth ) * surfaceHeight * 3 );
+	reader.read( tiles );
+
+	const std::size_t tileArea = tileSize.x * tileSize.y, voxelCount = tiles.size() * tileArea;
+
+	const uint8_t
+		*occupation = reader.readArray< uint8_t >( voxelCount ),
+		*strength = reader.readArray< uint8_t >( voxelCount ),
+		*id = reader.readArray< uint8_t >( voxelCount ),
+		*connectivity = reader.readArray< uint8_t >( voxelCount );
+
+	const int32_t *rand = reader.readArray< int32_t >( voxelCount );
+
+	uint32_t islandCount = 0;
+	reader.read( islandCount );
+	if ( !reader.ok() ) return false;
+
+	//	an empty store, to address tiles as the populated one will
+	OrdinalVoxelStore layout;
+	layout.set( width, height, _initializer.scale, tileSize, tileOrigin );
+
+	std::vector< uint8_t > tileListed( layout.tileCount(), 0 );
+	foreach( uint32_t t, tiles )
+	{
+		if ( t >= tileListed.size() ) return false;
+		tileListed[t] = 1;
+	}
+
+	std::vector< cooked_island > islands( islandCount );
+	foreach( cooked_island &cookedIsland, islands )
+	{
+		if ( !reader.read( cookedIsland.voxels ) ||
+		     !Island::_readPerimeterCache( reader, cookedIsland.perimeterCache ) ||
+		     !reader.read( cookedIsland.triangulation ) ||
+		     !reader.read( cookedIsland.greebleVertices ))
+		{
+			return false;
+		}
+
+		foreach( uint32_t index, cookedIsland.voxels )
+		{
+			const int x = index % width, y = index / width;
+			if ( y >= height || !tileListed[ layout.tileIndex( x, y ) ] ) return false;
+		}
+	}
+
+	//
+	//	Populate the voxel store. All listed tiles are allocated before links are restored, since
+	//	each voxel's mask records its links to voxels in other tiles too.
+	//
+
+	_voxels.set( width, height, _initializer.scale, tileSize, tileOrigin );
+	foreach( uint32_t t, tiles )
+	{
+		_voxels.allocateTile( t );
+	}
+
+	std::size_t i = 0;
+	foreach( uint32_t t, tiles )
+	{
+		for ( Voxel *v = _voxels.tile(t), *end = v + tileArea; v != end; ++v, ++i )
+		{
+			v->occupation = occupation[i];
+			v->strength = strength[i];
+			v->id = id[i];
+			v->rand = rand[i];
+
+			for ( int dir = 0; dir < 8; dir++ )
+			{
+				v->neighbors[dir] = ( connectivity[i] & ( 1 << dir )) ? _voxels.voxelAt( v->ordinalPosition + Compass::dir( dir )) : NULL;
+			}
+		}
+	}
+
+	//
+	//	Create islands, handing them their cooked geometry. Group physics will translate it into place.
+	//
+
+	std::set< Island* > newIslands;
+	std::vector< Voxel* > voxels;
+
+	foreach( cooked_island &cookedIsland, islands )
+	{
+		voxels.clear();
+		voxels.reserve( cookedIsland.voxels.size() );
+
+		foreach( uint32_t index, cookedIsland.voxels )
+		{
+			voxels.push_back( _voxels.voxelAtUnsafe( index % width, index / width ));
+		}
+
+		Island *island = new Island( &_voxels, voxels );
+		island->setBatchDrawDelegate( this );
+		island->_adoptGeometry( cookedIsland.perimeterCache, cookedIsland.triangulation );
+		island->_adoptGreebling( cookedIsland.greebleVertices );
+
+		newIslands.insert( island );
+	}
+
+	//
+	//	Mark our bounds, and create the modulation texture from the cooked surface
+	//
+
+	const real AABBInset = 1/_initializer.scale;
+	setAabb( cpBBNew(0, 0, width*_initializer.scale - AABBInset, (height-1)*_initializer.scale - AABBInset));
+
+	if ( surfaceWidth > 0 && surfaceHeight > 0 )
+	{
+		_modulationSurface = ci::Surface( surfaceWidth, surfaceHeight, false, SurfaceChannelOrder::RGB );
+
+		Surface::Iter iter = _modulationSurface.getIter();
+		while( iter.line() )
+		{
+			while( iter.pixel() )
+			{
+				iter.r() = *rgb++;
+				iter.g() = *rgb++;
+				iter.b() = *rgb++;
+			}
+		}
+
+		gl::Texture::Format mipmappingFormat;
+		mipmappingFormat.enableMipmapping(true);
+		mipmappingFormat.setMinFilter( GL_LINEAR_MIPMAP_LINEAR );
+		mipmappingFormat.setMagFilter( GL_LINEAR );
+		_modulationTex = gl::Texture( _modulationSurface, mipmappingFormat );
+	}
+
+	_createIslandGroups( newIslands );
+	return true;
+}
+
+}} // end namespace game::terrain
@@ -8,95 +8,144 @@
 
 #include "Terrain.h"
 #include <cinder/app/App.h>
+#include <climits>
+#include <future>
 
+#include "ComponentLabeling.h"
 #include "FloodFill.h"
 #include "Level.h"
 #include "LineChunking.h"
 #include "Stopwatch.h"
+#include "VoxelCutting.h"
+
+// when 1, cutLine and cutDisk visit only the voxels under the rasterized cut shape;
+// when 0, they test every voxel of each candidate island
+#define RASTERIZE_CUTS 1
+
+// when 1, cutDisk stamps a cached stencil of the disk's overlap with the voxels under it, and cutTerrain finds the
+// cutting island's voxels near each target voxel by position; when 0, they compute overlaps voxel by voxel
+#define STENCIL_CUTS 1
+
+// when 1, islands are partitioned by labeling a snapshot of their voxels with labeling::label, several at once on 
+// the worker pool; when 0, by flood filling from each unclaimed voxel in turn
+#define LABEL_COMPONENTS 1
+
+// when 1 and the worker pool has threads, cutLine cuts each chunk of the line across candidate islands on the pool, 
+// leaving voxels linked to another island's for a serial pass after each chunk, and cutTerrain finds each candidate
+// island's contacts on the pool
+#define PARALLEL_CUTS 1
 
 
 using namespace ci;
 using namespace core;
 namespace game { namespace terrain {
 
+#pragma mark -
+#pragma Terrain Cutting
+
 namespace {
-    
-	const real 
-        VoxelRadiusLocal = 0.707106781;
-    
 
-	// apply a line to a voxel to remove its occupation component, disconnecting if emptied
-	unsigned int LineVoxelCut( 
-		Voxel *voxel, 
-		const util::line_segment &line, 
-		real minDist, 
-		real maxDist, 
-		real oneOverMaxMinusMin,		
-		real cutStrength )
+	// collects the voxels belonging to an island from the cells a cut rasterizes over
+	struct island_voxel_gatherer
 	{
-		real dist = line.distance( voxel->centroidRelativePosition );
-		unsigned int effectMask = 0;
-
-		//
-		//	subtract occupation from the vertex based on its overlap with the line segment
-		//
+		const OrdinalVoxelStore &store;
+		Island *island;
+		std::vector< Voxel* > &voxels;
+
+		island_voxel_gatherer( const OrdinalVoxelStore &s, Island *i, std::vector< Voxel* > &v ):
+			store(s),
+			island(i),
+			voxels(v)
+		{}
 
-		if ( dist <= maxDist )
+		inline void operator()( int x, int y )
 		{
-			//
-			//	If this voxel is fixed, early exit
-			//
-
-			if ( voxel->fixed() )
+			Voxel *voxel = store.voxelAt( x, y );
+			if ( voxel && island->owns( voxel ))
 			{
-				return Terrain::CUT_HIT_FIXED_VOXELS;
+				voxels.push_back( voxel );
 			}
-		
-			// this is the maximum possible occupation of the voxel given overlap and a hypothetical infinitely strong cut
-			int maxPossibleOccupation = std::min( lrintf( (dist - minDist) * oneOverMaxMinusMin * 255.0 ), 255L ),			
-			    ablation = 255 * (((255 - voxel->strength)/real(255)) * cutStrength); // 0->255 
+		}
+	};
 
-			ablation = std::max( std::min( ablation, voxel->occupation - maxPossibleOccupation ), 0 );
-			
-			if ( ablation > 0 )
-			{
-				voxel->occupation -= ablation;
-				effectMask |= Terrain::CUT_AFFECTED_VOXELS;
-			}				
-						
-			//
-			//	If we actually changed the voxel occupation
-			//
+	// append the voxels of @a island under the ordinal space capsule @a a -> @a b of @a radius to @a voxels
+	void GatherCutVoxels( const OrdinalVoxelStore &store, Island *island, const Vec2r &a, const Vec2r &b, real radius, std::vector< Voxel* > &voxels )
+	{
+		#if RASTERIZE_CUTS
 
-			if ( effectMask && voxel->occupation < MinimumVoxelOccupation ) 
-			{
-				voxel->disconnect();
-				effectMask |= Terrain::CUT_AFFECTED_ISLAND_CONNECTIVITY;
-			}
-		}
+			island_voxel_gatherer gatherer( store, island, voxels );
+			cutting::RasterizeCapsule( a, b, radius, island->voxelBoundsOrdinal(), gatherer );
+
+		#else
+
+			voxels.insert( voxels.end(), island->voxels().begin(), island->voxels().end() );
+
+		#endif
+	}
+
+}
+
+const std::vector< Voxel* > &Terrain::_gatherCutVoxels( Island *island, const Vec2r &a, const Vec2r &b, real radius )
+{
+	#if RASTERIZE_CUTS
 
 		//
-		//	Cut neighbor connections which intersect the cutting line
+		//	The capsule is in ordinal space already, so it rasterizes directly onto the island's ordinal grid
 		//
 
-		for ( int dir = 0; dir < 8; ++dir )
-		{
-			Voxel *neighbor = voxel->neighbors[dir];
-			if ( neighbor && line.intersects(voxel->centroidRelativePosition, neighbor->centroidRelativePosition ))
-			{
-				voxel->disconnect(dir);
-				effectMask |= Terrain::CUT_AFFECTED_ISLAND_CONNECTIVITY;
-			}
-		}		
-				
-		return effectMask;
-	}
-		
+		_cutVoxels.clear();
+		GatherCutVoxels( _voxels, island, a, b, radius, _cutVoxels );
+
+		return _cutVoxels;
+
+	#else
+
+		return island->_voxels;
+
+	#endif
 }
 
+const disk_stencil &Terrain::_diskStencil( real radius, const Vec2r &center, Vec2i &origin )
+{
+	//
+	//	Find the disk's center on the ordinal grid, quantized to a fraction of a voxel; the stencil is
+	//	keyed by radius and by that sub-voxel center
+	//
+
+	const real 
+		PhaseSteps = cutting::DiskStencilPhaseSteps;
 
-#pragma mark -
-#pragma Terrain Cutting
+	const Vec2r 
+		quantizedCenter( std::floor( center.x * PhaseSteps + real(0.5) ) / PhaseSteps, std::floor( center.y * PhaseSteps + real(0.5) ) / PhaseSteps );
+
+	origin = Vec2i( int( std::floor( quantizedCenter.x )), int( std::floor( quantizedCenter.y )));
+	const Vec2i phase( int(( quantizedCenter.x - origin.x ) * PhaseSteps ), int(( quantizedCenter.y - origin.y ) * PhaseSteps ));
+
+	//
+	//	A handful of radii account for nearly all disk cuts, so the cache stays small. Should something cut 
+	//	with many radii, start over rather than grow without bound.
+	//
+
+	const std::size_t MaxDiskStencils = 256;
+
+	const int 
+		radiusStep = int( std::floor( radius * cutting::DiskStencilRadiusSteps + real(0.5) )),
+		key = ( radiusStep * cutting::DiskStencilPhaseSteps + phase.x ) * cutting::DiskStencilPhaseSteps + phase.y;
+
+	std::map< int, disk_stencil >::iterator pos = _diskStencils.find( key );
+	if ( pos != _diskStencils.end() ) return pos->second;
+
+	if ( _diskStencils.size() >= MaxDiskStencils ) _diskStencils.clear();
+
+	disk_stencil &stencil = _diskStencils[key];
+	cutting::BuildDiskStencil( 
+		real( radiusStep ) / cutting::DiskStencilRadiusSteps, 
+		Vec2r( phase.x, phase.y ) / real( cutting::DiskStencilPhaseSteps ),
+		Epsilon / _voxels.scale(),
+		stencil );
+
+	return stencil;
+}
 
 unsigned int Terrain::cutLine( 
 	const Vec2r &start, 
@@ -117,17 +166,34 @@ unsigned int Terrain::cutLine(
 
 	strength = std::min( strength, real(1));
 
+	if ( _cutRecording ) 
+	{
+		_recordCut( recorded_cut::LINE, start, end, thickness, strength, cutType, restrictToIsland, NULL );
+	}
+
+	Stopwatch timer;
+
 	//
 	//	We're treating the voxel as a circle enclosing the voxel square, so we're expanding the voxel
-	//	radius by center-to-corner diagonal.
+	//	radius by center-to-corner diagonal. The line is applied in ordinal space, where voxel positions
+	//	are known without computing them, so distances are in voxels.
 	//
 
 	const real 
-		VoxelRadius = _voxels.scale() * VoxelRadiusLocal,
-		MaxDist = (thickness * 0.5) + VoxelRadius,
-		MinDist = (thickness * 0.5) - VoxelRadius,
+		OneOverScale = 1 / _voxels.scale(),
+		VoxelRadius = cutting::VoxelRadiusLocal,
+		MaxDist = (thickness * 0.5 * OneOverScale) + VoxelRadius,
+		MinDist = (thickness * 0.5 * OneOverScale) - VoxelRadius,
 		OneOverMaxMinusMin = 1.0 / ( MaxDist - MinDist );
 
+	//
+	//	A voxel is affected if it lies within MaxDist of the line, or if one of its neighbor links
+	//	crosses it - and the longest ( diagonal ) link reaches twice VoxelRadius.
+	//
+
+	const real
+		ReachDist = std::max( MaxDist, 2 * VoxelRadius );
+
 	//
 	//	Filter the islands down to those which intersect the macro line bounds - later we'll filter to chunk bounds
 	//
@@ -165,74 +231,276 @@ unsigned int Terrain::cutLine(
 	
 	unsigned int effectMask = 0;
 	
+	#if PARALLEL_CUTS
+		const bool parallel = islands.size() > 1 && _workerPool->threadCount() > 0;
+	#else
+		const bool parallel = false;
+	#endif
+
+	if ( parallel )
+	{
+		effectMask = _cutLineInParallel( islands, MinDist, MaxDist, OneOverMaxMinusMin, ReachDist, strength, touchedScaledWorldPositions );
+	}
+	else
+	{
+		Vec2r a(_chunkedCuttingLine.front());
+		for ( Vec2rVec::const_iterator it( _chunkedCuttingLine.begin() + 1 ), end( _chunkedCuttingLine.end()); it != end; ++it )
+		{
+			Vec2r b = *it;
+			cpBB chunkBB;
+			cpBBNewLineSegment( chunkBB, a, b );
+		
+			for( std::vector< Island* >::const_iterator islandIt(islands.begin()), islandEnd(islands.end()); islandIt != islandEnd; ++islandIt )
+			{
+				Island *island = *islandIt;
+
+				if ( !cpBBIntersects( chunkBB, island->aabb() )) continue;
+			
+				//
+				// convert world space points to the island's ordinal space
+				//
+
+				IslandGroup *group = island->group();
+				const Vec2r &offset = group->ordinalToCentroidRelativeOffset();
+				util::line_segment lineInOrdinalSpace(
+					( group->modelviewInverse() * a - offset ) * OneOverScale,
+					( group->modelviewInverse() * b - offset ) * OneOverScale );
+
+				//
+				// we will want to know if this island actually was modified or not
+				//
+
+				unsigned int lineCutEffectMask = 0;
+				const std::vector< Voxel* > &voxels = _gatherCutVoxels( island, lineInOrdinalSpace.a, lineInOrdinalSpace.b, ReachDist );
+				for( std::vector< Voxel* >::const_iterator voxelIt(voxels.begin()), voxelEnd(voxels.end()); voxelIt != voxelEnd; ++voxelIt )
+				{
+					Voxel *voxel = *voxelIt;
+
+					unsigned int result = cutting::LineVoxelCut( 
+						voxel, 
+						lineInOrdinalSpace, 
+						MinDist, MaxDist, OneOverMaxMinusMin, 
+						strength );
+
+					if ( result )
+					{
+						lineCutEffectMask |= result;					
+						_markVoxelDirty( voxel );
+						touchedScaledWorldPositions.insert( _upscalePosition( group->worldPosition( voxel )));
+					}				
+				}
+			
+				//
+				//	if this island was touched by the line, so we need to mark it as affected
+				//
+
+				if ( lineCutEffectMask )
+				{
+					effectMask |= lineCutEffectMask;
+					_dirtyIslands.insert( island );
+				}			
+			}		
+		
+			a = b;
+		}
+	}
+	
+	//
+	//	If any voxels were touched, we need to mark an update is needed
+	//
+
+	if ( effectMask & CUT_AFFECTED_VOXELS )
+	{
+		_markDeferredGeometryUpdateNeeded();
+	}
+	
+	_phaseTimings.cutApplication += timer.mark();
+	_phaseTimings.cuts++;
+	
+	return effectMask;
+}
+
+#pragma mark - Parallel Line Cutting
+
+namespace {
+
+	// the distances cutLine applies its line with, in voxels, and its strength
+	struct line_cut_params
+	{
+		real minDist, maxDist, oneOverMaxMinusMin, reach, strength;
+	};
+
+	// one island's share of a parallel cutLine
+	struct island_line_cut
+	{
+		Island *island;
+
+		// the current chunk of the line in the island's ordinal space, if it reaches the island
+		util::line_segment line;
+		bool active;
+
+		std::vector< Voxel* > gathered, touched;
+
+		// the current chunk's voxels left for the serial pass
+		std::vector< Voxel* > deferred;
+
+		unsigned int effectMask;
+
+		island_line_cut( Island *i ):
+			island( i ),
+			line( Vec2r(0,0), Vec2r(0,0) ),
+			active( false ),
+			effectMask( 0 )
+		{}
+	};
+
+	/**
+		True if @a voxel, and every voxel it links to, belongs only to the island registered as @a membershipId.
+		Cutting such a voxel writes to no other island's voxels, so different islands' voxels can be cut at once.
+	*/
+	inline bool SolelyOwned( const Voxel *voxel, uint16_t membershipId )
+	{
+		if ( voxel->islandCount != 1 || voxel->islandId != membershipId ) return false;
+
+		for ( int dir = 0; dir < 8; ++dir )
+		{
+			const Voxel *neighbor = voxel->neighbors[dir];
+			if ( neighbor && ( neighbor->islandCount != 1 || neighbor->islandId != membershipId )) return false;
+		}
+
+		return true;
+	}
+
+	// apply @a cut's current chunk to the voxels its island solely owns, deferring the others
+	void CutIslandLineChunk( island_line_cut *cut, const OrdinalVoxelStore *store, const line_cut_params *params )
+	{
+		const uint16_t membershipId = cut->island->membershipId();
+
+		cut->gathered.clear();
+		GatherCutVoxels( *store, cut->island, cut->line.a, cut->line.b, params->reach, cut->gathered );
+
+		foreach( Voxel *voxel, cut->gathered )
+		{
+			if ( !SolelyOwned( voxel, membershipId ))
+			{
+				cut->deferred.push_back( voxel );
+				continue;
+			}
+
+			const unsigned int result = cutting::LineVoxelCut( 
+				voxel, 
+				cut->line, 
+				params->minDist, params->maxDist, params->oneOverMaxMinusMin, 
+				params->strength );
+
+			if ( result )
+			{
+				cut->effectMask |= result;
+				cut->touched.push_back( voxel );
+			}
+		}
+	}
+
+}
+
+unsigned int Terrain::_cutLineInParallel( 
+	const std::vector< Island* > &islands,
+	real minDist,
+	real maxDist,
+	real oneOverMaxMinusMin,
+	real reach,
+	real strength,
+	Vec2iSet &touchedScaledWorldPositions )
+{
+	const real OneOverScale = 1 / _voxels.scale();
+	const line_cut_params params = { minDist, maxDist, oneOverMaxMinusMin, reach, strength };
+
+	std::vector< island_line_cut > cuts;
+	cuts.reserve( islands.size() );
+	foreach( Island *island, islands )
+	{
+		cuts.push_back( island_line_cut( island ));
+	}
+
+	//
+	//	Chunks are applied one at a time, as cutLine applies them. For each, every island it reaches cuts the 
+	//	voxels only it can reach on the pool, at the same time as every other island; once they're done, the 
+	//	voxels linked to another island's are cut on this thread, island by island. A solely owned voxel shares
+	//	no link with a deferred one, so the voxels end up as cutLine's serial loop would leave them.
+	//
+
 	Vec2r a(_chunkedCuttingLine.front());
 	for ( Vec2rVec::const_iterator it( _chunkedCuttingLine.begin() + 1 ), end( _chunkedCuttingLine.end()); it != end; ++it )
 	{
-		Vec2r b = *it;
+		const Vec2r b = *it;
 		cpBB chunkBB;
 		cpBBNewLineSegment( chunkBB, a, b );
-		
-		for( std::vector< Island* >::const_iterator islandIt(islands.begin()), islandEnd(islands.end()); islandIt != islandEnd; ++islandIt )
+
+		//
+		//	Move the chunk to the ordinal space of each island it reaches. Group transforms are
+		//	computed lazily, so this is done here rather than on the pool.
+		//
+
+		foreach( island_line_cut &cut, cuts )
 		{
-			Island *island = *islandIt;
+			cut.active = cpBBIntersects( chunkBB, cut.island->aabb() );
+			cut.deferred.clear();
+			if ( !cut.active ) continue;
 
-			if ( !cpBBIntersects( chunkBB, island->aabb() )) continue;
-			
-			//
-			// convert world space points to island-group-local
-			//
+			IslandGroup *group = cut.island->group();
+			const Vec2r &offset = group->ordinalToCentroidRelativeOffset();
+			cut.line = util::line_segment(
+				( group->modelviewInverse() * a - offset ) * OneOverScale,
+				( group->modelviewInverse() * b - offset ) * OneOverScale );
+
+			_workerPool->add( boost::bind( &CutIslandLineChunk, &cut, &_voxels, &params ));
+		}
 
-			util::line_segment lineInGroupSpace(
-				island->group()->modelviewInverse() * a,
-				island->group()->modelviewInverse() * b);
+		_workerPool->wait();
 
-			//
-			// we will want to know if this island actually was modified or not
-			//
+		foreach( island_line_cut &cut, cuts )
+		{
+			if ( !cut.active ) continue;
 
-			unsigned int lineCutEffectMask = 0;
-			for( std::vector< Voxel* >::iterator voxelIt(island->_voxels.begin()), voxelEnd(island->_voxels.end()); voxelIt != voxelEnd; ++voxelIt )
+			foreach( Voxel *voxel, cut.deferred )
 			{
-				Voxel *voxel = *voxelIt;
-
-				unsigned int result = LineVoxelCut( 
+				const unsigned int result = cutting::LineVoxelCut( 
 					voxel, 
-					lineInGroupSpace, 
-					MinDist, MaxDist, OneOverMaxMinusMin, 
+					cut.line, 
+					minDist, maxDist, oneOverMaxMinusMin, 
 					strength );
 
 				if ( result )
 				{
-					lineCutEffectMask |= result;					
-					touchedScaledWorldPositions.insert( 
-						_upscalePosition( island->group()->fixed() ? voxel->centroidRelativePosition
-							: island->group()->modelview() * voxel->centroidRelativePosition ));
-				}				
+					cut.effectMask |= result;
+					cut.touched.push_back( voxel );
+				}
 			}
-			
-			//
-			//	if this island was touched by the line, so we need to mark it as affected
-			//
+		}
 
-			if ( lineCutEffectMask )
-			{
-				effectMask |= lineCutEffectMask;
-				_dirtyIslands.insert( island );
-			}			
-		}		
-		
 		a = b;
 	}
-	
+
 	//
-	//	If any voxels were touched, we need to mark an update is needed
+	//	Merge each island's effect and touched voxels
 	//
 
-	if ( effectMask & CUT_AFFECTED_VOXELS )
+	unsigned int effectMask = 0;
+	foreach( island_line_cut &cut, cuts )
 	{
-		_markDeferredGeometryUpdateNeeded();
+		if ( !cut.effectMask ) continue;
+
+		IslandGroup *group = cut.island->group();
+		foreach( Voxel *voxel, cut.touched )
+		{
+			_markVoxelDirty( voxel );
+			touchedScaledWorldPositions.insert( _upscalePosition( group->worldPosition( voxel )));
+		}
+
+		effectMask |= cut.effectMask;
+		_dirtyIslands.insert( cut.island );
 	}
-	
+
 	return effectMask;
 }
 
@@ -254,83 +522,96 @@ unsigned int Terrain::cutDisk(
 
 	strength = std::min( strength, real(1));
 
+	if ( _cutRecording ) 
+	{
+		_recordCut( recorded_cut::DISK, position, position, radius, strength, cutType, restrictToIsland, NULL );
+	}
+
+	Stopwatch timer;
+
 	//
 	//	Get the storage for touched voxel positions for this cut
 	//
 
 	Vec2iSet &touchedScaledWorldPositions = _touchedScaledWorldPositionsByCut[cutType];
-	Mat4r islandModelview = restrictToIsland->group()->modelview();
-
-	const real
-		VoxelRadius = _voxels.scale() * VoxelRadiusLocal,
-		MinDistToTouch = radius + VoxelRadius,
-        MinDistForCompleteOverlap = radius - VoxelRadius,
-        MinDistSquaredToTouch = MinDistToTouch * MinDistToTouch;
+	IslandGroup *group = restrictToIsland->group();
 
 	//
-	//	Now we're going to iterate the island's voxels.
-    //  Move disk position to group space of Island.
+	//	Move disk position to the ordinal space of Island.
 	//
     	
-	Vec2r positionInGroupSpace = restrictToIsland->group()->modelviewInverse() * position;
+	const real Scale = _voxels.scale();
+	const Vec2r center = ( group->modelviewInverse() * position - group->ordinalToCentroidRelativeOffset() ) / Scale;
 	unsigned int effectMask = 0;
-	
 
-	for( std::vector< Voxel* >::iterator voxelIt(restrictToIsland->_voxels.begin()), voxelEnd(restrictToIsland->_voxels.end()); voxelIt != voxelEnd; ++voxelIt )
-	{
-		Voxel *voxel = *voxelIt;		
-		real distSquared = positionInGroupSpace.distanceSquared( voxel->centroidRelativePosition );
-				
-		if ( distSquared < MinDistSquaredToTouch )
+	#if STENCIL_CUTS
+
+		//
+		//	Stamp the stencil for this radius and sub-voxel center onto the island's voxels around it
+		//
+
+		Vec2i origin;
+		const disk_stencil &stencil = _diskStencil( radius / Scale, center, origin );
+
+		for ( std::vector< disk_stencil::cell >::const_iterator cell( stencil.cells.begin() ), end( stencil.cells.end() ); cell != end; ++cell )
 		{
-            //
-			//  disregard uncuttable voxels
-            //  note: we have to check for fixed voxels that could have been touched for CUT_HIT_VOXELS to be meaningful
-            //
+			Voxel *voxel = _voxels.voxelAt( origin + cell->offset );
+			if ( !voxel || !restrictToIsland->owns( voxel )) continue;
 
-			if ( voxel->fixed() ) 
+			const unsigned int voxelEffectMask = cutting::DiskVoxelCut( voxel, cell->overlap, cell->clears, strength );
+			if ( voxelEffectMask & CUT_AFFECTED_VOXELS )
 			{
-				effectMask |= CUT_HIT_FIXED_VOXELS;
-				continue;
+				_markVoxelDirty( voxel );
+				touchedScaledWorldPositions.insert( _upscalePosition( group->worldPosition( voxel )));
 			}
 
+			effectMask |= voxelEffectMask;
+		}
 
-            //
-            //  overlap goes from 0 for no overlap to 1 for complete overlap
-            //
+	#else
 
-			real dist = std::sqrt( distSquared ),
-				 overlap = real(1) - saturate( (dist - MinDistForCompleteOverlap) / ( MinDistToTouch - MinDistForCompleteOverlap ));
-            
-            //
-			//  ablation is the amount that could be removed based on overlap, cut strength and the voxel's strength, 0->255
-            //  note that ablation falls to zero as voxel strength goes to 255
-            //
+		//
+		//	Distances are in voxels, since we're in ordinal space
+		//
 
-			int ablation = 255 * (((255 - voxel->strength)/real(255)) * overlap * strength);
-			
-			if ( ablation > 0 )
-			{
-				voxel->occupation = std::max( voxel->occupation - ablation, 0 );
-				effectMask |= CUT_AFFECTED_VOXELS;
+		const real
+			VoxelRadius = cutting::VoxelRadiusLocal,
+			MinDistToTouch = ( radius / Scale ) + VoxelRadius,
+			MinDistForCompleteOverlap = ( radius / Scale ) - VoxelRadius,
+			MinDistSquaredToTouch = MinDistToTouch * MinDistToTouch;
 
-				touchedScaledWorldPositions.insert( 
-					_upscalePosition( 
-						islandModelview * voxel->centroidRelativePosition ));
-				
+		//
+		//	Now we're going to iterate the island's voxels.
+		//
+
+		const std::vector< Voxel* > &voxels = _gatherCutVoxels( restrictToIsland, center, center, MinDistToTouch );
+		for( std::vector< Voxel* >::const_iterator voxelIt(voxels.begin()), voxelEnd(voxels.end()); voxelIt != voxelEnd; ++voxelIt )
+		{
+			Voxel *voxel = *voxelIt;		
+			real distSquared = center.distanceSquared( Vec2r( voxel->ordinalPosition ));
+					
+			if ( distSquared < MinDistSquaredToTouch )
+			{
 				//
-				//	Now if the cutting disc completely overlaps the voxel, we disconnect its outgoing connections
+				//  overlap goes from 0 for no overlap to 1 for complete overlap. If the cutting disc completely 
+				//	overlaps the voxel, we disconnect its outgoing connections.
 				//
-				
-				if ( voxel->occupation < MinimumVoxelOccupation || (dist < MinDistForCompleteOverlap + Epsilon) )
+
+				real dist = std::sqrt( distSquared ),
+					 overlap = real(1) - saturate( (dist - MinDistForCompleteOverlap) / ( MinDistToTouch - MinDistForCompleteOverlap ));
+
+				const unsigned int voxelEffectMask = cutting::DiskVoxelCut( voxel, overlap, dist < MinDistForCompleteOverlap + Epsilon, strength );
+				if ( voxelEffectMask & CUT_AFFECTED_VOXELS )
 				{
-					effectMask |= CUT_AFFECTED_ISLAND_CONNECTIVITY;
-					voxel->disconnect();
-					voxel->occupation = 0;
-				}				
-			}
-		}				
-	}
+					_markVoxelDirty( voxel );
+					touchedScaledWorldPositions.insert( _upscalePosition( group->worldPosition( voxel )));
+				}
+
+				effectMask |= voxelEffectMask;
+			}				
+		}
+
+	#endif
 	
 	/////////////////
 	
@@ -344,6 +625,9 @@ unsigned int Terrain::cutDisk(
 		_markDeferredGeometryUpdateNeeded();
 	}
 
+	_phaseTimings.cutApplication += timer.mark();
+	_phaseTimings.cuts++;
+
 	return effectMask;
 }
 
@@ -351,12 +635,12 @@ unsigned int Terrain::cutDisk(
 
 namespace {
 
-	bool voxel_voxel_cut( Voxel *a, Voxel *b, real radiusWorld, real strength, unsigned int &aCutResultMask, unsigned int &bCutResultMask )
+	// cut @a a and @a b against one another, where @a distance2 is the squared distance between them
+	bool voxel_voxel_cut( Voxel *a, Voxel *b, real distance2, real radiusWorld, real strength, unsigned int &aCutResultMask, unsigned int &bCutResultMask )
 	{		
 		const real 
-			Distance2 = a->worldPosition.distanceSquared( b->worldPosition ),
-			Overlap = 1 - ( Distance2 / ((2*radiusWorld)*(2*radiusWorld))),
-			//Distance = a->worldPosition.distance(b->worldPosition),
+			Overlap = 1 - ( distance2 / ((2*radiusWorld)*(2*radiusWorld))),
+			//Distance = std::sqrt( distance2 ),
 			//Overlap = 1 - (Distance/(2*radiusWorld)),
 			AStrength = static_cast<real>(a->strength)/real(255),
 			BStrength = static_cast<real>(b->strength)/real(255),
@@ -408,19 +692,158 @@ namespace {
 		return aCutResultMask && bCutResultMask;
 	}
 
-}
+	// what cutTerrain needs to know of its cutting island to find contacts with a target island
+	struct terrain_cut_context
+	{
+		const OrdinalVoxelStore *store;
+		Island *cuttingIsland;
+		Mat4r cuttingIslandModelview, cuttingIslandModelviewInverse;
+		Vec2r cuttingIslandOffset;
+		cpBB cuttingIslandBounds;
+		real voxelScale, voxelRadiusWorld, voxelRadiusWorld2;
+	};
 
-unsigned int Terrain::cutTerrain( Island *cuttingIsland, real strength, TerrainCutType::cut_type cutType, Island *restrictToIsland )
-{
-	if ( strength < ALPHA_EPSILON ) return 0;
-	strength = std::min( strength, real(1));
+	// a cutting voxel close enough to a target voxel to cut it
+	struct voxel_contact
+	{
+		Voxel *cuttingVoxel, *targetVoxel;
+		real distance2;
+		Vec2r targetWorldPosition;
+	};
 
-	unsigned int cutResultEffectMask = 0;
+	// a target island of cutTerrain, and the contacts its voxels make with the cutting island's
+	struct island_terrain_cut
+	{
+		Island *island;
+		Mat4r modelview;
+		Vec2r offset;
+		std::vector< voxel_contact > contacts;
+		std::vector< Voxel* > cuttingVoxels;
+
+		island_terrain_cut( Island *i ):
+			island( i ),
+			modelview( i->group()->modelview() ),
+			offset( i->group()->ordinalToCentroidRelativeOffset() )
+		{}
+	};
 
-	const real 
-		Scale = 0.5,
-		VoxelRadiusWorld = Scale * 0.707106781 * _voxels.scale(),
-		VoxelRadiusWorld2 = VoxelRadiusWorld * VoxelRadiusWorld;
+	/**
+		Find the contacts between @a target's voxels and the voxels of @a context's cutting island, in the order cutTerrain
+		applies them. Only reads voxels, so may be run for several target islands at once.
+	*/
+	void FindVoxelContacts( const terrain_cut_context *context, island_terrain_cut *target )
+	{
+		//
+		//	Without stencils, holy On^2 batman - each voxel has to test against the other. At least we're pruning to the 
+		//	minimum overlapping subset.
+		//
+
+		cpBB intersectionBounds;
+		if ( !cpBBIntersection( context->cuttingIslandBounds, target->island->aabb(), intersectionBounds )) return;
+
+		const real 
+			VoxelScale = context->voxelScale,
+			OneOverScale = 1 / VoxelScale,
+			VoxelRadiusWorld = context->voxelRadiusWorld;
+
+		for( std::vector< Voxel* >::const_iterator 
+			targetVoxelIt( target->island->voxels().begin()), 
+			targetVoxelItEnd( target->island->voxels().end());
+			targetVoxelIt != targetVoxelItEnd;
+			++targetVoxelIt )
+		{
+			Voxel *targetVoxel = *targetVoxelIt;
+			const Vec2r targetVoxelWorldPosition = target->modelview * ( Vec2r( targetVoxel->ordinalPosition ) * VoxelScale + target->offset );
+			
+			//
+			//	Only process voxels which are in the overlapping region
+			//
+
+			if ( cpBBContainsCircle( intersectionBounds, targetVoxelWorldPosition, VoxelRadiusWorld ))
+			{
+				const Vec2r targetVoxelCuttingPosition = context->cuttingIslandModelviewInverse * targetVoxelWorldPosition;
+
+				#if STENCIL_CUTS
+
+					//
+					//	The cutting island's voxels lie on the shared ordinal grid, so the island's membership there serves as
+					//	its stencil: only the voxels around a target voxel's position on the cutting island's grid can be within
+					//	VoxelRadiusWorld of it. Look at the 3x3 around the nearest, to absorb rounding in the transforms.
+					//
+
+					const Vec2r ordinal = ( targetVoxelCuttingPosition - context->cuttingIslandOffset ) * OneOverScale;
+					const int 
+						ox = int( std::floor( ordinal.x + real(0.5) )),
+						oy = int( std::floor( ordinal.y + real(0.5) ));
+
+					target->cuttingVoxels.clear();
+					for ( int y = oy - 1; y <= oy + 1; y++ )
+					{
+						for ( int x = ox - 1; x <= ox + 1; x++ )
+						{
+							Voxel *cuttingVoxel = context->store->voxelAt( x, y );
+							if ( cuttingVoxel && context->cuttingIsland->owns( cuttingVoxel ))
+							{
+								target->cuttingVoxels.push_back( cuttingVoxel );
+							}
+						}
+					}
+
+					const std::vector< Voxel* > &cuttingVoxels = target->cuttingVoxels;
+
+				#else
+
+					const std::vector< Voxel* > &cuttingVoxels = context->cuttingIsland->voxels();
+
+				#endif
+
+				for( std::vector< Voxel* >::const_iterator 
+					cuttingVoxelIt( cuttingVoxels.begin()), 
+					cuttingVoxelItEnd( cuttingVoxels.end());
+					cuttingVoxelIt != cuttingVoxelItEnd;
+					++cuttingVoxelIt )
+				{
+					Voxel *cuttingVoxel = *cuttingVoxelIt;
+					const Vec2r cuttingVoxelPosition = Vec2r( cuttingVoxel->ordinalPosition ) * VoxelScale + context->cuttingIslandOffset;
+					const real distance2 = cuttingVoxelPosition.distanceSquared( targetVoxelCuttingPosition );
+				
+					if ( 
+						distance2 < context->voxelRadiusWorld2 &&
+						cpBBContainsCircle( intersectionBounds, context->cuttingIslandModelview * cuttingVoxelPosition, VoxelRadiusWorld )
+					)
+					{
+						voxel_contact contact;
+						contact.cuttingVoxel = cuttingVoxel;
+						contact.targetVoxel = targetVoxel;
+						contact.distance2 = distance2;
+						contact.targetWorldPosition = targetVoxelWorldPosition;
+						target->contacts.push_back( contact );
+					}
+				}
+			}			
+		}
+	}
+
+}
+
+unsigned int Terrain::cutTerrain( Island *cuttingIsland, real strength, TerrainCutType::cut_type cutType, Island *restrictToIsland )
+{
+	if ( strength < ALPHA_EPSILON ) return 0;
+	strength = std::min( strength, real(1));
+
+	if ( _cutRecording ) 
+	{
+		_recordCut( recorded_cut::TERRAIN, Vec2r(0,0), Vec2r(0,0), 0, strength, cutType, restrictToIsland, cuttingIsland );
+	}
+
+	Stopwatch timer;
+
+	unsigned int cutResultEffectMask = 0;
+
+	const real 
+		Scale = 0.5,
+		VoxelRadiusWorld = Scale * 0.707106781 * _voxels.scale(),
+		VoxelRadiusWorld2 = VoxelRadiusWorld * VoxelRadiusWorld;
 		
 
 	unsigned int cuttingIslandCutEffectMask = 0;
@@ -446,21 +869,48 @@ unsigned int Terrain::cutTerrain( Island *cuttingIsland, real strength, TerrainC
 	}
 	
 	//
-	//	Update world positions of cutting island, if it's dynamic. If it's static the worldPosition
-	//	is already correct from initialization.
+	//	Voxels don't store positions. Each target voxel is brought to the world, and from there to the cutting 
+	//	island's group space, where cutting voxels are positioned by their scaled ordinal position and offset.
+	//	Group transforms are computed lazily, so they're gathered here, before contacts might be found on the pool.
 	//
-	
-	if ( !cuttingIslandGroup->fixed() )
+
+	terrain_cut_context context;
+	context.store = &_voxels;
+	context.cuttingIsland = cuttingIsland;
+	context.cuttingIslandModelview = cuttingIslandGroup->modelview();
+	context.cuttingIslandModelviewInverse = cuttingIslandGroup->modelviewInverse();
+	context.cuttingIslandOffset = cuttingIslandGroup->ordinalToCentroidRelativeOffset();
+	context.cuttingIslandBounds = cuttingIslandBounds;
+	context.voxelScale = _voxels.scale();
+	context.voxelRadiusWorld = VoxelRadiusWorld;
+	context.voxelRadiusWorld2 = VoxelRadiusWorld2;
+
+	std::vector< island_terrain_cut > targets;
+	targets.reserve( islands.size() );
+	foreach( Island *targetIsland, islands )
+	{
+		targets.push_back( island_terrain_cut( targetIsland ));
+	}
+
+	//
+	//	Finding contacts only reads voxels, so with more than one target island, find each one's on the worker pool.
+	//	Contacts are applied in the same order either way.
+	//
+
+	#if PARALLEL_CUTS
+		const bool parallel = targets.size() > 1 && _workerPool->threadCount() > 0;
+	#else
+		const bool parallel = false;
+	#endif
+
+	if ( parallel )
 	{
-		Mat4r mv = cuttingIslandGroup->modelview();
-		for( std::vector< Voxel* >::iterator 
-			cuttingVoxel( cuttingIsland->voxels().begin()), 
-			cuttingVoxelEnd( cuttingIsland->voxels().end());
-			cuttingVoxel != cuttingVoxelEnd;
-			++cuttingVoxel )
+		foreach( island_terrain_cut &target, targets )
 		{
-			(*cuttingVoxel)->worldPosition = mv * (*cuttingVoxel)->centroidRelativePosition;
+			_workerPool->add( boost::bind( &FindVoxelContacts, &context, &target ));
 		}
+
+		_workerPool->wait();
 	}
 
 	//
@@ -473,63 +923,24 @@ unsigned int Terrain::cutTerrain( Island *cuttingIsland, real strength, TerrainC
 	//	Now, for each Island which the cuttingIsland might intersect...
 	//
 	
-	foreach( Island *targetIsland, islands )
+	foreach( island_terrain_cut &target, targets )
 	{
 		unsigned int targetIslandCutEffectMask = 0;
-		
-		IslandGroup *targetIslandGroup = targetIsland->group();
-		Mat4r islandGroupModelView = targetIslandGroup->modelview();
-
-		//
-		//	Holy On^2 batman - each voxel has to test against the other. At least we're pruning to the minimum overlapping subset.
-		//
-
-		cpBB intersectionBounds;
-		if ( !cpBBIntersection( cuttingIslandBounds, targetIsland->aabb(), intersectionBounds )) continue;
-
 
-		for( std::vector< Voxel* >::iterator 
-			targetVoxelIt( targetIsland->voxels().begin()), 
-			targetVoxelItEnd( targetIsland->voxels().end());
-			targetVoxelIt != targetVoxelItEnd;
-			++targetVoxelIt )
+		if ( !parallel ) 
 		{
-			Voxel *targetVoxel = *targetVoxelIt;
-		
-			//
-			//	If the group is dynamic, we need to update the worldPosition - if it's static the world
-			//	position is already correct.
-			//
+			FindVoxelContacts( &context, &target );
+		}
 
-			if ( !targetIslandGroup->fixed() )
-			{
-				targetVoxel->worldPosition = targetVoxel->centroidRelativePosition * islandGroupModelView;
-			}
+		foreach( const voxel_contact &contact, target.contacts )
+		{
+			_markVoxelDirty( contact.cuttingVoxel );
+			_markVoxelDirty( contact.targetVoxel );
 			
-			//
-			//	Only process voxels which are in the overlapping region
-			//
-
-			if ( cpBBContainsCircle( intersectionBounds, targetVoxel->worldPosition, VoxelRadiusWorld ))
+			if ( voxel_voxel_cut( contact.cuttingVoxel, contact.targetVoxel, contact.distance2, VoxelRadiusWorld, strength, cuttingIslandCutEffectMask, targetIslandCutEffectMask ))
 			{
-				for( std::vector< Voxel* >::iterator 
-					cuttingVoxelIt( cuttingIsland->voxels().begin()), 
-					cuttingVoxelItEnd( cuttingIsland->voxels().end());
-					cuttingVoxelIt != cuttingVoxelItEnd;
-					++cuttingVoxelIt )
-				{
-					Voxel *cuttingVoxel = *cuttingVoxelIt;
-				
-					if ( 
-						cpBBContainsCircle( intersectionBounds, cuttingVoxel->worldPosition, VoxelRadiusWorld ) && 
-						cuttingVoxel->worldPosition.distanceSquared( targetVoxel->worldPosition ) < VoxelRadiusWorld2 &&
-						voxel_voxel_cut( cuttingVoxel, targetVoxel, VoxelRadiusWorld, strength, cuttingIslandCutEffectMask, targetIslandCutEffectMask )
-					)
-					{
-						touchedScaledWorldPositions.insert( _upscalePosition( targetVoxel->worldPosition ));
-					}
-				}
-			}			
+				touchedScaledWorldPositions.insert( _upscalePosition( contact.targetWorldPosition ));
+			}
 		}
 		
 		//
@@ -539,7 +950,7 @@ unsigned int Terrain::cutTerrain( Island *cuttingIsland, real strength, TerrainC
 		if ( targetIslandCutEffectMask )
 		{
 			cutResultEffectMask |= targetIslandCutEffectMask;
-			_dirtyIslands.insert( targetIsland );
+			_dirtyIslands.insert( target.island );
 		}			
 	}
 	
@@ -562,7 +973,400 @@ unsigned int Terrain::cutTerrain( Island *cuttingIsland, real strength, TerrainC
 		_markDeferredGeometryUpdateNeeded();
 	}
 
-	return cutResultEffectMask;
+	_phaseTimings.cutApplication += timer.mark();
+	_phaseTimings.cuts++;
+
+	return cutResultEffectMask;
+}
+
+#pragma mark - Batch Cutting
+
+namespace {
+
+	// a line or disk of a cutBatch in world space, with the distances used in applying it
+	struct batch_cut
+	{
+		cut_primitive::kind type;
+		Vec2r a, b;	// for disks, both are the center
+		real strength, reach;
+
+		// in voxels, since cuts are applied in ordinal space; for lines, as in cutLine; for disks, as in cutDisk
+		real ordinalRadius, ordinalReach, ordinalReach2, minDist, maxDist, oneOverMaxMinusMin;
+	};
+
+	typedef std::pair< util::line_segment, const batch_cut* > batch_line;
+	typedef std::pair< Vec2r, const batch_cut* > batch_disk;
+
+}
+
+unsigned int Terrain::cutBatch( const std::vector< cut_primitive > &cuts, TerrainCutType::cut_type cutType, Island *restrictToIsland )
+{
+	Stopwatch timer;
+
+	const real 
+		VoxelRadius = cutting::VoxelRadiusLocal,
+		OneOverScale = 1 / _voxels.scale();
+
+	//
+	//	Sanity check and record the lines and disks, and find the world bounds each can reach.
+	//	Cutting islands are matched voxel against voxel by cutTerrain, and gain nothing from batching.
+	//
+
+	std::vector< batch_cut > worldCuts;
+	std::vector< cpBB > worldCutBounds;
+	std::vector< const cut_primitive* > shapeCuts;
+	cpBB batchBounds = cpBBInvalid;
+
+	foreach( const cut_primitive &cut, cuts )
+	{
+		if ( cut.type == cut_primitive::TERRAIN )
+		{
+			if ( cut.cuttingIsland ) shapeCuts.push_back( &cut );
+			continue;
+		}
+
+		if ( cut.size < Epsilon || cut.strength < Epsilon ) continue;
+
+		batch_cut worldCut;
+		worldCut.type = cut.type;
+		worldCut.a = cut.start;
+		worldCut.b = cut.type == cut_primitive::LINE ? cut.end : cut.start;
+		worldCut.strength = std::min( cut.strength, real(1));
+
+		worldCut.ordinalRadius = cut.type == cut_primitive::LINE ? cut.size * 0.5 * OneOverScale : cut.size * OneOverScale;
+
+		if ( cut.type == cut_primitive::LINE )
+		{
+			worldCut.maxDist = ( cut.size * 0.5 * OneOverScale ) + VoxelRadius;
+			worldCut.minDist = ( cut.size * 0.5 * OneOverScale ) - VoxelRadius;
+			worldCut.ordinalReach = std::max( worldCut.maxDist, 2 * VoxelRadius );
+		}
+		else
+		{
+			worldCut.maxDist = ( cut.size * OneOverScale ) + VoxelRadius;
+			worldCut.minDist = ( cut.size * OneOverScale ) - VoxelRadius;
+			worldCut.ordinalReach = worldCut.maxDist;
+		}
+
+		worldCut.oneOverMaxMinusMin = 1 / ( worldCut.maxDist - worldCut.minDist );
+		worldCut.ordinalReach2 = worldCut.ordinalReach * worldCut.ordinalReach;
+		worldCut.reach = worldCut.ordinalReach * _voxels.scale();
+
+		if ( _cutRecording ) 
+		{
+			_recordCut( cut.type == cut_primitive::LINE ? recorded_cut::LINE : recorded_cut::DISK, 
+				worldCut.a, worldCut.b, cut.size, worldCut.strength, cutType, restrictToIsland, NULL );
+		}
+
+		cpBB bounds;
+		cpBBNewLineSegment( bounds, worldCut.a, worldCut.b, worldCut.reach );
+		cpBBExpand( batchBounds, bounds );
+
+		worldCuts.push_back( worldCut );
+		worldCutBounds.push_back( bounds );
+	}
+
+	unsigned int effectMask = 0;
+
+	if ( !worldCuts.empty() )
+	{
+		//
+		//	Filter the islands down to those the batch might touch, once
+		//
+
+		std::vector< Island* > islands;
+		if ( restrictToIsland )
+		{
+			islands.push_back( restrictToIsland );
+		}
+		else
+		{
+			for( std::vector< Island* >::const_iterator it(_allIslands.begin()),end(_allIslands.end()); it != end; ++it )
+			{
+				if ( cpBBIntersects( (*it)->aabb(), batchBounds )) islands.push_back( *it );
+			}	
+		}
+
+		Vec2iSet &touchedScaledWorldPositions = _touchedScaledWorldPositionsByCut[cutType];
+		std::vector< batch_line > islandLines;
+		std::vector< batch_disk > islandDisks;
+
+		foreach( Island *island, islands )
+		{
+			IslandGroup *group = island->group();
+			const Mat4r &modelviewInverse = group->modelviewInverse();
+			const Vec2r &offset = group->ordinalToCentroidRelativeOffset();
+			const cpBB islandBounds = island->aabb();
+
+			//
+			//	Move the cuts reaching this island to its ordinal space, and gather the voxels under them
+			//
+
+			islandLines.clear();
+			islandDisks.clear();
+			_cutVoxels.clear();
+			island_voxel_gatherer gatherer( _voxels, island, _cutVoxels );
+
+			for ( std::size_t i = 0, N = worldCuts.size(); i < N; i++ )
+			{
+				if ( !cpBBIntersects( worldCutBounds[i], islandBounds )) continue;
+
+				const batch_cut &cut = worldCuts[i];
+				const Vec2r 
+					a = ( modelviewInverse * cut.a - offset ) * OneOverScale,
+					b = ( modelviewInverse * cut.b - offset ) * OneOverScale;
+
+				if ( cut.type == cut_primitive::LINE )
+				{
+					islandLines.push_back( batch_line( util::line_segment( a, b ), &cut ));
+					cutting::RasterizeCapsule( a, b, cut.ordinalReach, island->voxelBoundsOrdinal(), gatherer );
+				}
+				else
+				{
+					islandDisks.push_back( batch_disk( a, &cut ));
+
+					#if !STENCIL_CUTS
+						cutting::RasterizeCapsule( a, b, cut.ordinalReach, island->voxelBoundsOrdinal(), gatherer );
+					#endif
+				}
+			}
+
+			if ( _cutVoxels.empty() && islandDisks.empty() ) continue;
+
+			//
+			//	Overlapping cuts gather the same voxels; visit each once, applying every cut which reaches it
+			//
+
+			std::sort( _cutVoxels.begin(), _cutVoxels.end() );
+			_cutVoxels.erase( std::unique( _cutVoxels.begin(), _cutVoxels.end() ), _cutVoxels.end() );
+
+			unsigned int islandEffectMask = 0;
+			foreach( Voxel *voxel, _cutVoxels )
+			{
+				const Vec2r position( voxel->ordinalPosition );
+				unsigned int voxelEffectMask = 0;
+				bool touched = false;
+
+				foreach( const batch_line &line, islandLines )
+				{
+					const batch_cut &cut = *line.second;
+					if ( line.first.distance( position ) > cut.ordinalReach ) continue;
+
+					const unsigned int result = cutting::LineVoxelCut( 
+						voxel, 
+						line.first, 
+						cut.minDist, cut.maxDist, cut.oneOverMaxMinusMin, 
+						cut.strength );
+
+					voxelEffectMask |= result;
+					touched = touched || result;
+				}
+
+				#if !STENCIL_CUTS
+
+					foreach( const batch_disk &disk, islandDisks )
+					{
+						const batch_cut &cut = *disk.second;
+						const real distSquared = disk.first.distanceSquared( position );
+						if ( distSquared >= cut.ordinalReach2 ) continue;
+
+						const real 
+							dist = std::sqrt( distSquared ),
+							overlap = real(1) - saturate(( dist - cut.minDist ) * cut.oneOverMaxMinusMin );
+
+						const unsigned int result = cutting::DiskVoxelCut( voxel, overlap, dist < cut.minDist + Epsilon, cut.strength );
+
+						voxelEffectMask |= result;
+						touched = touched || ( result & CUT_AFFECTED_VOXELS );
+					}
+
+				#endif
+
+				if ( touched )
+				{
+					_markVoxelDirty( voxel );
+					touchedScaledWorldPositions.insert( _upscalePosition( group->worldPosition( voxel )));
+				}
+
+				islandEffectMask |= voxelEffectMask;
+			}
+
+			#if STENCIL_CUTS
+
+				//
+				//	Disks stamp the same cached stencils cutDisk does, so a disk removes the same voxels whichever
+				//	way it's cut. Each voxel has had the lines reaching it applied by now, as when visited above.
+				//
+
+				foreach( const batch_disk &disk, islandDisks )
+				{
+					const batch_cut &cut = *disk.second;
+
+					Vec2i origin;
+					const disk_stencil &stencil = _diskStencil( cut.ordinalRadius, disk.first, origin );
+
+					for ( std::vector< disk_stencil::cell >::const_iterator cell( stencil.cells.begin() ), end( stencil.cells.end() ); cell != end; ++cell )
+					{
+						Voxel *voxel = _voxels.voxelAt( origin + cell->offset );
+						if ( !voxel || !island->owns( voxel )) continue;
+
+						const unsigned int result = cutting::DiskVoxelCut( voxel, cell->overlap, cell->clears, cut.strength );
+						if ( result & CUT_AFFECTED_VOXELS )
+						{
+							_markVoxelDirty( voxel );
+							touchedScaledWorldPositions.insert( _upscalePosition( group->worldPosition( voxel )));
+						}
+
+						islandEffectMask |= result;
+					}
+				}
+
+			#endif
+
+			if ( islandEffectMask )
+			{
+				effectMask |= islandEffectMask;
+				_dirtyIslands.insert( island );
+			}
+		}
+
+		if ( effectMask & CUT_AFFECTED_VOXELS )
+		{
+			_markDeferredGeometryUpdateNeeded();
+		}
+
+		_phaseTimings.cutApplication += timer.mark();
+		_phaseTimings.cuts += worldCuts.size();
+	}
+
+	foreach( const cut_primitive *cut, shapeCuts )
+	{
+		effectMask |= cutTerrain( cut->cuttingIsland, cut->strength, cutType, restrictToIsland );
+	}
+
+	return effectMask;
+}
+
+#pragma mark - Cut Recording
+
+namespace {
+
+	/**
+		Refer to @a island by the ordinal position of one of its voxels, preferring one no other island shares
+	*/
+	Vec2i IslandReference( Island *island )
+	{
+		if ( !island || island->voxels().empty() ) return Vec2i(-1,-1);
+	
+		foreach( Voxel *v, island->voxels() )
+		{
+			if ( v->islandCount == 1 ) return v->ordinalPosition;
+		}
+		
+		return island->voxels().front()->ordinalPosition;
+	}
+	
+	/**
+		Resolve a reference made by IslandReference to the island which now owns its voxel, or NULL
+	*/
+	Island *ResolveIslandReference( const OrdinalVoxelStore &store, const Vec2i &reference )
+	{
+		Voxel *v = store.voxelAt( reference );
+		return ( v && v->islandCount > 0 ) ? store.island( v->islandId ) : NULL;
+	}
+
+}
+
+void Terrain::_recordCut( recorded_cut::kind type, const Vec2r &start, const Vec2r &end, real size, real strength, 
+                          TerrainCutType::cut_type cutType, Island *restrictToIsland, Island *cuttingIsland )
+{
+	recorded_cut cut;
+	cut.type = type;
+	cut.time = level()->time().time;
+	cut.start = start;
+	cut.end = end;
+	cut.size = size;
+	cut.strength = strength;
+	cut.cutType = cutType;
+	cut.restrictToIsland = IslandReference( restrictToIsland );
+	cut.cuttingIsland = IslandReference( cuttingIsland );
+
+	//
+	//	Record the pose of each dynamic group the cut might reach, by the world position of a voxel of one of its islands
+	//
+
+	cpBB bounds;
+	if ( type == recorded_cut::TERRAIN )
+	{
+		bounds = cuttingIsland ? cuttingIsland->aabb() : cpBBInvalid;
+	}
+	else
+	{
+		bounds = cpBBNew( std::min( start.x, end.x ), std::min( start.y, end.y ), std::max( start.x, end.x ), std::max( start.y, end.y ));
+		bounds = cpBBNew( bounds.l - size, bounds.b - size, bounds.r + size, bounds.t + size );
+	}
+
+	foreach( DynamicIslandGroup *dg, _dynamicGroups )
+	{
+		if ( !dg->body() || dg->islands().empty() || !cpBBIntersects( dg->aabb(), bounds )) continue;
+
+		recorded_group_pose pose;
+		pose.island = IslandReference( *dg->islands().begin() );
+
+		const Voxel *v = _voxels.voxelAt( pose.island );
+		if ( !v ) continue;
+
+		pose.position = dg->worldPosition( v );
+		pose.angle = cpBodyGetAngle( dg->body() );
+		cut.poses.push_back( pose );
+	}
+
+	_cutRecording->push_back( cut );
+}
+
+unsigned int Terrain::replayCut( const recorded_cut &cut )
+{
+	//
+	//	Put dynamic groups back where physics had moved them when the cut was made
+	//
+
+	foreach( const recorded_group_pose &pose, cut.poses )
+	{
+		Island *island = ResolveIslandReference( _voxels, pose.island );
+		if ( !island || !island->group() || island->group()->fixed() ) continue;
+
+		DynamicIslandGroup *dg = static_cast< DynamicIslandGroup* >( island->group() );
+		const cpVect local = cpvrotate( cpv( dg->centroidRelativePosition( _voxels.voxelAt( pose.island ))), cpvforangle( pose.angle ));
+
+		dg->setPose( pose.position - v2r( local ), pose.angle );
+	}
+
+	Island 
+		*restrictToIsland = ResolveIslandReference( _voxels, cut.restrictToIsland ),
+		*cuttingIsland = ResolveIslandReference( _voxels, cut.cuttingIsland );
+
+	switch( cut.type )
+	{
+		case recorded_cut::LINE:
+			if ( cut.restrictToIsland.x >= 0 && !restrictToIsland ) return 0;
+			return cutLine( cut.start, cut.end, cut.size, cut.strength, cut.cutType, restrictToIsland );
+
+		case recorded_cut::DISK:
+			if ( cut.restrictToIsland.x >= 0 && !restrictToIsland ) return 0;
+			if ( !restrictToIsland )
+			{
+				// an unrestricted disk, from a cutBatch
+				return cutBatch( std::vector< cut_primitive >( 1, cut_primitive::disk( cut.start, cut.size, cut.strength )), cut.cutType );
+			}
+
+			return cutDisk( cut.start, cut.size, cut.strength, cut.cutType, restrictToIsland );
+
+		case recorded_cut::TERRAIN:
+			if ( !cuttingIsland || ( cut.restrictToIsland.x >= 0 && !restrictToIsland )) return 0;
+			return cutTerrain( cuttingIsland, cut.strength, cut.cutType, restrictToIsland );
+	}
+	
+	return 0;
 }
 
 #pragma mark - Partitioning
@@ -616,7 +1420,7 @@ namespace {
 
 		inline bool operator()( Voxel *v ) const
 		{
-			return v && ShouldGatherVoxel(v) && v->partOfIsland(_island);
+			return v && ShouldGatherVoxel(v) && _island->owns(v);
 		}
 	};
 
@@ -626,7 +1430,87 @@ namespace {
 		island_membership_tester test(island);
 		floodfill::visit( origin, visitor, test );
 	}
+	
+	//
+	//	Async partitioning, over a PackedVoxelStore snapshot of an island's voxels
+	//
+	
+	struct snapshot_gathering_visitor
+	{
+		const std::vector< int > &_snapshotIndices;
+		std::vector< int > &_component;
+		
+		snapshot_gathering_visitor( const std::vector< int > &snapshotIndices, std::vector< int > &component ):
+			_snapshotIndices( snapshotIndices ),
+			_component( component )
+		{}
+		
+		inline bool operator()( int i )
+		{
+			_component.push_back( _snapshotIndices[i] );
+			return true;
+		}
+	};
+	
+	struct snapshot_membership_tester
+	{
+		const std::vector< uint8_t > &_gather;
+
+		snapshot_membership_tester( const std::vector< uint8_t > &gather ):
+			_gather( gather )
+		{}
+		
+		inline bool operator()( int i ) const
+		{
+			return i >= 0 && _gather[i];
+		}
+	};
+
+}
+
+#pragma mark - Async Partitioning
+
+/**
+	Snapshot of one island's voxel state taken on the main thread, and the result of partitioning it in the background.
+	The snapshot is indexed in the order of the island's voxel list, which is the order _partitionIsland visits voxels in.
+*/
+struct island_partition
+{
+	Island *island;
+
+	// snapshot, per voxel
+	std::vector< Voxel* > voxels;			// identity only; never dereferenced off the main thread
+	std::vector< Vec2i > ordinals;
+	std::vector< uint8_t > occupations;
+	std::vector< uint8_t > connectivity;	// one bit per Compass::Direction with a linked neighbor
+	std::vector< uint8_t > gather;			// ShouldGatherVoxel at snapshot time
+
+	// result, per connected group of voxels; each an array of indices into the snapshot
+	std::vector< std::vector< int > > components;
+	std::vector< boost::shared_ptr< island_perimeter_cache > > perimeterCaches;
+	std::vector< std::vector< triangle > > triangulations;
+	
+	island_partition():
+		island(NULL)
+	{}
+};
+
+/**
+	An async partition in flight. Note, destroying the future returned by std::async blocks until the task completes.
+*/
+struct async_partition
+{
+	std::vector< island_partition > islands;
+	std::future< void > finished;
+};
+
 
+void Terrain::_markVoxelDirty( Voxel *voxel )
+{
+	for ( std::size_t i = 0; i < voxel->islandCount; i++ )
+	{
+		_voxels.islandOf( voxel, i )->_markDirty( voxel->ordinalPosition );
+	}
 }
 
 void Terrain::_markDeferredGeometryUpdateNeeded()
@@ -641,8 +1525,23 @@ void Terrain::_markDeferredGeometryUpdateNeeded()
 	}
 }
 
-void Terrain::_partitionIslands( std::set< Island* > &affectedIslands )
+void Terrain::completeGeometryUpdates()
+{
+	_finishAsyncPartition( true );
+
+	if ( !_dirtyIslands.empty() )
+	{
+		_partitionIslands( _dirtyIslands );
+		_dirtyIslands.clear();
+	}
+
+	_deferredGeometryUpdateTime = -1;
+}
+
+void Terrain::_partitionIslands( std::set< Island* > &affectedIslands, async_partition *partitioned )
 {	
+	Stopwatch timer;
+
 	//
 	//	Record the group dynamics of the affected islands before 
 	//	removing them from their respective groups.
@@ -655,6 +1554,24 @@ void Terrain::_partitionIslands( std::set< Island* > &affectedIslands )
 		moribundIsland->_setGroupDynamics( island_group_dynamics(group));
 	}
 	
+	//
+	//	Record the ordinal extent of the affected islands; once repartitioned, any voxel store
+	//	tiles in this extent which are no longer owned by an island can be freed
+	//
+	
+	Recti affectedBounds;
+	affectedBounds.x1 = affectedBounds.y1 = INT_MAX;
+	affectedBounds.x2 = affectedBounds.y2 = INT_MIN;
+
+	foreach( Island *moribundIsland, affectedIslands )
+	{
+		const Recti bounds = moribundIsland->voxelBoundsOrdinal();
+		affectedBounds.x1 = std::min( affectedBounds.x1, bounds.x1 );
+		affectedBounds.y1 = std::min( affectedBounds.y1, bounds.y1 );
+		affectedBounds.x2 = std::max( affectedBounds.x2, bounds.x2 );
+		affectedBounds.y2 = std::max( affectedBounds.y2, bounds.y2 );
+	}
+
 	//
 	//	Remove the islands which will be cut from the static group, and from the various dynamic groups.
 	//	Delete any dynamic groups which are emptied. 
@@ -690,17 +1607,29 @@ void Terrain::_partitionIslands( std::set< Island* > &affectedIslands )
 	//
 
 	std::set< Island* > newIslands;
-	foreach( Island *island, affectedIslands )
+	if ( partitioned )
+	{
+		//
+		//	Adopt the islands the async partition found; note: _adoptPartition() deletes the partitioned island.
+		//
+		
+		foreach( island_partition &partition, partitioned->islands )
+		{
+			_adoptPartition( partition, newIslands );
+		}
+	}
+	else
 	{
 		//
 		//	Perform the cut, populating newIslands with the newly created islands.
-		//	note: _partitionIsland() deletes the passed in island.
+		//	note: _partitionEach() deletes the passed in islands.
 		//
-		_partitionIsland( island, newIslands );
+
+		_partitionEach( affectedIslands, newIslands );
 	}
 
 	//
-	//	Clear the list of affected islands -- they've been deleted in _partitionIsland()
+	//	Clear the list of affected islands -- they've been deleted in _partitionEach()
 	//
 
 	affectedIslands.clear();
@@ -735,15 +1664,58 @@ void Terrain::_partitionIslands( std::set< Island* > &affectedIslands )
 	
 	_dynamicGroups = remainingDynamicGroups;
 
+	_phaseTimings.partition += timer.mark();
+	_phaseTimings.partitions++;
 	
 	//
-	//	Update groups and 
+	//	Update groups and free voxel store tiles orphaned by the partition
 	//
 	
 	_updateIslandGroups( newIslands );		
+	
+	if ( affectedBounds.x1 <= affectedBounds.x2 )
+	{
+		_voxels.compact( affectedBounds );
+	}
+}
+
+void Terrain::_partitionEach( const std::set< Island* > &islands, std::set< Island* > &newIslands )
+{
+	#if LABEL_COMPONENTS
+	
+		//
+		//	Labeling reads only the snapshot, so label every island at once on the worker pool, 
+		//	then create the new islands on this thread
+		//
+		
+		std::vector< island_partition > partitions( islands.size() );
+		std::size_t index = 0;
+
+		foreach( Island *island, islands )
+		{
+			island_partition &partition = partitions[index++];
+			_snapshotIsland( island, partition );
+			_workerPool->add( boost::bind( &Terrain::_labelSnapshot, &partition, _voxels.scale() ));
+		}
+		
+		_workerPool->wait();
+
+		foreach( const island_partition &partition, partitions )
+		{
+			_partitionIsland( partition.island, newIslands, &partition );
+		}
+
+	#else
+	
+		foreach( Island *island, islands )
+		{
+			_partitionIsland( island, newIslands );
+		}
+
+	#endif
 }
 
-void Terrain::_partitionIsland( Island *moribundIsland, std::set< Island* > &newIslands )
+void Terrain::_partitionIsland( Island *moribundIsland, std::set< Island* > &newIslands, const island_partition *labeled )
 {
 
 	//
@@ -752,45 +1724,65 @@ void Terrain::_partitionIsland( Island *moribundIsland, std::set< Island* > &new
 	//	we perform a flood fill to grab all voxels reachable from this one. That group will be made into
 	//	a new island, who add tenantship of those voxels, and remove tenantship from the moribund island. 
 	//	Then we continue the search for voxels owned by the original parent island.
+	//
+	//	If @a labeled is provided, its components are the groups the flood fills would find, in the same order.
 	//	
 
-	foreach( Voxel *v, moribundIsland->voxels() )
-	{
-		//
-		//	note that creating a new Island changes vertex island tenantship
-		//
+	Island *onlyChild = NULL;
+	int childCount = 0;
+	std::vector< Voxel * > connectedVoxels;
 
-		if ( v->partOfIsland(moribundIsland) && v->hasNeighbors() )
+	if ( labeled )
+	{
+		foreach( const std::vector< int > &component, labeled->components )
 		{
-			std::vector< Voxel * > connectedVoxels;
-			GatherVoxels( moribundIsland, v, connectedVoxels );
+			connectedVoxels.clear();
+			foreach( int i, component )
+			{
+				connectedVoxels.push_back( labeled->voxels[i] );
+			}
 			
-			//
-			//	Remove these voxels from the moribund island
-			//
-
-			foreach( Voxel *cv, connectedVoxels )
+			if ( Island *newIsland = _createPartitionedIsland( moribundIsland, connectedVoxels ))
 			{
-				cv->removeFromIsland(moribundIsland);
+				newIslands.insert( newIsland );
+				onlyChild = newIsland;
+				childCount++;
 			}
-
+		}
+	}
+	else
+	{
+		foreach( Voxel *v, moribundIsland->voxels() )
+		{
 			//
-			//	If we have at least one voxel, create a new Island. The new
-			//	island inherits the island_group_dynamics from the parent Island.
-			//	This is used to transfer coordinate spaces and momentum in
-			//	DynamicIslandGroup::updatePhysics
+			//	note that creating a new Island changes vertex island tenantship
 			//
 
-			if ( connectedVoxels.size() > 1 )
+			if ( moribundIsland->owns(v) && v->hasNeighbors() )
 			{
-				Island *newIsland = new Island( &_voxels, connectedVoxels );
-				newIsland->setBatchDrawDelegate( this );
-				newIsland->_setGroupDynamics( moribundIsland->_groupDynamics() );
-				newIslands.insert( newIsland );
+				connectedVoxels.clear();
+				GatherVoxels( moribundIsland, v, connectedVoxels );
+
+				if ( Island *newIsland = _createPartitionedIsland( moribundIsland, connectedVoxels ))
+				{
+					newIslands.insert( newIsland );
+					onlyChild = newIsland;
+					childCount++;
+				}
 			}
 		}
 	}
 	
+	//
+	//	If the cut didn't split the island, the one new island is the old one minus whatever the cut
+	//	removed, so it can update the old island's perimeters rather than march from scratch
+	//
+	
+	if ( childCount == 1 )
+	{
+		onlyChild->_inheritPerimeters( moribundIsland );
+	}
+	
 	//
 	//	Now, remove the island from its group, and delete it. This will disconnect orphaned voxels.
 	//	Note: at runtime all islands have a group, but during the initial partitioning
@@ -806,5 +1798,296 @@ void Terrain::_partitionIsland( Island *moribundIsland, std::set< Island* > &new
 	delete moribundIsland;
 }
 
+Island *Terrain::_createPartitionedIsland( Island *moribundIsland, const std::vector< Voxel* > &connectedVoxels )
+{
+	//
+	//	Remove these voxels from the moribund island
+	//
+
+	foreach( Voxel *cv, connectedVoxels )
+	{
+		_voxels.removeFromIsland( cv, moribundIsland->membershipId() );
+	}
+
+	//
+	//	If we have at least one voxel, create a new Island. The new
+	//	island inherits the island_group_dynamics from the parent Island.
+	//	This is used to transfer coordinate spaces and momentum in
+	//	DynamicIslandGroup::updatePhysics
+	//
+
+	if ( connectedVoxels.size() > 1 )
+	{
+		Island *newIsland = new Island( &_voxels, connectedVoxels );
+		newIsland->setBatchDrawDelegate( this );
+		newIsland->_setGroupDynamics( moribundIsland->_groupDynamics() );
+		return newIsland;
+	}
+	
+	return NULL;
+}
+
+void Terrain::_beginAsyncPartition( const std::set< Island* > &islands )
+{
+	assert( !_asyncPartition );
+	_asyncPartition.reset( new async_partition() );
+	_asyncPartition->islands.resize( islands.size() );
+	
+	//
+	//	Snapshot just what partitioning reads from each voxel. This is the only per-voxel work 
+	//	the async path does on the main thread before the result is published.
+	//
+
+	std::size_t index = 0;
+	foreach( Island *island, islands )
+	{
+		_snapshotIsland( island, _asyncPartition->islands[index++] );
+	}
+	
+	_asyncPartition->finished = std::async( std::launch::async, &Terrain::_runAsyncPartition, _asyncPartition.get(), &_voxels );
+}
+
+void Terrain::_snapshotIsland( Island *island, island_partition &partition )
+{
+	const std::vector< Voxel* > &voxels = island->voxels();
+	const std::size_t count = voxels.size();
+	
+	partition.island = island;
+	partition.voxels = voxels;
+	partition.ordinals.resize( count );
+	partition.occupations.resize( count );
+	partition.connectivity.resize( count );
+	partition.gather.resize( count );
+	
+	for ( std::size_t i = 0; i < count; i++ )
+	{
+		Voxel *v = voxels[i];
+		uint8_t mask = 0;
+		for ( int dir = 0; dir < 8; dir++ )
+		{
+			if ( v->neighbors[dir] ) mask |= uint8_t(1 << dir);
+		}
+	
+		partition.ordinals[i] = v->ordinalPosition;
+		partition.occupations[i] = uint8_t( std::max( std::min( v->occupation, 255 ), 0 ));
+		partition.connectivity[i] = mask;
+		partition.gather[i] = ShouldGatherVoxel( v ) ? 1 : 0;
+	}
+}
+
+bool Terrain::_finishAsyncPartition( bool wait )
+{
+	if ( !_asyncPartition ) return true;
+	
+	if ( !wait && _asyncPartition->finished.wait_for( std::chrono::seconds(0) ) != std::future_status::ready )
+	{
+		return false;
+	}
+	
+	_asyncPartition->finished.wait();
+
+	boost::shared_ptr< async_partition > partition;
+	partition.swap( _asyncPartition );
+	
+	std::set< Island* > islands;
+	bool recut = false;
+	foreach( const island_partition &ip, partition->islands )
+	{
+		islands.insert( ip.island );
+		recut = recut || _dirtyIslands.count( ip.island );
+	}
+	
+	if ( recut )
+	{
+		//
+		//	Cuts since the snapshot changed voxels the partition read. Rather than start over, and possibly
+		//	never catch up with a sustained cut, partition everything pending now.
+		//
+
+		_dirtyIslands.insert( islands.begin(), islands.end() );
+		_partitionIslands( _dirtyIslands );
+		_dirtyIslands.clear();
+		_deferredGeometryUpdateTime = -1;
+	}
+	else
+	{
+		_partitionIslands( islands, partition.get() );
+	}
+	
+	return true;
+}
+
+void Terrain::_runAsyncPartition( async_partition *partition, const OrdinalVoxelStore *store )
+{
+	foreach( island_partition &ip, partition->islands )
+	{
+		_partitionSnapshot( ip, store );
+	}
+}
+
+void Terrain::_labelSnapshot( island_partition *partition, real scale )
+{
+	const std::size_t count = partition->voxels.size();
+	if ( !count ) return;
+	
+	//
+	//	Lay the snapshot out in a PackedVoxelStore over the island's bounds
+	//
+
+	Vec2i min( INT_MAX, INT_MAX ), max( INT_MIN, INT_MIN );
+	foreach( const Vec2i &o, partition->ordinals )
+	{
+		min.x = std::min( min.x, o.x );
+		min.y = std::min( min.y, o.y );
+		max.x = std::max( max.x, o.x );
+		max.y = std::max( max.y, o.y );
+	}
+	
+	PackedVoxelStore packed;
+	packed.set( max.x - min.x + 1, max.y - min.y + 1, scale );
+
+	std::vector< int > snapshotIndices( packed.count(), -1 );
+	std::vector< uint8_t > gather( packed.count(), 0 );
+	
+	for ( std::size_t i = 0; i < count; i++ )
+	{
+		const Vec2i local = partition->ordinals[i] - min;
+		const int pi = packed.index( local );
+		
+		//
+		//	links to neighbors outside the island's bounds lead to voxels the fill can't gather anyway
+		//
+
+		uint8_t mask = partition->connectivity[i];
+		for ( int dir = 0; dir < 8; dir++ )
+		{
+			const Vec2i n = local + Compass::dir(dir);
+			if ( !packed.contains( n.x, n.y )) mask &= uint8_t(~(1 << dir));
+		}
+	
+		packed.setConnectivity( pi, mask );
+		snapshotIndices[pi] = int(i);
+		gather[pi] = partition->gather[i];
+	}
+
+	snapshot_membership_tester test( gather );
+	
+	#if LABEL_COMPONENTS
+
+		//
+		//	Label in one sweep, then collect each component's voxels in snapshot order. Ordering components
+		//	by their first voxel in the snapshot matches the order the flood fill walk below finds them in.
+		//
+
+		std::vector< int > labels;
+		const int components = labeling::label( packed, test, labels );
+		std::vector< int > componentIndices( components, -1 );
+
+		for ( std::size_t i = 0; i < count; i++ )
+		{
+			const int label = labels[ packed.index( partition->ordinals[i] - min ) ];
+			if ( label < 0 ) continue;
+
+			if ( componentIndices[label] < 0 )
+			{
+				componentIndices[label] = int(partition->components.size());
+				partition->components.push_back( std::vector< int >() );
+			}
+
+			partition->components[ componentIndices[label] ].push_back( int(i) );
+		}
+
+	#else
+
+		//
+		//	Same walk as _partitionIsland: each voxel which has neighbors and hasn't been 
+		//	claimed by a previous fill seeds a fill, which claims what it reaches
+		//
+
+		std::vector< uint8_t > visited( packed.count(), 0 );
+
+		for ( std::size_t i = 0; i < count; i++ )
+		{
+			const int pi = packed.index( partition->ordinals[i] - min );
+			if ( visited[pi] || !partition->connectivity[i] ) continue;
+		
+			partition->components.push_back( std::vector< int >() );
+			snapshot_gathering_visitor visitor( snapshotIndices, partition->components.back() );
+			floodfill::visit( packed, pi, visitor, test, visited );
+			
+			if ( partition->components.back().empty() ) partition->components.pop_back();
+		}
+
+	#endif
+}
+
+void Terrain::_partitionSnapshot( island_partition &partition, const OrdinalVoxelStore *store )
+{
+	_labelSnapshot( &partition, store->scale() );
+
+	//
+	//	March and triangulate, at zero offset, each component which will become an Island
+	//
+
+	const std::size_t components = partition.components.size();
+	partition.perimeterCaches.resize( components );
+	partition.triangulations.resize( components );
+	
+	std::vector< Vec2i > ordinals;
+	std::vector< uint8_t > occupations;
+	std::vector< Vec2rVec > perimeters;
+
+	for ( std::size_t c = 0; c < components; c++ )
+	{
+		const std::vector< int > &component = partition.components[c];
+		if ( component.size() < 2 ) continue;
+		
+		ordinals.clear();
+		occupations.clear();
+		foreach( int i, component )
+		{
+			ordinals.push_back( partition.ordinals[i] );
+			occupations.push_back( partition.occupations[i] );
+		}
+		
+		if ( Island::_createDetachedPerimeters( ordinals, occupations, store->scale(), partition.perimeterCaches[c], perimeters ))
+		{
+			Island::_triangulatePerimeters( *store, perimeters, Vec2r(0,0), partition.triangulations[c] );
+		}
+	}
+}
+
+void Terrain::_adoptPartition( island_partition &partition, std::set< Island* > &newIslands )
+{
+	//
+	//	Mirrors _partitionIsland, using the voxel groupings and geometry found by _partitionSnapshot
+	//
+
+	Island *moribundIsland = partition.island;
+	std::vector< Voxel* > connectedVoxels;
+
+	for ( std::size_t c = 0, N = partition.components.size(); c < N; c++ )
+	{
+		connectedVoxels.clear();
+		foreach( int i, partition.components[c] )
+		{
+			connectedVoxels.push_back( partition.voxels[i] );
+		}
+		
+		if ( Island *newIsland = _createPartitionedIsland( moribundIsland, connectedVoxels ))
+		{
+			newIsland->_adoptGeometry( partition.perimeterCaches[c], partition.triangulations[c] );
+			newIslands.insert( newIsland );
+		}
+	}
+
+	if ( moribundIsland->group() )
+	{
+		moribundIsland->group()->removeIsland( moribundIsland );	
+	}
+	
+	moribundIsland->releaseVoxels();
+	delete moribundIsland;
+}
 
-}} // end namespace game::terrain
\ No newline at end of file
+}} // end namespace game::terrain
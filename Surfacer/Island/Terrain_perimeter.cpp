@@ -9,9 +9,15 @@
 
 #include "Terrain.h"
 #include "MarchingSquares.h"
+#include "CookedTerrain.h"
 #include "ShapeOptimization.h"
 
 #include <cinder/app/AppBasic.h>
+#include <climits>
+
+// when 1, islands are gathered into a contiguous byte grid and marched a row at a time;
+// when 0, marching samples the voxel store cell by cell through IslandVoxelSpaceAdapter
+#define MARCH_ISLAND_GRID 1
 
 namespace ms = marching_squares; 
 
@@ -72,7 +78,7 @@ namespace {
 				if ( x >= _min.x && x < _max.x && y >= _min.y && y < _max.y )
 				{
 					Voxel *v = _voxelsByOrdinalPosition.voxelAtUnsafe( x,y );
-					if ( v && v->partOfIsland( _island )) 
+					if ( v && _island->owns( v )) 
 					{
 						return v->volume();
 					}
@@ -82,10 +88,70 @@ namespace {
 			}
 	};
 	
+	/**
+		The isolevel as a compile-time constant for marchGrid(); must match IsoLevel
+	*/
+	typedef ms::isolevel<1,2> GridIsoLevel;
+
+	/**
+		Copy an island's voxel occupation into a contiguous byte grid, for marchGrid(). 
+		Samples are in the same ordinal space, with the same bounds, as IslandVoxelSpaceAdapter;
+		since we fill from the island's own voxel list, no ownership test is needed per sample.
+	*/
+	void GatherIslandGrid( const Island *island, const std::vector< Voxel* > &voxels, ms::byte_grid &grid )
+	{
+		const Recti bounds = island->voxelBoundsOrdinal();
+
+		//
+		//	IslandVoxelSpaceAdapter marches cells from min-1 to max, and samples at x == max 
+		//	and beyond are always zero - so we don't need cells past max-1
+		//
+
+		const Vec2i origin( bounds.x1 - 1, bounds.y1 - 1 );
+		grid.set( origin, bounds.x2 - origin.x + 1, bounds.y2 - origin.y + 1 );
+		
+		foreach( const Voxel *v, voxels )
+		{
+			if ( v->ordinalPosition.x < bounds.x2 && v->ordinalPosition.y < bounds.y2 )
+			{
+				grid( v->ordinalPosition.x - origin.x, v->ordinalPosition.y - origin.y ) = 
+					uint8_t( std::max( std::min( v->occupation, 255 ), 0 ));
+			}
+		}
+	}
+
+	/**
+		GatherIslandGrid for a snapshot of voxel state: samples @a occupations at @a ordinals, which span @a bounds.
+	*/
+	void GatherIslandGrid( const Recti &bounds, const std::vector< Vec2i > &ordinals, const std::vector< uint8_t > &occupations, ms::byte_grid &grid )
+	{
+		const Vec2i origin( bounds.x1 - 1, bounds.y1 - 1 );
+		grid.set( origin, bounds.x2 - origin.x + 1, bounds.y2 - origin.y + 1 );
+		
+		for ( std::size_t i = 0, N = ordinals.size(); i < N; i++ )
+		{
+			const Vec2i &o = ordinals[i];
+			if ( o.x < bounds.x2 && o.y < bounds.y2 )
+			{
+				grid( o.x - origin.x, o.y - origin.y ) = occupations[i];
+			}
+		}
+	}
+
 	// minimum real delta from MC
 	const real V_EPSILON = 1.0 / 256.0;
 	const real V_SCALE = 256.0;
 	
+	inline Vec2i scaleUp( const Vec2r &v )
+	{
+		return Vec2i( lrintf( V_SCALE * v.x ), lrintf( V_SCALE * v.y ) );
+	}
+	
+	inline Vec2r scaleDown( const Vec2i &v )
+	{
+		return Vec2r( real(v.x) / V_SCALE, real(v.y) / V_SCALE );
+	}			
+	
 	struct PerimeterGenerator
 	{
 		public: 
@@ -110,75 +176,68 @@ namespace {
 			
 			inline void operator()( int x, int y, const ms::segment &seg )
 			{
+				add( scaleUp( seg.a ), scaleUp( seg.b ));
+			}
+			
+			/**
+				Add an edge from a marching squares segment which has already been scaled up
+			*/
+			inline void add( const Vec2i &a, const Vec2i &b )
+			{
+				if ( a == b ) return;
+
 				switch( _winding )
 				{
 					case CLOCKWISE:
-					{
-						Edge e( 
-							scaleUp( seg.a ), 
-							scaleUp( seg.b )); 
-
-						if ( e.first != e.second ) _edgesByFirstVertex[e.first] = e;
+						_edgesByFirstVertex[a] = Edge( a, b );
 						break;
-					}
 					
 					case COUNTER_CLOCKWISE:
-					{
-						Edge e( 
-							scaleUp( seg.b ), 
-							scaleUp( seg.a )); 
-
-						if ( e.first != e.second ) _edgesByFirstVertex[e.first] = e;
+						_edgesByFirstVertex[b] = Edge( b, a );
 						break;
-					}
 				}
 			}
 			
 			/*
 				Populate a vector of Vec2rVec with every perimeter computed for the isosurface
 				Exterior perimeters will be in the current winding direction, interior perimeters
-				will be in the opposite winding.
+				will be in the opposite winding. 
+				
+				If any perimeter fails to close on its starting vertex, @a closed is set false.
 			*/
 
-			int generate( std::vector< Vec2rVec > &perimeters, real scale )
+			int generate( std::vector< Vec2rVec > &perimeters, real scale, bool &closed )
 			{	
 				perimeters.clear();
+				closed = true;
 				
 				while( !_edgesByFirstVertex.empty() )
 				{
 					std::map< Vec2i, Edge, Vec2iComparator >::iterator 
-						begin = _edgesByFirstVertex.begin(),
 						end = _edgesByFirstVertex.end(),
-						it = begin;
+						it = _edgesByFirstVertex.begin();
 						
+					const Vec2i first = it->first;
+					Vec2i next = first;
 					int count = _edgesByFirstVertex.size();					
 					perimeters.push_back( Vec2rVec() );
 
 					do 
 					{
 						perimeters.back().push_back( scaleDown(it->first) * scale );
+						next = it->second.second;
 						_edgesByFirstVertex.erase(it);
 
-						it = _edgesByFirstVertex.find(it->second.second);
+						it = _edgesByFirstVertex.find(next);
 						count--;
 					
-					} while( it != begin && it != end && count > 0 );
+					} while( it != end && count > 0 );
+					
+					if ( next != first ) closed = false;
 				}
 				
 				return perimeters.size();
 			}
-			
-		private:
-		
-			inline Vec2i scaleUp( const Vec2r &v ) const
-			{
-				return Vec2i( lrintf( V_SCALE * v.x ), lrintf( V_SCALE * v.y ) );
-			}
-			
-			inline Vec2r scaleDown( const Vec2i &v ) const
-			{
-				return Vec2r( real(v.x) / V_SCALE, real(v.y) / V_SCALE );
-			}			
 	};
 	
 	struct collapsed_point_catcher
@@ -200,53 +259,40 @@ namespace {
 		}
 	};
 	
-	bool generate( IslandVoxelSpaceAdapter &voxels, 
+	/**
+		Simplify linked @a perimeters into @a optimizedPerimeters.
+		Returns true if any usable perimeters were produced.
+	*/
+	bool simplify( std::vector< Vec2rVec > &perimeters, 
 		real scale,
 		std::vector< Vec2rVec > &optimizedPerimeters )
 	{
-		//
-		//	March and collect into PerimeterGenerator
-		//
-
-		PerimeterGenerator pgen( PerimeterGenerator::CLOCKWISE );
-		ms::march( voxels, pgen, IsoLevel );
-		
 		// make optimization threshold track the scale of the terrain
 		const real LinearDistanceOptimizationThreshold = PerimeterOptimizationLinearDistanceThreshold * scale;
 		
-		//
-		//	Now, generate our perimeter polylines -- note that since our shapes are
-		//	guaranteed closed, and since a map using Vec2iComparator will consider the 
-		//	first entry to be lowest ordinally, it will represent the outer perimeter
-		//
-
-		std::vector< Vec2rVec > perimeters;
-		if ( pgen.generate( perimeters, scale ) )
+		foreach( Vec2rVec &perimeter, perimeters )
 		{
-			foreach( Vec2rVec &perimeter, perimeters )
+			if ( !perimeter.empty())
 			{
-				if ( !perimeter.empty())
+				if ( LinearDistanceOptimizationThreshold > 0 )
 				{
-					if ( LinearDistanceOptimizationThreshold > 0 )
-					{
-						optimizedPerimeters.push_back( Vec2rVec() );
-						util::shape_optimization::rdpSimplify( 
-							perimeter, 
-							optimizedPerimeters.back(), 
-							LinearDistanceOptimizationThreshold );
-							
-						// now filter out any runs of identical points
-						optimizedPerimeters.back().erase( 
-							std::remove_if( 
-								optimizedPerimeters.back().begin(), 
-								optimizedPerimeters.back().end(), 
-								collapsed_point_catcher()), 
-							optimizedPerimeters.back().end());
-					}
-					else
-					{
-						optimizedPerimeters.push_back( perimeter );
-					}
+					optimizedPerimeters.push_back( Vec2rVec() );
+					util::shape_optimization::rdpSimplify( 
+						perimeter, 
+						optimizedPerimeters.back(), 
+						LinearDistanceOptimizationThreshold );
+						
+					// now filter out any runs of identical points
+					optimizedPerimeters.back().erase( 
+						std::remove_if( 
+							optimizedPerimeters.back().begin(), 
+							optimizedPerimeters.back().end(), 
+							collapsed_point_catcher()), 
+						optimizedPerimeters.back().end());
+				}
+				else
+				{
+					optimizedPerimeters.push_back( perimeter );
 				}
 			}
 		}
@@ -257,8 +303,275 @@ namespace {
 
 		return !optimizedPerimeters.empty() && !optimizedPerimeters.front().empty();
 	}
+	
+	/**
+		A marching squares segment's start vertex, scaled up, and the ids of the cell edges it runs between, 
+		tagged with the index of the grid cell which produced it
+	*/
+	struct cell_edge
+	{
+		int cell, fromEdge, toEdge;
+		Vec2i a;
+		
+		cell_edge( int c, int from, int to, const Vec2i &A ):
+			cell(c),
+			fromEdge(from),
+			toEdge(to),
+			a(A)
+		{}
+	};
+	
+	struct cell_edge_collector
+	{
+		std::vector< cell_edge > &_edges;
+		Vec2i _origin;
+		int _stride;
+	
+		cell_edge_collector( std::vector< cell_edge > &edges, const ms::byte_grid &grid ):
+			_edges( edges ),
+			_origin( grid.origin() ),
+			_stride( grid.width() )
+		{}
+		
+		inline void operator()( int x, int y, const ms::segment &seg )
+		{
+			_edges.push_back( cell_edge( (y - _origin.y) * _stride + (x - _origin.x), seg.edgeA, seg.edgeB, scaleUp( seg.a )));
+		}
+	};
+	
+	struct cell_in_rect
+	{
+		int _stride;
+		Vec2i _min, _max;
+		
+		cell_in_rect( int stride, const Vec2i &min, const Vec2i &max ):
+			_stride(stride),
+			_min(min),
+			_max(max)
+		{}
+		
+		inline bool operator()( const cell_edge &e ) const
+		{
+			const int x = e.cell % _stride, y = e.cell / _stride;
+			return x >= _min.x && x < _max.x && y >= _min.y && y < _max.y;
+		}
+	};
+	
+	/**
+		Link @a edges into perimeters by cell edge id, and simplify them into @a optimizedPerimeters. 
+		Returns true if any usable perimeters were produced. @a closed is set false if any perimeter failed to close.
+	*/
+	bool generate( const std::vector< cell_edge > &edges, 
+		real scale, 
+		std::vector< Vec2rVec > &optimizedPerimeters, 
+		bool &closed )
+	{
+		ms::edge_linker linker;
+		linker.reserve( edges.size() );
+
+		foreach( const cell_edge &e, edges )
+		{
+			linker.add( e.fromEdge, e.toEdge, e.a );
+		}
+		
+		//
+		//	loops come back ordered by their lowest vertex, so the first represents the outer perimeter
+		//
+
+		std::vector< std::vector< Vec2i > > loops;
+		closed = linker.link( loops );
+		
+		std::vector< Vec2rVec > perimeters( loops.size() );
+		for ( std::size_t i = 0, N = loops.size(); i < N; i++ )
+		{
+			perimeters[i].reserve( loops[i].size() );
+			foreach( const Vec2i &v, loops[i] )
+			{
+				perimeters[i].push_back( scaleDown(v) * scale );
+			}
+		}
+		
+		return simplify( perimeters, scale, optimizedPerimeters );
+	}
 }
 
+#pragma mark -
+#pragma mark island_perimeter_cache
+
+/**
+	The marching squares state of an Island's last perimeter generation: the byte grid that was marched,
+	the raw edges each cell produced, and the resulting optimized perimeters. Lets an Island which was only 
+	modified in a small region re-march just that region.
+*/
+struct island_perimeter_cache
+{
+	ms::byte_grid grid;
+	Recti bounds;
+	std::vector< cell_edge > edges;
+	std::vector< Vec2rVec > perimeters;
+	bool valid;
+	
+	island_perimeter_cache():
+		valid(false)
+	{}
+};
+
+namespace {
+
+	/**
+		March all of @a cache's grid, replacing its edges and perimeters. Returns true if the perimeters are usable.
+	*/
+	bool MarchIslandGrid( island_perimeter_cache &cache, real scale, std::vector< Vec2rVec > &perimeters )
+	{
+		cache.edges.clear();
+
+		cell_edge_collector collector( cache.edges, cache.grid );
+		ms::marchGrid< GridIsoLevel >( cache.grid, collector );
+
+		bool closed = false;
+		const bool usable = generate( cache.edges, scale, perimeters, closed );
+		cache.perimeters = perimeters;
+		
+		return usable;
+	}
+
+}
+
+#pragma mark -
+#pragma mark Island
+
+void Island::_clearDirty()
+{
+	_dirtyRectOrdinal.x1 = _dirtyRectOrdinal.y1 = INT_MAX;
+	_dirtyRectOrdinal.x2 = _dirtyRectOrdinal.y2 = INT_MIN;
+}
+
+void Island::_inheritPerimeters( Island *parent )
+{
+	_perimeterCache = parent->_perimeterCache;
+	parent->_perimeterCache.reset();
+
+	if ( parent->_dirty() )
+	{
+		_markDirty( Vec2i( parent->_dirtyRectOrdinal.x1, parent->_dirtyRectOrdinal.y1 ));
+		_markDirty( Vec2i( parent->_dirtyRectOrdinal.x2, parent->_dirtyRectOrdinal.y2 ));
+	}
+}
+
+bool Island::_createDetachedPerimeters( 
+	const std::vector< Vec2i > &ordinals, 
+	const std::vector< uint8_t > &occupations, 
+	real scale, 
+	boost::shared_ptr< island_perimeter_cache > &cachePtr,
+	std::vector< Vec2rVec > &perimeters )
+{
+	perimeters.clear();
+	cachePtr.reset( new island_perimeter_cache() );
+	if ( ordinals.empty() ) return false;
+	
+	Recti bounds;
+	bounds.x1 = bounds.y1 = INT_MAX;
+	bounds.x2 = bounds.y2 = INT_MIN;
+	
+	foreach( const Vec2i &o, ordinals )
+	{
+		bounds.x1 = std::min( bounds.x1, o.x );
+		bounds.y1 = std::min( bounds.y1, o.y );
+		bounds.x2 = std::max( bounds.x2, o.x );
+		bounds.y2 = std::max( bounds.y2, o.y );
+	}
+
+	island_perimeter_cache &cache = *cachePtr;
+	cache.valid = true;
+	cache.bounds = bounds;
+	GatherIslandGrid( bounds, ordinals, occupations, cache.grid );
+
+	return MarchIslandGrid( cache, scale, perimeters );
+}
+
+void Island::_adoptGeometry( const boost::shared_ptr< island_perimeter_cache > &cache, std::vector< triangle > &untranslatedTriangulation )
+{
+	_perimeterCache = cache;
+	_untranslatedTriangulation.swap( untranslatedTriangulation );
+	_hasUntranslatedTriangulation = true;
+	_clearDirty();
+}
+
+void Island::_adoptGreebling( std::vector< perimeter_greeble_vertex > &untranslatedGreebleVertices )
+{
+	_untranslatedGreebleVertices.swap( untranslatedGreebleVertices );
+	_greeblingLevel = 0;
+	_hasUntranslatedGreebling = true;
+}
+
+void Island::_writePerimeterCache( cooked::Writer &writer, const boost::shared_ptr< island_perimeter_cache > &cache )
+{
+	const uint8_t valid = cache && cache->valid ? 1 : 0;
+	writer.write( valid );
+	if ( !valid ) return;
+
+	const ms::byte_grid &grid = cache->grid;
+	writer.write( cache->bounds );
+	writer.write( grid.origin() );
+	writer.write( int32_t( grid.width() ));
+	writer.write( int32_t( grid.height() ));
+
+	// row padding isn't written, it's zeroed by byte_grid::set
+	for ( int y = 0; y < grid.height(); y++ )
+	{
+		writer.writeArray( grid.row(y), grid.width() );
+	}
+
+	writer.write( cache->edges );
+	
+	writer.write( uint32_t( cache->perimeters.size() ));
+	foreach( const Vec2rVec &perimeter, cache->perimeters )
+	{
+		writer.write( perimeter );
+	}
+}
+
+bool Island::_readPerimeterCache( cooked::Reader &reader, boost::shared_ptr< island_perimeter_cache > &cachePtr )
+{
+	cachePtr.reset();
+
+	uint8_t valid = 0;
+	if ( !reader.read( valid )) return false;
+	if ( !valid ) return true;
+
+	cachePtr.reset( new island_perimeter_cache() );
+	island_perimeter_cache &cache = *cachePtr;
+	
+	Vec2i origin;
+	int32_t width = 0, height = 0;
+	if ( !reader.read( cache.bounds ) || !reader.read( origin ) || 
+	     !reader.read( width ) || !reader.read( height ) ||
+	     width < 0 || height < 0 )
+	{
+		return false;
+	}
+	
+	cache.grid.set( origin, width, height );
+	for ( int y = 0; y < height; y++ )
+	{
+		const uint8_t *row = reader.readArray< uint8_t >( width );
+		if ( !row ) return false;
+		
+		std::copy( row, row + width, cache.grid.row(y) );
+	}
+
+	uint32_t perimeterCount = 0;
+	if ( !reader.read( cache.edges ) || !reader.read( perimeterCount )) return false;
+
+	cache.perimeters.resize( perimeterCount );
+	foreach( Vec2rVec &perimeter, cache.perimeters )
+	{
+		if ( !reader.read( perimeter )) return false;
+	}
+
+	cache.valid = true;
+	return true;
+}
 
 bool Island::_createVoxelPerimeters()
 {
@@ -267,17 +580,111 @@ bool Island::_createVoxelPerimeters()
 	//
 
 	_voxelPerimeters.clear();
+	
+	const real scale = _store->scale();
 
-	//
-	//	Create the voxel store
-	//
+	#if MARCH_ISLAND_GRID
+	
+		if ( !_perimeterCache ) 
+		{
+			_perimeterCache.reset( new island_perimeter_cache() );
+		}
+		
+		island_perimeter_cache &cache = *_perimeterCache;
+		const Recti bounds = voxelBoundsOrdinal();
 
-	IslandVoxelSpaceAdapter voxels( this, *_store, _voxels );
+		//
+		//	If we have marching state for this island's current bounds, we can update just the region around
+		//	modified voxels. Note, if bounds changed the samples at the max edges shift ( see GatherIslandGrid ), so we can't.
+		//
+
+		if ( cache.valid && 
+		     cache.bounds.x1 == bounds.x1 && cache.bounds.y1 == bounds.y1 && 
+			 cache.bounds.x2 == bounds.x2 && cache.bounds.y2 == bounds.y2 )
+		{
+			if ( !_dirty() )
+			{
+				_voxelPerimeters = cache.perimeters;
+				_usable = !_voxelPerimeters.empty() && !_voxelPerimeters.front().empty();
+				return _usable;
+			}
+		
+			//
+			//	Modified voxels can orphan their neighbors, so outset by one. Then re-gather samples
+			//	in the dirty region, in grid-local coordinates, with the same max-edge rule as GatherIslandGrid.
+			//
+
+			const Vec2i origin = cache.grid.origin();
+			const Vec2i 
+				sampleMin( std::max( _dirtyRectOrdinal.x1 - 1 - origin.x, 0 ), std::max( _dirtyRectOrdinal.y1 - 1 - origin.y, 0 )),
+				sampleMax( std::min( _dirtyRectOrdinal.x2 + 1 - origin.x, cache.grid.width() - 1 ), std::min( _dirtyRectOrdinal.y2 + 1 - origin.y, cache.grid.height() - 1 ));
+
+			for ( int y = sampleMin.y; y <= sampleMax.y; y++ )
+			{
+				for ( int x = sampleMin.x; x <= sampleMax.x; x++ )
+				{
+					const int ox = origin.x + x, oy = origin.y + y;
+					Voxel *v = (ox < bounds.x2 && oy < bounds.y2) ? _store->voxelAt( ox, oy ) : NULL;
+					
+					cache.grid(x,y) = ( v && owns( v )) ? 
+						uint8_t( std::max( std::min( v->occupation, 255 ), 0 )) : 
+						uint8_t(0);
+				}
+			}
+
+			//
+			//	Every cell touching a re-gathered sample is re-marched, replacing its old edges
+			//
+
+			const Vec2i cellMin( sampleMin.x - 1, sampleMin.y - 1 ), cellMax( sampleMax.x + 1, sampleMax.y + 1 );
+			cache.edges.erase( 
+				std::remove_if( cache.edges.begin(), cache.edges.end(), cell_in_rect( cache.grid.width(), cellMin, cellMax )),
+				cache.edges.end() );
+
+			cell_edge_collector collector( cache.edges, cache.grid );
+			ms::marchGrid< GridIsoLevel >( cache.grid, cellMin, cellMax, collector );
+
+			bool closed = false;
+			_usable = generate( cache.edges, scale, _voxelPerimeters, closed );
+
+			if ( closed )
+			{
+				cache.perimeters = _voxelPerimeters;
+				_clearDirty();
+				return _usable;
+			}
+			
+			//
+			//	If a perimeter didn't close, the modification reached outside the dirty region; start over
+			//
+
+			_voxelPerimeters.clear();
+		}
+		
+		//
+		//	March the whole island
+		//
+		
+		cache.valid = true;
+		cache.bounds = bounds;
+		GatherIslandGrid( this, _voxels, cache.grid );
+		_usable = MarchIslandGrid( cache, scale, _voxelPerimeters );
+
+	#else
 	
+		IslandVoxelSpaceAdapter adapter( this, *_store, _voxels );
+		PerimeterGenerator pgen( PerimeterGenerator::CLOCKWISE );
+		ms::march( adapter, pgen, IsoLevel );
+
+		bool closed = false;
+		std::vector< Vec2rVec > perimeters;
+		pgen.generate( perimeters, scale, closed );
+		_usable = simplify( perimeters, scale, _voxelPerimeters );
 	
-	_usable = generate( voxels, _store->scale(), _voxelPerimeters );
+	#endif
 	
+	_clearDirty();
 	return _usable;
 }
 
-}} // end namespace game::terrain
\ No newline at end of file
+}} // end namespace game::terrain
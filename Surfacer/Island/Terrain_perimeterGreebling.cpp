@@ -8,6 +8,7 @@
 
 #include "Terrain.h"
 #include "LineSegment.h"
+#include "Stopwatch.h"
 
 using namespace ci;
 using namespace core;
@@ -78,6 +79,24 @@ namespace {
 	{
 		return Vec2r( v.x, real(1) - v.y );
 	}
+	
+	/**
+		Each density level doubles greeble spacing and size. Zoomed out, the level is raised until
+		a greeble spans at least MinimumGreeblePixels on screen.
+	*/
+	const real MinimumGreeblePixels = 4;
+	const int MaximumGreeblingLevel = 4;
+	
+	inline int greeblingLevel( real greebleSize, real zoom )
+	{
+		int level = 0;
+		for ( real pixels = greebleSize * zoom; pixels < MinimumGreeblePixels && level < MaximumGreeblingLevel; pixels *= 2 )
+		{
+			level++;
+		}
+		
+		return level;
+	}
 
 	void add_greeble_particle( 
 		std::vector< perimeter_greeble_vertex > &vertices, 
@@ -139,12 +158,52 @@ namespace {
 }
 
   
-void Island::_createPerimeterGreebling( Vec2r const *ordinalToCentroidRelativeOffset )
+bool Island::updatePerimeterGreebling( real zoom )
+{
+	const Terrain::init &terrainInit = _group->terrain()->initializer();
+	if ( terrainInit.greebleTextureAtlas.empty() ) return false;
+	
+	const int level = greeblingLevel( terrainInit.greebleSize, zoom );
+	const Vec2r offset = _group->ordinalToCentroidRelativeOffset();
+	
+	if ( level == _greeblingLevel && _greeblingTranslated && offset == _greeblingOffset ) 
+	{
+		return false;
+	}
+
+	Stopwatch timer;
+
+	if ( level != _greeblingLevel )
+	{
+		_createPerimeterGreebling( level );
+	}
+
+	//
+	//	Greebling is made at zero offset, and texture coordinates have the offset removed, so only positions need translating
+	//
+
+	_perimeterGreebleVertices = _untranslatedGreebleVertices;
+	
+	const Vec2f translation( offset.x, offset.y );
+	foreach( perimeter_greeble_vertex &vertex, _perimeterGreebleVertices )
+	{
+		vertex.position += translation;
+	}
+	
+	_greeblingOffset = offset;
+	_greeblingTranslated = true;
+
+	_group->terrain()->addGreeblingTime( timer.mark() );
+
+	return true;
+}
+
+void Island::_createPerimeterGreebling( int level )
 {
 	const real terrainScale = _store->scale();
 
 	const Vec2r 
-		Offset = ordinalToCentroidRelativeOffset ? *ordinalToCentroidRelativeOffset : Vec2r(0,0),
+		Offset( 0, 0 ),
 		TotalOrdinalSizeReciprocal( real(1) / real( _store->width() * terrainScale ), real(1) / real(_store->height() * terrainScale) );
 
 	const real 
@@ -152,13 +211,16 @@ void Island::_createPerimeterGreebling( Vec2r const *ordinalToCentroidRelativeOf
 		ReciprocalTerrainScale = 1 / TerrainScale,
 		VoxelSize = TerrainScale,
 		SegmentEndThreshold = VoxelSize * 0.25,
-		GreebleSize = _group->terrain()->initializer().greebleSize,
+		GreebleSize = _group->terrain()->initializer().greebleSize * real( 1 << level ),
 		GreebleRadius = GreebleSize * 0.5;
 		
 	const bool	
 		isMask = _group->terrain()->initializer().greebleTextureIsMask;
 	
-	_perimeterGreebleVertices.clear();
+	_untranslatedGreebleVertices.clear();
+	_greeblingLevel = level;
+	_greeblingTranslated = false;
+
 	foreach( Vec2rVec &voxelPerimeter, _voxelPerimeters )
 	{
 		if ( voxelPerimeter.size() > 2 )
@@ -182,11 +244,11 @@ void Island::_createPerimeterGreebling( Vec2r const *ordinalToCentroidRelativeOf
 
 					Voxel *v = _store->voxelAt( snappedPoint );
 					
-					if ( v && (v->numIslands == 1 || edgelike(v, this) ))
+					if ( v && (v->islandCount == 1 || edgelike(v, this) ))
 					{
 						Vec2r localPointOnSegment = perimeterPoint + Offset;
 						add_greeble_particle( 
-							_perimeterGreebleVertices, 
+							_untranslatedGreebleVertices, 
 							v, 
 							localPointOnSegment, 
 							GreebleRadius, 
@@ -0,0 +1,677 @@
+//
+//  Terrain_snapshot.cpp
+//  Surfacer
+//
+//  Created by Shamyl Zakariya on 10/17/12.
+//  Copyright 2012 TomorrowPlusX. All rights reserved.
+//
+
+#include "Terrain.h"
+#include "CookedTerrain.h"
+
+#include <algorithm>
+
+#include "Level.h"
+
+using namespace ci;
+using namespace core;
+namespace game { namespace terrain {
+
+namespace {
+
+	enum {
+		OccupationPlane = 0,
+		StrengthPlane,
+		IdPlane,
+		ConnectivityPlane,
+		PlaneCount
+	};
+
+	inline uint8_t ClampToByte( int v )
+	{
+		return uint8_t( std::max( 0, std::min( v, 255 )));
+	}
+
+	inline uint32_t MembershipChecksum( const std::vector< uint8_t > &membership )
+	{
+		return cooked::Checksum( membership.empty() ? NULL : &membership[0], membership.size() );
+	}
+
+	inline void PutVarint( std::vector< uint8_t > &out, std::size_t value )
+	{
+		while( value >= 0x80 )
+		{
+			out.push_back( uint8_t( value | 0x80 ));
+			value >>= 7;
+		}
+
+		out.push_back( uint8_t( value ));
+	}
+
+	/**
+		Reads what PutVarint and the encoders below write, failing rather than reading past the end
+	*/
+	struct byte_reader
+	{
+		const uint8_t *cursor, *end;
+		bool ok;
+
+		byte_reader( const std::vector< uint8_t > &bytes ):
+			cursor( bytes.empty() ? NULL : &bytes[0] ),
+			end( cursor + bytes.size() ),
+			ok( true )
+		{}
+
+		bool varint( std::size_t &value )
+		{
+			value = 0;
+			for ( int shift = 0; ok && shift < 64; shift += 7 )
+			{
+				if ( cursor == end ) break;
+
+				const uint8_t b = *cursor++;
+				value |= std::size_t( b & 0x7F ) << shift;
+				if ( !( b & 0x80 )) return true;
+			}
+
+			ok = false;
+			return false;
+		}
+
+		const uint8_t *bytes( std::size_t count )
+		{
+			if ( !ok || std::size_t( end - cursor ) < count )
+			{
+				ok = false;
+				return NULL;
+			}
+
+			const uint8_t *b = cursor;
+			cursor += count;
+			return b;
+		}
+
+		bool done() const { return ok && cursor == end; }
+	};
+
+	/**
+		Run-length encode the XOR of @a count bytes of @a current against @a pristine, as pairs of varint lengths:
+		a skip run of unchanged bytes, then a literal run of changed bytes, which is followed by its XORed bytes.
+	*/
+	void EncodeDeltaRuns( const uint8_t *current, const uint8_t *pristine, std::size_t count, std::vector< uint8_t > &out )
+	{
+		std::size_t i = 0;
+		while( i < count )
+		{
+			std::size_t skip = 0;
+			while( i + skip < count && current[ i + skip ] == pristine[ i + skip ] ) skip++;
+			i += skip;
+
+			std::size_t literal = 0;
+			while( i + literal < count && current[ i + literal ] != pristine[ i + literal ] ) literal++;
+
+			PutVarint( out, skip );
+			PutVarint( out, literal );
+			for ( std::size_t k = 0; k < literal; k++, i++ )
+			{
+				out.push_back( current[i] ^ pristine[i] );
+			}
+		}
+	}
+
+	bool DecodeDeltaRuns( byte_reader &reader, const uint8_t *pristine, std::size_t count, uint8_t *current )
+	{
+		std::copy( pristine, pristine + count, current );
+
+		std::size_t i = 0, skip = 0, literal = 0;
+		while( i < count )
+		{
+			if ( !reader.varint( skip ) || !reader.varint( literal ) || skip + literal > count - i ) return false;
+			i += skip;
+
+			const uint8_t *deltas = reader.bytes( literal );
+			if ( !deltas ) return false;
+
+			for ( std::size_t k = 0; k < literal; k++, i++ )
+			{
+				current[i] ^= deltas[k];
+			}
+		}
+
+		return true;
+	}
+
+	/**
+		Encode @a island's voxels as runs of consecutive indices ( y * width + x ),
+		each a varint gap from the end of the previous run and a varint length.
+	*/
+	void EncodeMembership( const Island *island, int width, std::vector< std::size_t > &scratch, std::vector< uint8_t > &out )
+	{
+		scratch.clear();
+		foreach( const Voxel *v, island->voxels() )
+		{
+			scratch.push_back( std::size_t( v->ordinalPosition.y ) * width + v->ordinalPosition.x );
+		}
+
+		std::sort( scratch.begin(), scratch.end() );
+
+		std::size_t previousEnd = 0;
+		for ( std::size_t i = 0, N = scratch.size(); i < N; )
+		{
+			std::size_t j = i + 1;
+			while( j < N && scratch[j] == scratch[j-1] + 1 ) j++;
+
+			PutVarint( out, scratch[i] - previousEnd );
+			PutVarint( out, j - i );
+
+			previousEnd = scratch[j-1] + 1;
+			i = j;
+		}
+	}
+
+	bool DecodeMembership( const std::vector< uint8_t > &bytes, std::size_t voxelCount, std::vector< uint32_t > &indices )
+	{
+		byte_reader reader( bytes );
+		std::size_t previousEnd = 0, gap = 0, length = 0;
+
+		while( !reader.done() )
+		{
+			if ( !reader.varint( gap ) || !reader.varint( length ) ||
+			     length == 0 || gap > voxelCount - previousEnd || length > voxelCount - previousEnd - gap )
+			{
+				return false;
+			}
+
+			const std::size_t start = previousEnd + gap;
+			for ( std::size_t k = 0; k < length; k++ )
+			{
+				indices.push_back( uint32_t( start + k ));
+			}
+
+			previousEnd = start + length;
+		}
+
+		return reader.ok;
+	}
+
+	struct snapshot_island
+	{
+		std::size_t group;
+		std::vector< uint32_t > voxels;
+	};
+
+	/**
+		Per-tile voxel planes, as _gatherTilePlanes writes them, addressed by ordinal position.
+		Tiles without planes read as zero.
+	*/
+	struct tile_planes
+	{
+		const std::vector< const uint8_t* > &tiles;
+		const OrdinalVoxelStore &store;
+		std::size_t tileArea;
+
+		tile_planes( const std::vector< const uint8_t* > &t, const OrdinalVoxelStore &s ):
+			tiles( t ),
+			store( s ),
+			tileArea( s.tileSize().x * s.tileSize().y )
+		{}
+
+		uint8_t value( int plane, const Vec2i &p ) const
+		{
+			const uint8_t *planes = tiles[ store.tileIndex( p.x, p.y ) ];
+			return planes ? planes[ plane * tileArea + store.indexInTile( p.x, p.y ) ] : 0;
+		}
+	};
+
+}
+
+#pragma mark -
+#pragma mark Terrain Snapshots
+
+void Terrain::_gatherTilePlanes( std::size_t t, uint8_t *planes ) const
+{
+	const Vec2i tileSize = _voxels.tileSize();
+	const std::size_t tileArea = tileSize.x * tileSize.y;
+	std::fill( planes, planes + tileArea * PlaneCount, 0 );
+
+	const Voxel *tile = _voxels.tile(t);
+	if ( !tile ) return;
+
+	uint8_t
+		*occupation = planes + OccupationPlane * tileArea,
+		*strength = planes + StrengthPlane * tileArea,
+		*id = planes + IdPlane * tileArea,
+		*connectivity = planes + ConnectivityPlane * tileArea;
+
+	for ( std::size_t i = 0; i < tileArea; i++ )
+	{
+		const Voxel *v = tile + i;
+		if ( !_voxels.contains( v->ordinalPosition.x, v->ordinalPosition.y )) continue;
+
+		uint8_t mask = 0;
+		for ( int dir = 0; dir < 8; dir++ )
+		{
+			if ( v->neighbors[dir] ) mask |= 1 << dir;
+		}
+
+		occupation[i] = ClampToByte( v->occupation );
+		strength[i] = ClampToByte( v->strength );
+		id[i] = ClampToByte( v->id );
+		connectivity[i] = mask;
+	}
+}
+
+void Terrain::_gatherGroupStates( std::vector< terrain_snapshot::group_state > &groups, std::map< IslandGroup*, std::size_t > &groupIndices ) const
+{
+	terrain_snapshot::group_state gs;
+
+	gs.fixed = true;
+	groupIndices[ _staticGroup ] = groups.size();
+	groups.push_back( gs );
+
+	foreach( DynamicIslandGroup *dg, _dynamicGroups )
+	{
+		gs.fixed = false;
+		gs.dynamics = island_group_dynamics( dg );
+		groupIndices[ dg ] = groups.size();
+		groups.push_back( gs );
+	}
+}
+
+void Terrain::_capturePristineState()
+{
+	//
+	//	Voxel planes of each allocated tile; snapshots encode tiles against these, and unallocated tiles against zero
+	//
+
+	const Vec2i tileSize = _voxels.tileSize();
+	const std::size_t tileBytes = tileSize.x * tileSize.y * PlaneCount;
+
+	_pristineTiles.assign( _voxels.tileCount(), std::vector< uint8_t >() );
+	for ( std::size_t t = 0, N = _voxels.tileCount(); t < N; t++ )
+	{
+		if ( _voxels.tile(t) )
+		{
+			_pristineTiles[t].resize( tileBytes );
+			_gatherTilePlanes( t, &_pristineTiles[t][0] );
+		}
+	}
+
+	//
+	//	Island memberships and groups; the loaded state is made from these when first asked for
+	//
+
+	_pristineIslands.clear();
+	_pristineIslandsByChecksum.clear();
+	_pristineIslandGroups.clear();
+	_pristineGroups.clear();
+	_loadedState = terrain_snapshot();
+
+	std::map< IslandGroup*, std::size_t > groupIndices;
+	_gatherGroupStates( _pristineGroups, groupIndices );
+
+	std::vector< std::size_t > scratch;
+	foreach( Island *island, _allIslands )
+	{
+		_pristineIslands.push_back( std::vector< uint8_t >() );
+		std::vector< uint8_t > &membership = _pristineIslands.back();
+		EncodeMembership( island, _voxels.width(), scratch, membership );
+
+		_pristineIslandsByChecksum[ MembershipChecksum( membership ) ] = _pristineIslands.size() - 1;
+		_pristineIslandGroups.push_back( groupIndices[ island->group() ] );
+	}
+}
+
+const terrain_snapshot &Terrain::loadedState()
+{
+	//
+	//	The loaded state changes no tile, and refers to every loaded island
+	//
+
+	if ( _loadedState.groups.empty() )
+	{
+		PutVarint( _loadedState.voxels, 0 );
+
+		PutVarint( _loadedState.islands, _pristineIslands.size() );
+		for ( std::size_t i = 0, N = _pristineIslands.size(); i < N; i++ )
+		{
+			PutVarint( _loadedState.islands, _pristineIslandGroups[i] );
+			PutVarint( _loadedState.islands, i + 1 );
+		}
+
+		_loadedState.groups = _pristineGroups;
+	}
+
+	return _loadedState;
+}
+
+void Terrain::snapshot( terrain_snapshot &state )
+{
+	//
+	//	Complete any pending geometry updates, so islands reflect their voxels
+	//
+
+	completeGeometryUpdates();
+
+	state.voxels.clear();
+	state.islands.clear();
+	state.groups.clear();
+
+	//
+	//	Voxel planes of each tile which differs from its loaded planes, as deltas against them. Only tiles
+	//	allocated now or at load are visited; a tile freed since load reads as zero.
+	//
+
+	const Vec2i tileSize = _voxels.tileSize();
+	const std::size_t tileBytes = tileSize.x * tileSize.y * PlaneCount;
+	const std::vector< uint8_t > zeros( tileBytes, 0 );
+
+	std::vector< uint8_t > planes( tileBytes ), tileDeltas;
+	std::size_t changedTiles = 0, previousEnd = 0;
+
+	for ( std::size_t t = 0, N = _voxels.tileCount(); t < N; t++ )
+	{
+		const std::vector< uint8_t > &pristineTile = _pristineTiles[t];
+		if ( !_voxels.tile(t) && pristineTile.empty() ) continue;
+
+		_gatherTilePlanes( t, &planes[0] );
+
+		const uint8_t *pristine = pristineTile.empty() ? &zeros[0] : &pristineTile[0];
+		if ( std::equal( planes.begin(), planes.end(), pristine )) continue;
+
+		PutVarint( tileDeltas, t - previousEnd );
+		EncodeDeltaRuns( &planes[0], pristine, tileBytes, tileDeltas );
+
+		previousEnd = t + 1;
+		changedTiles++;
+	}
+
+	PutVarint( state.voxels, changedTiles );
+	state.voxels.insert( state.voxels.end(), tileDeltas.begin(), tileDeltas.end() );
+
+	//
+	//	Groups, static first
+	//
+
+	std::map< IslandGroup*, std::size_t > groupIndices;
+	_gatherGroupStates( state.groups, groupIndices );
+
+	//
+	//	Islands, referring to identical loaded islands where possible
+	//
+
+	PutVarint( state.islands, _allIslands.size() );
+
+	std::vector< std::size_t > scratch;
+	std::vector< uint8_t > membership;
+
+	foreach( Island *island, _allIslands )
+	{
+		membership.clear();
+		EncodeMembership( island, _voxels.width(), scratch, membership );
+
+		std::size_t pristineIndex = 0;
+		std::map< uint32_t, std::size_t >::const_iterator pristine =
+			_pristineIslandsByChecksum.find( MembershipChecksum( membership ));
+
+		if ( pristine != _pristineIslandsByChecksum.end() && _pristineIslands[ pristine->second ] == membership )
+		{
+			pristineIndex = pristine->second + 1;
+		}
+
+		PutVarint( state.islands, groupIndices[ island->group() ] );
+		PutVarint( state.islands, pristineIndex );
+
+		if ( !pristineIndex )
+		{
+			PutVarint( state.islands, membership.size() );
+			state.islands.insert( state.islands.end(), membership.begin(), membership.end() );
+		}
+	}
+}
+
+bool Terrain::restore( const terrain_snapshot &state )
+{
+	//
+	//	Decode everything before touching the terrain
+	//
+
+	const int width = _voxels.width(), height = _voxels.height();
+	const std::size_t area = std::size_t( width ) * height;
+
+	const Vec2i tileSize = _voxels.tileSize();
+	const std::size_t tileArea = tileSize.x * tileSize.y, tileBytes = tileArea * PlaneCount;
+
+	if ( _pristineTiles.size() != _voxels.tileCount() || state.groups.empty() || !state.groups.front().fixed )
+	{
+		return false;
+	}
+
+	//
+	//	Each tile's planes are its loaded planes, or zero, unless the snapshot changed them
+	//
+
+	std::vector< const uint8_t* > tilePlanes( _pristineTiles.size(), (const uint8_t*) NULL );
+	for ( std::size_t t = 0, N = _pristineTiles.size(); t < N; t++ )
+	{
+		if ( !_pristineTiles[t].empty() ) tilePlanes[t] = &_pristineTiles[t][0];
+	}
+
+	std::vector< std::vector< uint8_t > > changedTiles;
+
+	{
+		byte_reader reader( state.voxels );
+		std::size_t changedCount = 0, gap = 0, previousEnd = 0;
+		if ( !reader.varint( changedCount ) || changedCount > tilePlanes.size() ) return false;
+
+		const std::vector< uint8_t > zeros( tileBytes, 0 );
+		changedTiles.reserve( changedCount );
+
+		for ( std::size_t k = 0; k < changedCount; k++ )
+		{
+			if ( !reader.varint( gap ) || gap >= tilePlanes.size() - previousEnd ) return false;
+			const std::size_t t = previousEnd + gap;
+
+			changedTiles.push_back( std::vector< uint8_t >( tileBytes ));
+			if ( !DecodeDeltaRuns( reader, tilePlanes[t] ? tilePlanes[t] : &zeros[0], tileBytes, &changedTiles.back()[0] )) return false;
+
+			tilePlanes[t] = &changedTiles.back()[0];
+			previousEnd = t + 1;
+		}
+
+		if ( !reader.done() ) return false;
+	}
+
+	const tile_planes planes( tilePlanes, _voxels );
+
+	std::vector< snapshot_island > islands;
+
+	{
+		byte_reader reader( state.islands );
+		std::size_t islandCount = 0;
+		if ( !reader.varint( islandCount ) || islandCount > area ) return false;
+
+		islands.resize( islandCount );
+		std::vector< uint8_t > membership;
+
+		foreach( snapshot_island &island, islands )
+		{
+			std::size_t pristineIndex = 0, length = 0;
+			if ( !reader.varint( island.group ) || !reader.varint( pristineIndex ) || island.group >= state.groups.size() ) return false;
+
+			if ( pristineIndex )
+			{
+				if ( pristineIndex > _pristineIslands.size() ) return false;
+				if ( !DecodeMembership( _pristineIslands[ pristineIndex - 1 ], area, island.voxels )) return false;
+			}
+			else
+			{
+				const uint8_t *bytes = reader.varint( length ) ? reader.bytes( length ) : NULL;
+				if ( !bytes ) return false;
+
+				membership.assign( bytes, bytes + length );
+				if ( !DecodeMembership( membership, area, island.voxels )) return false;
+			}
+		}
+
+		if ( !reader.done() ) return false;
+	}
+
+	//
+	//	Complete anything in flight, then tear down all islands and groups. Voxel
+	//	island membership is rewritten below, so islands needn't release their voxels.
+	//
+
+	_finishAsyncPartition( true );
+	_dirtyIslands.clear();
+	_deferredGeometryUpdateTime = -1;
+	_touchedScaledWorldPositionsByCut.clear();
+
+	_gatherAllIslands();
+	const std::set< Island* > moribundIslands( _allIslands.begin(), _allIslands.end() );
+
+	_staticGroup->removeIslands( moribundIslands );
+	foreach( DynamicIslandGroup *dg, _dynamicGroups )
+	{
+		dg->removeIslands( moribundIslands );
+		removeChild( dg );
+		delete dg;
+	}
+
+	_dynamicGroups.clear();
+
+	foreach( Island *island, moribundIslands )
+	{
+		delete island;
+	}
+
+	_allIslands.clear();
+	_voxels.clearIslandMembership();
+
+	//
+	//	Allocate the tiles holding any voxel which is occupied, linked or owned. All of them are allocated before any
+	//	voxel is written, since allocating a tile links its edge voxels into adjacent tiles.
+	//
+
+	std::vector< uint8_t > tileNeeded( tilePlanes.size(), 0 );
+
+	for ( std::size_t t = 0, N = tilePlanes.size(); t < N; t++ )
+	{
+		const uint8_t *tp = tilePlanes[t];
+		if ( !tp ) continue;
+
+		for ( std::size_t i = 0; i < tileArea && !tileNeeded[t]; i++ )
+		{
+			if ( tp[ OccupationPlane * tileArea + i ] || tp[ ConnectivityPlane * tileArea + i ] ) tileNeeded[t] = 1;
+		}
+	}
+
+	foreach( const snapshot_island &island, islands )
+	{
+		foreach( uint32_t i, island.voxels )
+		{
+			const int x = i % width, y = i / width;
+			tileNeeded[ _voxels.tileIndex( x, y ) ] = 1;
+		}
+	}
+
+	for ( std::size_t t = 0, N = tileNeeded.size(); t < N; t++ )
+	{
+		if ( tileNeeded[t] ) _voxels.allocateTile( t );
+	}
+
+	//
+	//	Now write every allocated voxel. A link is made only where the masks of both ends record it, and is written
+	//	to both ends, so no voxel is left pointing at a neighbor which doesn't point back.
+	//
+
+	for ( std::size_t t = 0, N = tileNeeded.size(); t < N; t++ )
+	{
+		Voxel *tile = _voxels.tile(t);
+		if ( !tile ) continue;
+
+		for ( Voxel *v = tile, *end = tile + tileArea; v != end; ++v )
+		{
+			if ( !_voxels.contains( v->ordinalPosition.x, v->ordinalPosition.y )) continue;
+
+			const uint8_t mask = planes.value( ConnectivityPlane, v->ordinalPosition );
+
+			v->occupation = planes.value( OccupationPlane, v->ordinalPosition );
+			v->strength = planes.value( StrengthPlane, v->ordinalPosition );
+			v->id = planes.value( IdPlane, v->ordinalPosition );
+
+			for ( int dir = 0; dir < 8; dir++ )
+			{
+				const int opposite = ( dir + 4 ) % 8;
+				Voxel *n = _voxels.voxelAt( v->ordinalPosition + Compass::dir( dir ));
+
+				const bool linked = n && ( mask & ( 1 << dir )) && 
+					( planes.value( ConnectivityPlane, n->ordinalPosition ) & ( 1 << opposite ));
+
+				v->neighbors[dir] = linked ? n : NULL;
+				if ( n ) n->neighbors[opposite] = linked ? v : NULL;
+			}
+		}
+	}
+
+	//
+	//	Recreate islands and groups. Dynamic groups get their captured transform, velocity and ordinal to
+	//	centroid-relative offset, which together place their voxels where they were captured.
+	//
+
+	std::vector< IslandGroup* > groups( state.groups.size(), (IslandGroup*) NULL );
+	groups[0] = _staticGroup;
+
+	for ( std::size_t g = 1, N = state.groups.size(); g < N; g++ )
+	{
+		DynamicIslandGroup *dg = new DynamicIslandGroup( _space, this, state.groups[g].dynamics );
+		_dynamicGroups.insert( dg );
+		addChild( dg );
+		groups[g] = dg;
+	}
+
+	std::vector< Voxel* > voxels;
+	foreach( const snapshot_island &si, islands )
+	{
+		voxels.clear();
+		voxels.reserve( si.voxels.size() );
+
+		foreach( uint32_t i, si.voxels )
+		{
+			voxels.push_back( _voxels.voxelAtUnsafe( i % width, i / width ));
+		}
+
+		Island *island = new Island( &_voxels, voxels );
+		island->setBatchDrawDelegate( this );
+		groups[ si.group ]->addIsland( island );
+	}
+
+	//
+	//	Build physics representations, and discard anything which didn't survive
+	//
+
+	_updateGroupPhysics();
+	_staticGroup->prune();
+
+	std::set< DynamicIslandGroup* > remainingDynamicGroups;
+	foreach( DynamicIslandGroup* dg, _dynamicGroups )
+	{
+		if ( dg->prune() )
+		{
+			remainingDynamicGroups.insert( dg );
+		}
+		else
+		{
+			removeChild( dg );
+			delete dg;
+		}
+	}
+
+	_dynamicGroups = remainingDynamicGroups;
+	_gatherAllIslands();
+	_voxels.compact();
+
+	return true;
+}
+
+}} // end namespace game::terrain
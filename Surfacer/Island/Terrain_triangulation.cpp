@@ -8,15 +8,25 @@
 
 #include "Terrain.h"
 #include "TerrainRendering.h"
+#include "ShapeOptimization.h"
+#include "Stopwatch.h"
 
 #include <cinder/app/App.h>
 
 #define TRIANGULATE_POLY_2_TRI 0
 
+//
+//	When set, perimeters are triangulated by util::triangulation, which handles holes, falling back to cinder's
+//	triangulator only if the perimeters are too degenerate for it. Only applies when TRIANGULATE_POLY_2_TRI is off.
+//
+
+#define TRIANGULATE_MONOTONE 1
+
 #if TRIANGULATE_POLY_2_TRI
 	#include <poly2tri.h>
 #else
 	#include <cinder/Triangulate.h>
+	#include "Triangulation.h"
 #endif
 
 using namespace ci;
@@ -24,6 +34,12 @@ using namespace core;
 namespace game { namespace terrain {
 
 namespace {
+
+	/**
+		Collision polygons merged from the triangulation are capped at this many vertices, 
+		so each remains a compact shape for the broadphase
+	*/
+	const std::size_t MaxCollisionPolygonVertices = 8;
   
 	#if TRIANGULATE_POLY_2_TRI
 		inline real Area( const p2t::Point &a, const p2t::Point &b, const p2t::Point &c )
@@ -58,17 +74,72 @@ namespace {
 
 bool Island::triangulate( Vec2r const *ordinalToCentroidRelativeOffset )
 {
-	if ( _createVoxelPerimeters() && _triangulate(ordinalToCentroidRelativeOffset))
+	prepareGeometry( ordinalToCentroidRelativeOffset );
+	return commitGeometry();
+}
+
+void Island::prepareGeometry( Vec2r const *ordinalToCentroidRelativeOffset )
+{
+	_preparationTimings = terrain_phase_timings();
+	_preparationTimings.islandsPrepared = 1;
+	
+	Stopwatch timer;
+
+	bool perimetersCreated = _createVoxelPerimeters();
+	_preparationTimings.perimeters = timer.mark();
+	
+	bool triangulated = perimetersCreated && _triangulate(ordinalToCentroidRelativeOffset);
+	_preparationTimings.triangulation = timer.mark();
+
+	//
+	//	Greebling is made lazily when the island is drawn; any made for the previous geometry is stale, 
+	//	unless it was adopted from a cooked terrain along with this geometry
+	//
+
+	if ( _hasUntranslatedGreebling )
 	{
-		if ( !group()->terrain()->initializer().greebleTextureAtlas.empty() )
+		_hasUntranslatedGreebling = false;
+	}
+	else
+	{
+		_untranslatedGreebleVertices.clear();
+		_greeblingLevel = -1;
+	}
+
+	_perimeterGreebleVertices.clear();
+	_greeblingTranslated = false;
+
+	if ( triangulated )
+	{
+		_createCollisionPolygons();
+
+		//
+		//	Coarse polygons for the previous geometry are stale; if this island has coarse collision, replace them
+		//
+
+		_coarseCollisionPolygons.clear();
+		if ( _coarseCollision )
 		{
-			_createPerimeterGreebling(ordinalToCentroidRelativeOffset);
+			_createCoarseCollisionPolygons( ordinalToCentroidRelativeOffset ? *ordinalToCentroidRelativeOffset : Vec2r(0,0) );
 		}
 
-		return true;
+		_preparationTimings.collisionPolygons = timer.mark();
 	}
+	else
+	{
+		_usable = false;
+		_collisionPolygons.clear();
+	}
+}
+
+bool Island::commitGeometry()
+{
+	//
+	//	The renderer's FBOs, if any, were built from the previous geometry
+	//
 
-	return false;
+	_renderer->reset();
+	return _usable;
 }
 
 
@@ -77,19 +148,37 @@ bool Island::_triangulate( Vec2r const *ordinalToCentroidRelativeOffset )
 	const Vec2r offset = ordinalToCentroidRelativeOffset ? *ordinalToCentroidRelativeOffset : Vec2r(0,0);
 
 	//
-	//	Clear any previous triangulation and renderer's FBOs, if any
+	//	Clear any previous triangulation; the renderer is reset in commitGeometry()
 	//
 
-	_renderer->reset();
 	_triangulation.clear();
 
-	//
-	//	Triangulate the perimeter
-	//
+	if ( _hasUntranslatedTriangulation )
+	{
+		//
+		//	An async partition already triangulated this island's perimeters at zero offset, so just translate.
+		//	Texture coordinates have the offset removed, so they're unaffected.
+		//
 
-	if ( !_voxelPerimeters.empty() )
+		_triangulation.swap( _untranslatedTriangulation );
+		_untranslatedTriangulation.clear();
+		_hasUntranslatedTriangulation = false;
+
+		const Vec2f translation( offset.x, offset.y );
+		foreach( triangle &tri, _triangulation )
+		{
+			tri.a.position += translation;
+			tri.b.position += translation;
+			tri.c.position += translation;
+		}
+	}
+	else if ( !_voxelPerimeters.empty() )
 	{
-		_triangulatePerimeters( _voxelPerimeters, offset, _triangulation );
+		//
+		//	Triangulate the perimeter
+		//
+
+		_triangulatePerimeters( *_store, _voxelPerimeters, offset, _triangulation );
 	}
 
 	//
@@ -100,9 +189,76 @@ bool Island::_triangulate( Vec2r const *ordinalToCentroidRelativeOffset )
 	return _usable;
 }
 
+void Island::_createCollisionPolygons()
+{
+	_createCollisionPolygons( _triangulation, _collisionPolygons );
+}
+
+void Island::_createCollisionPolygons( const std::vector< triangle > &triangulation, std::vector< Vec2rVec > &polygons ) const
+{
+	polygons.clear();
+
+	if ( group()->terrain()->initializer().mergeCollisionPolygons )
+	{
+		Vec2rVec vertices;
+		vertices.reserve( triangulation.size() * 3 );
+
+		foreach( const triangle &tri, triangulation )
+		{
+			vertices.push_back( tri.a.position );
+			vertices.push_back( tri.b.position );
+			vertices.push_back( tri.c.position );
+		}
+		
+		util::shape_optimization::hertelMehlhorn( vertices, polygons, MaxCollisionPolygonVertices );
+	}
+	else
+	{
+		polygons.resize( triangulation.size() );
+		for ( std::size_t i = 0, N = triangulation.size(); i < N; i++ )
+		{
+			Vec2rVec &polygon = polygons[i];
+			polygon.push_back( triangulation[i].a.position );
+			polygon.push_back( triangulation[i].b.position );
+			polygon.push_back( triangulation[i].c.position );
+		}
+	}
+}
+
+bool Island::_createCoarseCollisionPolygons( const Vec2r &ordinalToCentroidRelativeOffset )
+{
+	_coarseCollisionPolygons.clear();
+
+	//
+	//	Simplify the perimeters much harder than _createVoxelPerimeters does, dropping any which collapse
+	//
+
+	const real Threshold = group()->terrain()->initializer().coarseCollisionSimplification * _store->scale();
+
+	std::vector< Vec2rVec > coarsePerimeters;
+	foreach( const Vec2rVec &perimeter, _voxelPerimeters )
+	{
+		Vec2rVec coarse;
+		util::shape_optimization::rdpSimplify( perimeter, coarse, Threshold );
+
+		if ( coarse.size() > 2 )
+		{
+			coarsePerimeters.push_back( Vec2rVec() );
+			coarsePerimeters.back().swap( coarse );
+		}
+	}
+	
+	std::vector< triangle > coarseTriangulation;
+	_triangulatePerimeters( *_store, coarsePerimeters, ordinalToCentroidRelativeOffset, coarseTriangulation );
+	_createCollisionPolygons( coarseTriangulation, _coarseCollisionPolygons );
+
+	return !_coarseCollisionPolygons.empty();
+}
+
 #if TRIANGULATE_POLY_2_TRI
 
 void Island::_triangulatePerimeters( 
+	const OrdinalVoxelStore &store,
 	const std::vector< Vec2rVec > &ordinalSpacePerimeters, 
 	const Vec2r &offset,
 	std::vector< triangle > &triangulation )
@@ -138,8 +294,8 @@ void Island::_triangulatePerimeters(
 	//	When computing texture coordinates, we will divide the ordinal vertex position by the total world size
 	//
 
-	real terrainScale = _store->scale();
-	const Vec2r TotalOrdinalSizeReciprocal( real(1) / real( _store->width() * terrainScale ), real(1) / real(_store->height() * terrainScale) );
+	real terrainScale = store.scale();
+	const Vec2r TotalOrdinalSizeReciprocal( real(1) / real( store.width() * terrainScale ), real(1) / real(store.height() * terrainScale) );
 
 	//
 	//	Now, for each polyline, triangulate
@@ -186,58 +342,119 @@ void Island::_triangulatePerimeters(
 
 #else
 
+namespace {
 
-void Island::_triangulatePerimeters( 
-	const std::vector< Vec2rVec > &ordinalSpacePerimeters, 
-	const Vec2r &offset,
-	std::vector< triangle > &triangulation )
-{
-	//
-	//	cinder's triangulator uses an approximation scale for quality... not certain what that means on the inside
-	//	It defaults to 1, so I'm setting it to the voxel scale, so it will at least follow level size scaling.
-	//
+	#if TRIANGULATE_MONOTONE
 
-	const float TriangulatorApproximationScale = _store->scale();
+		/**
+			Triangulate @a ordinalSpacePerimeters with util::triangulation, appending three vertices per triangle
+			to @a vertices, clockwise since chipmunk requires it. Returns false if the perimeters were rejected.
+		*/
+		bool TriangulateMonotone( const std::vector< Vec2rVec > &ordinalSpacePerimeters, const Vec2r &offset, Vec2rVec &vertices )
+		{
+			Vec2rVec ccw;
+			if ( !util::triangulation::triangulate( ordinalSpacePerimeters, ccw )) return false;
 
-	//
-	//	Populate the triangulator with paths
-	//
+			vertices.reserve( vertices.size() + ccw.size() );
+			for ( std::size_t i = 0, N = ccw.size(); i < N; i += 3 )
+			{
+				vertices.push_back( ccw[i+2] + offset );
+				vertices.push_back( ccw[i+1] + offset );
+				vertices.push_back( ccw[i] + offset );
+			}
 
-	Triangulator triangulator;	
-	foreach( const Vec2rVec &osp, ordinalSpacePerimeters )
+			return true;
+		}
+
+	#endif
+
+	/**
+		Triangulate @a ordinalSpacePerimeters with cinder's triangulator, appending three vertices per triangle to @a vertices
+	*/
+	void TriangulateCinder( const OrdinalVoxelStore &store, const std::vector< Vec2rVec > &ordinalSpacePerimeters, const Vec2r &offset, Vec2rVec &vertices )
 	{
-		if ( osp.size() > 2 )
-		{
-			Path2d path;
-			path.moveTo( osp.front() + offset );
+		//
+		//	cinder's triangulator uses an approximation scale for quality... not certain what that means on the inside
+		//	It defaults to 1, so I'm setting it to the voxel scale, so it will at least follow level size scaling.
+		//
+
+		const float TriangulatorApproximationScale = store.scale();
 
-			for( Vec2rVec::const_iterator it( osp.begin() + 1 ), end( osp.end()); it != end; ++it )
+		//
+		//	Populate the triangulator with paths. It can't tell holes from outer boundaries, so every 
+		//	perimeter is treated as solid.
+		//
+
+		Triangulator triangulator;	
+		foreach( const Vec2rVec &osp, ordinalSpacePerimeters )
+		{
+			if ( osp.size() > 2 )
 			{
-				path.lineTo( *it + offset );
+				Path2d path;
+				path.moveTo( osp.front() + offset );
+
+				for( Vec2rVec::const_iterator it( osp.begin() + 1 ), end( osp.end()); it != end; ++it )
+				{
+					path.lineTo( *it + offset );
+				}
+
+				path.close();
+				triangulator.addPath( path, TriangulatorApproximationScale );
 			}
+		}
+
+		TriMesh2d mesh( triangulator.calcMesh(Triangulator::WINDING_POSITIVE));
 
-			path.close();
-			triangulator.addPath( path, TriangulatorApproximationScale );
+		vertices.reserve( vertices.size() + mesh.getNumTriangles() * 3 );
+		for ( std::size_t i = 0, N = mesh.getNumTriangles(); i < N; i++ )
+		{
+			ci::Vec2f a,b,c;
+			mesh.getTriangleVertices( i, &a, &b, &c );
+
+			vertices.push_back( a );
+			vertices.push_back( b );
+			vertices.push_back( c );
 		}
 	}
 
+}
+
+void Island::_triangulatePerimeters( 
+	const OrdinalVoxelStore &store,
+	const std::vector< Vec2rVec > &ordinalSpacePerimeters, 
+	const Vec2r &offset,
+	std::vector< triangle > &triangulation )
+{
 	//
-	//	Triangulate
+	//	The marching squares algorithm can (and often does ) produce multiple perimeters for a single island.
+	//	Some are holes, and some are outward facing islands within those holes - this happens when an island 
+	//	narrows to a strip thinner than the isosurface threshold. The monotone triangulator sorts these out
+	//	by nesting.
 	//
 
-	TriMesh2d mesh( triangulator.calcMesh(Triangulator::WINDING_POSITIVE));
+	Vec2rVec vertices;
+
+	#if TRIANGULATE_MONOTONE
+		if ( !TriangulateMonotone( ordinalSpacePerimeters, offset, vertices ))
+		{
+			vertices.clear();
+			TriangulateCinder( store, ordinalSpacePerimeters, offset, vertices );
+		}
+	#else
+		TriangulateCinder( store, ordinalSpacePerimeters, offset, vertices );
+	#endif
 
 	//
 	//	When computing texture coordinates, we will divide the ordinal vertex position by the total world size
 	//
 
-	real terrainScale = _store->scale();
-	const Vec2r TotalOrdinalSizeReciprocal( real(1) / real( _store->width() * terrainScale ), real(1) / real(_store->height() * terrainScale) );
+	real terrainScale = store.scale();
+	const Vec2r TotalOrdinalSizeReciprocal( real(1) / real( store.width() * terrainScale ), real(1) / real(store.height() * terrainScale) );
 
-	for ( std::size_t i = 0, N = mesh.getNumTriangles(); i < N; i++ )
+	triangulation.reserve( triangulation.size() + vertices.size() / 3 );
+	for ( std::size_t i = 0, N = vertices.size(); i < N; i += 3 )
 	{
-		ci::Vec2f a,b,c;
-		mesh.getTriangleVertices( i, &a, &b, &c );
+		const Vec2r &a = vertices[i], &b = vertices[i+1], &c = vertices[i+2];
 	
 		real area = Area( a,b,c );
 		if ( area > Epsilon )
@@ -10,6 +10,11 @@
 
 
 #include "Common.h"
+#include "Exception.h"
+
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
 
 namespace game { namespace terrain {
 
@@ -33,6 +38,11 @@ const real PerimeterOptimizationLinearDistanceThreshold = 0.25;
 
 const real IslandAABBPadding = 0.5;
 
+/**
+	The most Islands which may share a voxel
+*/
+const static std::size_t MaxIslandsPerVoxel = 8;
+
 
 
 #pragma mark -
@@ -86,36 +96,37 @@ class Voxel {
 
 	public:
 		
-		Vec2r	worldPosition;
-		Vec2r	centroidRelativePosition;
+		// a voxel's position is derived from this, by its IslandGroup; see IslandGroup::centroidRelativePosition
 		Vec2i	ordinalPosition;
 
 		int			occupation;
 		int			strength;
 		int			id;
 		std::size_t	tag;
-		std::size_t	numIslands;
 		int			rand;
 		Voxel*		neighbors[8];		
-		Island*		islands[8];
+		
+		// membership id of the first Island owning this voxel, or zero; see OrdinalVoxelStore::partOfIsland
+		uint16_t	islandId;
+		
+		// the number of Islands owning this voxel
+		uint8_t		islandCount;
 
 	public:
 	
 		Voxel():
-			worldPosition(0,0),
-			centroidRelativePosition(0,0),
 			ordinalPosition( -1,-1 ),
 			occupation(0),
 			strength(0),
 			id(0),
 			tag(0),
-			numIslands(0),
-			rand(0)
+			rand(0),
+			islandId(0),
+			islandCount(0)
 		{
 			for ( int i = 0; i < 8; i++ ) 
 			{
 				neighbors[i] = NULL;
-				islands[i] = NULL;
 			}
 		}
 					
@@ -157,49 +168,6 @@ class Voxel {
 			if ( !hasNeighbors() ) occupation = 0;
 		}
 		
-		inline int addToIsland( Island *i )
-		{
-			if ( numIslands < 8 && !partOfIsland(i) )
-			{
-				islands[numIslands++] = i;
-			}
-			
-			return numIslands - 1;
-		}
-		
-		inline void removeFromIsland( Island *i )
-		{
-			if ( numIslands > 0 && partOfIsland(i))
-			{
-				std::remove( islands, islands + numIslands, i );
-				numIslands--;
-				islands[numIslands] = NULL;
-			}
-		}
-		
-		inline int islandIndex( Island *island ) const
-		{
-			for ( int i = 0; i < 8; i++ )
-			{
-				if ( islands[i] == island ) return i;
-			}
-			
-			return -1;
-		}
-		
-		inline bool partOfIsland( Island *i ) const
-		{
-			return numIslands > 0 &&
-			       (islands[0] == i || 
-				    islands[1] == i ||
-				    islands[2] == i ||
-				    islands[3] == i ||
-				    islands[4] == i ||
-				    islands[5] == i ||
-				    islands[6] == i ||
-				    islands[7] == i );
-		}
-		
 };
 
 #pragma mark -
@@ -207,6 +175,22 @@ class Voxel {
 
 /**
 	@class OrdinalVoxelStore
+	Sparse, tiled storage of Voxels by ordinal position.
+	
+	The store is divided into fixed-size tiles ( Terrain uses its sectorSize ), and a tile's voxels are only
+	allocated when allocate() is called for a position inside it. Tiles which are never allocated, e.g., 
+	empty air in the level image, cost one pointer. Voxels in a tile are contiguous in memory.
+	
+	voxelAt() and voxelAtUnsafe() return NULL for positions in unallocated tiles. Voxels on the edge of an allocated tile
+	are linked to neighbors in adjacent allocated tiles, and simply have NULL neighbors where the adjacent tile
+	was never allocated - which is equivalent to being adjacent to an empty, unowned voxel.
+	
+	Call compact() after Islands release voxels to free tiles in which no voxel is owned by any Island.
+	
+	The store also records which Islands own each voxel. Each Island registers for a 16-bit membership id, and a voxel
+	holds the id of its first owner and a count of its owners, so testing a voxel's membership in an Island is a compare.
+	The few voxels owned by more than one Island - the seams where islands meet - also keep the ids of all their 
+	owners in a side table, which is only consulted for them.
 */
 class OrdinalVoxelStore 
 {
@@ -214,8 +198,20 @@ class OrdinalVoxelStore
 	
 		int _width, _height;
 		real _scale, _rScale;
-		std::vector< Voxel > _store;
-		Voxel *_storePtr;
+		Vec2i _tileSize, _tileCount, _tileShift;
+		std::vector< Voxel* > _tiles;
+		std::size_t _allocatedTileCount;
+		ci::Rand _rand;
+		
+		// island membership; _islandsById[0] is unused, as id zero means no island
+		struct shared_membership
+		{
+			uint16_t ids[ MaxIslandsPerVoxel ];
+		};
+
+		std::vector< Island* > _islandsById;
+		std::vector< uint16_t > _freeIslandIds;
+		std::unordered_map< const Voxel*, shared_membership > _sharedMemberships;
 
 	public:
 	
@@ -223,55 +219,139 @@ class OrdinalVoxelStore
 			_width(0),
 			_height(0),
 			_scale(1),
-			_storePtr(NULL)
+			_rScale(1),
+			_tileSize(64,64),
+			_tileCount(0,0),
+			_tileShift(0,0),
+			_allocatedTileCount(0),
+			_islandsById( 1, (Island*) NULL )
 		{}
 		
 		~OrdinalVoxelStore()
-		{}
+		{
+			clear();
+		}
 
 		/**
-			Initialize the vertex store to hold width * height voxels
+			Initialize the vertex store to address width * height voxels, in tiles of @a tileSize.
+			The tile grid is laid so a tile begins at @a tileOrigin; the edge tiles may extend past the store's extent.
+			No tiles are allocated until allocate() is called.
 		*/
-		void set( int width, int height, real scale )
+		void set( int width, int height, real scale, const Vec2i &tileSize = Vec2i(64,64), const Vec2i &tileOrigin = Vec2i(0,0) )
 		{
+			clear();
+		
 			_width = width;
 			_height = height;
 			_scale = scale;
 			_rScale = 1 / scale;
+			_tileSize.x = std::max( tileSize.x, 1 );
+			_tileSize.y = std::max( tileSize.y, 1 );
+			_tileShift.x = ( _tileSize.x - ( tileOrigin.x % _tileSize.x + _tileSize.x ) % _tileSize.x ) % _tileSize.x;
+			_tileShift.y = ( _tileSize.y - ( tileOrigin.y % _tileSize.y + _tileSize.y ) % _tileSize.y ) % _tileSize.y;
+			_tileCount.x = ( width + _tileShift.x + _tileSize.x - 1 ) / _tileSize.x;
+			_tileCount.y = ( height + _tileShift.y + _tileSize.y - 1 ) / _tileSize.y;
 
-			_store.resize(width * height);
-			_storePtr = &(_store[0]);
+			_tiles.assign( _tileCount.x * _tileCount.y, (Voxel*) NULL );
+		}
+		
+		/**
+			Free all tiles
+		*/
+		void clear()
+		{
+			foreach( Voxel *tile, _tiles )
+			{
+				delete [] tile;
+			}
 			
-			for ( std::size_t row = 0; row < height; row++ )
+			_tiles.clear();
+			_allocatedTileCount = 0;
+			
+			_islandsById.assign( 1, (Island*) NULL );
+			_freeIslandIds.clear();
+			_sharedMemberships.clear();
+		}
+		
+		/**
+			Get the voxel at x,y allocating its tile if needed. Returns NULL if x,y is out of bounds.
+			If @a link is false, a newly allocated tile's voxels aren't linked to one another or to adjacent tiles.
+		*/
+		Voxel *allocate( int x, int y, bool link = true )
+		{
+			if ( !contains( x, y )) return NULL;
+
+			const std::size_t index = tileIndex( x, y );
+			if ( !_tiles[index] )
 			{
-				for ( std::size_t col = 0; col < width; col++ )
-				{
-					Voxel *v = &(_storePtr[row * width + col]);
-					v->ordinalPosition.x = col;
-					v->ordinalPosition.y = row;
-				}
+				_allocateTile( int( index % _tileCount.x ), int( index / _tileCount.x ), link );
 			}
 			
-			ci::Rand rand;
-			foreach( Voxel &v, _store )
+			return voxelAtUnsafe( x, y );
+		}
+		
+		/**
+			Free any allocated tiles intersecting @a ordinalBounds in which no voxel is owned by an Island.
+			Before being freed, each voxel in such a tile is disconnected from its neighbors so no dangling 
+			neighbor pointers remain in adjacent tiles.
+		*/
+		void compact( const ci::Recti &ordinalBounds )
+		{
+			const int 
+				txStart = std::max( ( std::max( ordinalBounds.x1, 0 ) + _tileShift.x ) / _tileSize.x, 0 ),
+				txEnd = std::min( ( ordinalBounds.x2 + _tileShift.x ) / _tileSize.x, _tileCount.x - 1 ),
+				tyStart = std::max( ( std::max( ordinalBounds.y1, 0 ) + _tileShift.y ) / _tileSize.y, 0 ),
+				tyEnd = std::min( ( ordinalBounds.y2 + _tileShift.y ) / _tileSize.y, _tileCount.y - 1 ),
+				tileArea = _tileSize.x * _tileSize.y;
+				
+			for ( int ty = tyStart; ty <= tyEnd; ty++ )
 			{
-				v.rand = rand.nextInt();
-				for ( int i = 0; i < 8; i++ )
+				for ( int tx = txStart; tx <= txEnd; tx++ )
 				{
-					v.neighbors[i] = this->voxelAt( v.ordinalPosition + Compass::dir( i ) );
+					Voxel *&tile = _tiles[ ty * _tileCount.x + tx ];
+					if ( !tile ) continue;
+
+					bool inUse = false;
+					for ( Voxel *v = tile, *end = tile + tileArea; v != end; ++v )
+					{
+						if ( v->islandCount > 0 ) 
+						{
+							inUse = true;
+							break;
+						}
+					}
+					
+					if ( !inUse )
+					{
+						for ( Voxel *v = tile, *end = tile + tileArea; v != end; ++v )
+						{
+							v->disconnect();
+						}
+
+						delete [] tile;
+						tile = NULL;
+						_allocatedTileCount--;
+					}
 				}
-			}			
+			}
+		}
+		
+		/**
+			Free any allocated tiles in which no voxel is owned by an Island
+		*/
+		void compact()
+		{
+			compact( ci::Recti( 0, 0, _width - 1, _height - 1 ));
+		}
+		
+		inline bool contains( int x, int y ) const
+		{
+			return x >= 0 && x < _width && y >= 0 && y < _height;
 		}
 						
 		inline Voxel* voxelAt( int x, int y ) const 
 		{
-			if ( x >= 0 && x < _width &&
-				 y >= 0 && y < _height )
-			{
-				return &(_storePtr[ (y * _width) + x]);
-			}
-			
-			return NULL;
+			return contains( x, y ) ? voxelAtUnsafe( x, y ) : NULL;
 		}
 		
 		inline Voxel* voxelAt( const Vec2i &a ) const { return voxelAt( a.x, a.y ); }
@@ -281,9 +361,13 @@ class OrdinalVoxelStore
 			return voxelAt( int( world.x * _rScale ), int( world.y * _rScale ));
 		}
 		
+		/**
+			Get the voxel at x,y without bounds checking. Returns NULL if the voxel's tile is not allocated.
+		*/
 		inline Voxel* voxelAtUnsafe( int x, int y ) const 
 		{
-			return &(_storePtr[ (y * _width) + x]);
+			Voxel *tile = _tiles[ tileIndex( x, y ) ];
+			return tile ? tile + indexInTile( x, y ) : NULL;
 		}
 
 		inline Voxel* voxelAtUnsafe( const Vec2i &a ) const { return voxelAtUnsafe( a.x, a.y ); }
@@ -293,7 +377,255 @@ class OrdinalVoxelStore
 		real scale() const { return _scale; }
 		Vec2i size() const { return Vec2i( _width, _height ); }
 		
-		const std::vector< Voxel > &voxels() const { return _store; }
+		Vec2i tileSize() const { return _tileSize; }
+		
+		/**
+			Get the ordinal position at which the tile grid is laid, wrapped into the first tile
+		*/
+		Vec2i tileOrigin() const { return Vec2i( ( _tileSize.x - _tileShift.x ) % _tileSize.x, ( _tileSize.y - _tileShift.y ) % _tileSize.y ); }
+		std::size_t tileCount() const { return _tiles.size(); }
+		
+		/**
+			Get the index of the tile holding the in-bounds voxel at x,y
+		*/
+		inline std::size_t tileIndex( int x, int y ) const
+		{
+			return ( (y + _tileShift.y) / _tileSize.y ) * _tileCount.x + ( (x + _tileShift.x) / _tileSize.x );
+		}
+		
+		/**
+			Get the row-major index of the in-bounds voxel at x,y within its tile
+		*/
+		inline std::size_t indexInTile( int x, int y ) const
+		{
+			return ( (y + _tileShift.y) % _tileSize.y ) * _tileSize.x + ( (x + _tileShift.x) % _tileSize.x );
+		}
+		std::size_t allocatedTileCount() const { return _allocatedTileCount; }
+		
+		/**
+			Get the voxels of tile @a index in row-major order, or NULL if the tile isn't allocated.
+			Tiles are indexed in row-major order too.
+		*/
+		Voxel *tile( std::size_t index ) const { return _tiles[index]; }
+		
+		/**
+			Get the voxels of tile @a index, allocating it if needed, linked as allocate() would
+		*/
+		Voxel *allocateTile( std::size_t index, bool link = true )
+		{
+			if ( !_tiles[index] )
+			{
+				_allocateTile( int( index % _tileCount.x ), int( index / _tileCount.x ), link );
+			}
+			
+			return _tiles[index];
+		}
+		
+		/**
+			Assign @a island a membership id, which must be returned with unregisterIsland once it has released its voxels.
+			Throws if every id is in use.
+		*/
+		uint16_t registerIsland( Island *island )
+		{
+			uint16_t id;
+			if ( !_freeIslandIds.empty() )
+			{
+				id = _freeIslandIds.back();
+				_freeIslandIds.pop_back();
+				_islandsById[id] = island;
+			}
+			else
+			{
+				if ( _islandsById.size() > std::numeric_limits< uint16_t >::max() )
+				{
+					throw core::Exception( "OrdinalVoxelStore::registerIsland - out of island membership ids" );
+				}
+
+				id = uint16_t( _islandsById.size() );
+				_islandsById.push_back( island );
+			}
+			
+			return id;
+		}
+		
+		void unregisterIsland( uint16_t id )
+		{
+			if ( id > 0 && id < _islandsById.size() && _islandsById[id] )
+			{
+				_islandsById[id] = NULL;
+				_freeIslandIds.push_back( id );
+			}
+		}
+		
+		/**
+			Get the Island registered with membership id @a id
+		*/
+		Island *island( uint16_t id ) const { return _islandsById[id]; }
+		
+		/**
+			Get the @a index'th of the v->islandCount Islands owning @a v. The zeroth is the first to have taken ownership.
+		*/
+		Island *islandOf( const Voxel *v, std::size_t index ) const
+		{
+			if ( index == 0 ) return _islandsById[ v->islandId ];
+			return _islandsById[ _sharedMemberships.find( v )->second.ids[index] ];
+		}
+		
+		/**
+			Get the index of the Island with membership id @a id in the Islands owning @a v, or -1 if it doesn't own @a v
+		*/
+		int islandIndex( const Voxel *v, uint16_t id ) const
+		{
+			if ( v->islandId == id ) return v->islandCount > 0 ? 0 : -1;
+			if ( v->islandCount < 2 ) return -1;
+
+			const shared_membership &shared = _sharedMemberships.find( v )->second;
+			for ( std::size_t i = 1; i < v->islandCount; i++ )
+			{
+				if ( shared.ids[i] == id ) return int(i);
+			}
+			
+			return -1;
+		}
+		
+		/**
+			Check if the Island with membership id @a id owns @a v. Membership ids are never zero, so for
+			all but shared voxels, this is a single compare.
+		*/
+		inline bool partOfIsland( const Voxel *v, uint16_t id ) const
+		{
+			return v->islandId == id || ( v->islandCount > 1 && islandIndex( v, id ) > 0 );
+		}
+		
+		/**
+			Make the Island with membership id @a id an owner of @a v, unless it already is, or @a v has MaxIslandsPerVoxel owners
+		*/
+		void addToIsland( Voxel *v, uint16_t id )
+		{
+			if ( v->islandCount == 0 )
+			{
+				v->islandId = id;
+				v->islandCount = 1;
+			}
+			else if ( v->islandCount < MaxIslandsPerVoxel && !partOfIsland( v, id ))
+			{
+				shared_membership &shared = _sharedMemberships[v];
+				shared.ids[0] = v->islandId;
+				shared.ids[ v->islandCount++ ] = id;
+			}
+		}
+		
+		/**
+			Remove the Island with membership id @a id from the owners of @a v, preserving the order of the rest
+		*/
+		void removeFromIsland( Voxel *v, uint16_t id )
+		{
+			const int index = islandIndex( v, id );
+			if ( index < 0 ) return;
+			
+			if ( v->islandCount == 1 )
+			{
+				v->islandId = 0;
+				v->islandCount = 0;
+				return;
+			}
+			
+			std::unordered_map< const Voxel*, shared_membership >::iterator pos = _sharedMemberships.find( v );
+			uint16_t *ids = pos->second.ids;
+			
+			std::copy( ids + index + 1, ids + v->islandCount, ids + index );
+			v->islandCount--;
+			v->islandId = ids[0];
+			
+			if ( v->islandCount == 1 ) _sharedMemberships.erase( pos );
+		}
+		
+		/**
+			Make every voxel unowned and forget all membership ids. Only valid when no Islands remain.
+		*/
+		void clearIslandMembership()
+		{
+			const std::size_t tileArea = _tileSize.x * _tileSize.y;
+			foreach( Voxel *tile, _tiles )
+			{
+				if ( !tile ) continue;
+				for ( Voxel *v = tile, *end = tile + tileArea; v != end; ++v )
+				{
+					v->islandId = 0;
+					v->islandCount = 0;
+				}
+			}
+			
+			_islandsById.assign( 1, (Island*) NULL );
+			_freeIslandIds.clear();
+			_sharedMemberships.clear();
+		}
+		
+		/**
+			Bytes of voxel storage currently allocated
+		*/
+		std::size_t allocatedBytes() const 
+		{ 
+			return _allocatedTileCount * _tileSize.x * _tileSize.y * sizeof( Voxel ) + _tiles.size() * sizeof( Voxel* ) +
+				_sharedMemberships.size() * ( sizeof( const Voxel* ) + sizeof( shared_membership )); 
+		}
+		
+	private:
+	
+		// not copyable, since we own our tiles
+		OrdinalVoxelStore( const OrdinalVoxelStore & );
+		OrdinalVoxelStore &operator = ( const OrdinalVoxelStore & );
+		
+		void _allocateTile( int tx, int ty, bool link )
+		{
+			const int 
+				originX = tx * _tileSize.x - _tileShift.x,
+				originY = ty * _tileSize.y - _tileShift.y;
+		
+			Voxel *tile = new Voxel[ _tileSize.x * _tileSize.y ];
+			_tiles[ ty * _tileCount.x + tx ] = tile;
+			_allocatedTileCount++;
+
+			//
+			//	Assign ordinal positions, then link to neighbors. Neighbors in other allocated tiles get a link back to us.
+			//	Voxels of edge tiles which fall outside the store's extent are left unlinked.
+			//
+
+			for ( int row = 0; row < _tileSize.y; row++ )
+			{
+				for ( int col = 0; col < _tileSize.x; col++ )
+				{
+					Voxel *v = tile + ( row * _tileSize.x + col );
+					v->ordinalPosition.x = originX + col;
+					v->ordinalPosition.y = originY + row;
+					v->rand = _rand.nextInt();
+				}
+			}
+
+			if ( !link ) return;
+
+			for ( int row = 0; row < _tileSize.y; row++ )
+			{
+				for ( int col = 0; col < _tileSize.x; col++ )
+				{
+					Voxel *v = tile + ( row * _tileSize.x + col );
+					if ( !contains( v->ordinalPosition.x, v->ordinalPosition.y )) continue;
+
+					const bool tileEdge = row == 0 || col == 0 || row == _tileSize.y - 1 || col == _tileSize.x - 1;
+					
+					for ( int i = 0; i < 8; i++ )
+					{
+						Voxel *n = voxelAt( v->ordinalPosition + Compass::dir( i ));
+						v->neighbors[i] = n;
+
+						if ( n && tileEdge ) 
+						{
+							n->neighbors[(i + 4) % 8] = v;
+						}
+					}
+				}
+			}
+		}
 
 };
 
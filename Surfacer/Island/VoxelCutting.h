@@ -0,0 +1,352 @@
+#pragma once
+
+//
+//  VoxelCutting.h
+//  Surfacer
+//
+//  Created by Shamyl Zakariya on 10/17/12.
+//  Copyright 2012 TomorrowPlusX. All rights reserved.
+//
+
+#include "Terrain.h"
+#include "LineSegment.h"
+#include "PackedVoxelStore.h"
+
+namespace game { namespace terrain { namespace cutting {
+
+const real
+	VoxelRadiusLocal = 0.707106781;
+
+// apply a line to a voxel to remove its occupation component, disconnecting if emptied. The line and distances are
+// in ordinal space, where the voxel's position is its ordinalPosition.
+inline unsigned int LineVoxelCut(
+	Voxel *voxel,
+	const core::util::line_segment &line,
+	real minDist,
+	real maxDist,
+	real oneOverMaxMinusMin,
+	real cutStrength )
+{
+	const Vec2r position( voxel->ordinalPosition );
+	real dist = line.distance( position );
+	unsigned int effectMask = 0;
+
+	//
+	//	subtract occupation from the vertex based on its overlap with the line segment
+	//
+
+	if ( dist <= maxDist )
+	{
+		//
+		//	If this voxel is fixed, early exit
+		//
+
+		if ( voxel->fixed() )
+		{
+			return Terrain::CUT_HIT_FIXED_VOXELS;
+		}
+
+		// this is the maximum possible occupation of the voxel given overlap and a hypothetical infinitely strong cut
+		int maxPossibleOccupation = std::min( lrintf( (dist - minDist) * oneOverMaxMinusMin * 255.0 ), 255L ),
+		    ablation = 255 * (((255 - voxel->strength)/real(255)) * cutStrength); // 0->255
+
+		ablation = std::max( std::min( ablation, voxel->occupation - maxPossibleOccupation ), 0 );
+
+		if ( ablation > 0 )
+		{
+			voxel->occupation -= ablation;
+			effectMask |= Terrain::CUT_AFFECTED_VOXELS;
+		}
+
+		//
+		//	If we actually changed the voxel occupation
+		//
+
+		if ( effectMask && voxel->occupation < MinimumVoxelOccupation )
+		{
+			voxel->disconnect();
+			effectMask |= Terrain::CUT_AFFECTED_ISLAND_CONNECTIVITY;
+		}
+	}
+
+	//
+	//	Cut neighbor connections which intersect the cutting line
+	//
+
+	for ( int dir = 0; dir < 8; ++dir )
+	{
+		Voxel *neighbor = voxel->neighbors[dir];
+		if ( neighbor && line.intersects( position, position + Vec2r( Compass::dir(dir) )))
+		{
+			voxel->disconnect(dir);
+			effectMask |= Terrain::CUT_AFFECTED_ISLAND_CONNECTIVITY;
+		}
+	}
+
+	return effectMask;
+}
+
+/**
+	PackedVoxelStore variant of LineVoxelCut. Voxel @a i is positioned at @a position, in the same
+	space as @a line; neighbor positions are derived by offsetting by the store's scale along Compass::dir.
+*/
+inline unsigned int LineVoxelCut(
+	PackedVoxelStore &store,
+	int i,
+	const Vec2r &position,
+	const core::util::line_segment &line,
+	real minDist,
+	real maxDist,
+	real oneOverMaxMinusMin,
+	real cutStrength )
+{
+	real dist = line.distance( position );
+	unsigned int effectMask = 0;
+
+	if ( dist <= maxDist )
+	{
+		if ( store.fixed(i) )
+		{
+			return Terrain::CUT_HIT_FIXED_VOXELS;
+		}
+
+		const int occupation = store.occupation(i);
+		int maxPossibleOccupation = std::min( lrintf( (dist - minDist) * oneOverMaxMinusMin * 255.0 ), 255L ),
+		    ablation = 255 * (((255 - store.strength(i))/real(255)) * cutStrength);
+
+		ablation = std::max( std::min( ablation, occupation - maxPossibleOccupation ), 0 );
+
+		if ( ablation > 0 )
+		{
+			store.setOccupation( i, occupation - ablation );
+			effectMask |= Terrain::CUT_AFFECTED_VOXELS;
+		}
+
+		if ( effectMask && store.occupation(i) < MinimumVoxelOccupation )
+		{
+			store.disconnect(i);
+			effectMask |= Terrain::CUT_AFFECTED_ISLAND_CONNECTIVITY;
+		}
+	}
+
+	const real scale = store.scale();
+	for ( uint8_t mask = store.connectivity(i), dir = 0; mask; ++dir, mask >>= 1 )
+	{
+		if ( mask & 1 )
+		{
+			const Vec2i &d = Compass::dir(dir);
+			if ( line.intersects( position, position + Vec2r( d.x * scale, d.y * scale )))
+			{
+				store.disconnect( i, dir );
+				effectMask |= Terrain::CUT_AFFECTED_ISLAND_CONNECTIVITY;
+			}
+		}
+	}
+
+	return effectMask;
+}
+
+// apply a disk's @a overlap with a voxel to remove its occupation component, disconnecting if emptied or if @a clears
+inline unsigned int DiskVoxelCut( Voxel *voxel, real overlap, bool clears, real cutStrength )
+{
+	//
+	//  disregard uncuttable voxels
+	//  note: we have to check for fixed voxels that could have been touched for CUT_HIT_VOXELS to be meaningful
+	//
+
+	if ( voxel->fixed() ) 
+	{
+		return Terrain::CUT_HIT_FIXED_VOXELS;
+	}
+
+	//
+	//  ablation is the amount that could be removed based on overlap, cut strength and the voxel's strength, 0->255
+	//  note that ablation falls to zero as voxel strength goes to 255
+	//
+
+	int ablation = 255 * (((255 - voxel->strength)/real(255)) * overlap * cutStrength);
+	if ( ablation <= 0 ) return 0;
+
+	voxel->occupation = std::max( voxel->occupation - ablation, 0 );
+	unsigned int effectMask = Terrain::CUT_AFFECTED_VOXELS;
+
+	if ( voxel->occupation < MinimumVoxelOccupation || clears )
+	{
+		effectMask |= Terrain::CUT_AFFECTED_ISLAND_CONNECTIVITY;
+		voxel->disconnect();
+		voxel->occupation = 0;
+	}
+
+	return effectMask;
+}
+
+#pragma mark - Cut Rasterization
+
+namespace detail {
+
+	// narrow [lo,hi] to the x for which minValue <= k*x + c <= maxValue
+	inline void clip_linear( real k, real c, real minValue, real maxValue, real &lo, real &hi )
+	{
+		if ( std::abs(k) < Epsilon )
+		{
+			if ( c < minValue || c > maxValue ) 
+			{
+				lo = FLT_MAX;
+				hi = -FLT_MAX;
+			}
+
+			return;
+		}
+
+		real x0 = (minValue - c) / k, x1 = (maxValue - c) / k;
+		if ( k < 0 ) std::swap( x0, x1 );
+
+		lo = std::max( lo, x0 );
+		hi = std::min( hi, x1 );
+	}
+
+}
+
+/**
+	Find the extent [@a x0, @a x1] of the horizontal line at @a y lying within @a radius of the segment @a a -> @a b.
+	Returns false if the line misses the capsule entirely.
+*/
+inline bool CapsuleRowSpan( const Vec2r &a, const Vec2r &b, real radius, real y, real &x0, real &x1 )
+{
+	real lo = FLT_MAX, hi = -FLT_MAX;
+
+	//
+	//	The end caps
+	//
+
+	const Vec2r *ends[2] = { &a, &b };
+	for ( int i = 0; i < 2; i++ )
+	{
+		const real dy = y - ends[i]->y, h2 = radius * radius - dy * dy;
+		if ( h2 >= 0 )
+		{
+			const real h = std::sqrt( h2 );
+			lo = std::min( lo, ends[i]->x - h );
+			hi = std::max( hi, ends[i]->x + h );
+		}
+	}
+
+	//
+	//	The band between the caps, where projection onto the segment falls inside it and perpendicular
+	//	distance is within radius. Both are linear in x. The capsule is convex, so the union of the three
+	//	pieces is a single span.
+	//
+
+	const Vec2r d = b - a;
+	const real length2 = d.lengthSquared();
+	if ( length2 > Epsilon )
+	{
+		const real 
+			length = std::sqrt( length2 ),
+			dy = y - a.y;
+
+		real bandLo = -FLT_MAX, bandHi = FLT_MAX;
+		detail::clip_linear( d.x, dy * d.y - a.x * d.x, 0, length2, bandLo, bandHi );
+		detail::clip_linear( -d.y, dy * d.x + a.x * d.y, -radius * length, radius * length, bandLo, bandHi );
+
+		if ( bandLo <= bandHi )
+		{
+			lo = std::min( lo, bandLo );
+			hi = std::max( hi, bandHi );
+		}
+	}
+
+	x0 = lo;
+	x1 = hi;
+	return lo <= hi;
+}
+
+/**
+	Call @a visitor( x, y ) for each integer cell within @a radius of the segment @a a -> @a b, a row at a time,
+	restricted to the inclusive rect @a bounds. Everything is in ordinal units. A disk is a capsule where @a a == @a b.
+*/
+template< class V >
+void RasterizeCapsule( const Vec2r &a, const Vec2r &b, real radius, const ci::Recti &bounds, V &visitor )
+{
+	const int 
+		yMin = std::max( bounds.y1, int(std::ceil( std::min( a.y, b.y ) - radius ))),
+		yMax = std::min( bounds.y2, int(std::floor( std::max( a.y, b.y ) + radius )));
+
+	for ( int y = yMin; y <= yMax; y++ )
+	{
+		real x0, x1;
+		if ( CapsuleRowSpan( a, b, radius, y, x0, x1 ))
+		{
+			const int 
+				xMin = std::max( bounds.x1, int(std::ceil( x0 ))),
+				xMax = std::min( bounds.x2, int(std::floor( x1 )));
+
+			for ( int x = xMin; x <= xMax; x++ )
+			{
+				visitor( x, y );
+			}
+		}
+	}
+}
+
+#pragma mark - Cut Stencils
+
+/**
+	Disk stencils are keyed by radius, quantized to this fraction of a voxel, and by the disk center's 
+	position within its voxel, quantized to this fraction of a voxel on each axis
+*/
+const int 
+	DiskStencilRadiusSteps = 8,
+	DiskStencilPhaseSteps = 4;
+
+namespace detail {
+
+	struct disk_stencil_builder
+	{
+		disk_stencil &stencil;
+		Vec2r center;
+		real touchDistance, clearDistance, oneOverOverlapRange;
+
+		disk_stencil_builder( disk_stencil &s, const Vec2r &c, real touch, real complete, real clear ):
+			stencil(s),
+			center(c),
+			touchDistance(touch),
+			clearDistance(clear),
+			oneOverOverlapRange( 1 / ( touch - complete ))
+		{}
+
+		inline void operator()( int x, int y )
+		{
+			const real dist = center.distance( Vec2r( x, y ));
+			if ( dist < touchDistance )
+			{
+				disk_stencil::cell cell;
+				cell.offset = Vec2i( x, y );
+				cell.overlap = saturate(( touchDistance - dist ) * oneOverOverlapRange );
+				cell.clears = dist < clearDistance;
+				stencil.cells.push_back( cell );
+			}
+		}
+	};
+
+}
+
+/**
+	Build into @a stencil the overlap of a disk of @a radius centered at @a center with each voxel it touches, in ordinal 
+	units relative to the voxel at the origin. Voxels closer to the center than @a radius - VoxelRadiusLocal + @a clearSlop 
+	are marked as cleared. This matches the per-voxel math cutDisk would otherwise perform.
+*/
+inline void BuildDiskStencil( real radius, const Vec2r &center, real clearSlop, disk_stencil &stencil )
+{
+	const real 
+		TouchDistance = radius + VoxelRadiusLocal,
+		CompleteOverlapDistance = radius - VoxelRadiusLocal;
+
+	const int extent = int( std::ceil( TouchDistance )) + 1;
+
+	stencil.cells.clear();
+	detail::disk_stencil_builder builder( stencil, center, TouchDistance, CompleteOverlapDistance, CompleteOverlapDistance + clearSlop );
+	RasterizeCapsule( center, center, TouchDistance, ci::Recti( -extent, -extent, extent, extent ), builder );
+}
+
+}}} // end namespace game::terrain::cutting
@@ -102,16 +102,16 @@ void CuttingBeam::update( const time_state &time )
 
 			for( beam_segment_vec::const_iterator seg(_beamSegments.begin()),end(_beamSegments.end()); seg != end; ++seg )
 			{
-				if ( Firing )
-				{
-					_cutTerrain( *seg ); 
-				}
-
 				cpBBExpand( bounds, cpv(seg->start), Rad );
 				cpBBExpand( bounds, cpv(seg->end), Rad );
 			}
 		}	
 		
+		if ( Firing )
+		{
+			_cutTerrain( _beamSegments ); 
+		}
+
 		setAabb( bounds );		
 	}
 		
@@ -158,19 +158,28 @@ void CuttingBeam::setAiming( bool aiming )
 }
 
 
-void CuttingBeam::_cutTerrain( const beam_segment &seg )
+void CuttingBeam::_cutTerrain( const beam_segment_vec &segments )
 {
-	const Vec2r 
-		Wiggle = seg.right * _initializer.cutWidth * _initializer.overcut * real(0.25) * std::cos( level()->time().time * 2 * M_PI ),
-		Start = seg.start + Wiggle,
-		End = seg.end + Wiggle + (seg.dir * _initializer.overcut * _initializer.cutWidth);
-		
-	((GameLevel*)level())->terrain()->cutLine( 
-		Start, 
-		End,
-		_initializer.cutWidth, 
-		_initializer.cutStrength, 
-		TerrainCutType::GAMEPLAY );			
+	//
+	//	Reflected beams can have many segments; cut with them all in one batch
+	//
+
+	const real WiggleScale = _initializer.cutWidth * _initializer.overcut * real(0.25) * std::cos( level()->time().time * 2 * M_PI );
+
+	std::vector< terrain::cut_primitive > cuts;
+	cuts.reserve( segments.size() );
+
+	for( beam_segment_vec::const_iterator seg(segments.begin()),end(segments.end()); seg != end; ++seg )
+	{
+		const Vec2r 
+			Wiggle = seg->right * WiggleScale,
+			Start = seg->start + Wiggle,
+			End = seg->end + Wiggle + (seg->dir * _initializer.overcut * _initializer.cutWidth);
+
+		cuts.push_back( terrain::cut_primitive::line( Start, End, _initializer.cutWidth, _initializer.cutStrength ));
+	}
+
+	((GameLevel*)level())->terrain()->cutBatch( cuts, TerrainCutType::GAMEPLAY );
 }
 
 #pragma mark -
@@ -131,7 +131,7 @@ class CuttingBeam : public BeamWeapon
 
 	protected:
 	
-		virtual void _cutTerrain( const beam_segment &seg );
+		virtual void _cutTerrain( const beam_segment_vec &segments );
 
 	private:
 	
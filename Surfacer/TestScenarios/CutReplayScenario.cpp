@@ -0,0 +1,48 @@
+//
+//  CutReplayScenario.cpp
+//  Surfacer
+//
+//  Created by Shamyl Zakariya on 10/17/12.
+//  Copyright 2012 TomorrowPlusX. All rights reserved.
+//
+
+#include "CutReplayScenario.h"
+
+#include <cinder/app/App.h>
+
+#include "TerrainBenchmarks.h"
+
+using namespace ci;
+using namespace core;
+using namespace game;
+
+/*
+		fs::path _recordingPath, _resultsPath;
+		bool _replayed;
+*/
+
+CutReplayScenario::CutReplayScenario( const fs::path &recordingPath, const fs::path &resultsPath ):
+	_recordingPath( recordingPath ),
+	_resultsPath( resultsPath ),
+	_replayed(false)
+{}
+
+CutReplayScenario::~CutReplayScenario()
+{}
+
+void CutReplayScenario::update( const time_state &time )
+{
+	//
+	//	The level is loaded by the first update, so replay then and quit; a failed replay is logged to the console
+	//
+
+	if ( !_replayed )
+	{
+		_replayed = true;
+		terrain::benchmarks::ReplayCutRecordingFile( gameLevel()->terrain(), _recordingPath, _resultsPath, app::console() );
+		app::App::get()->quit();
+		return;
+	}
+
+	CuttingTestScenario::update( time );
+}
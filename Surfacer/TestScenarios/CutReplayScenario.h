@@ -0,0 +1,34 @@
+#pragma once
+
+//
+//  CutReplayScenario.h
+//  Surfacer
+//
+//  Created by Shamyl Zakariya on 10/17/12.
+//  Copyright 2012 TomorrowPlusX. All rights reserved.
+//
+
+#include "CuttingTestScenario.h"
+
+/**
+	@class CutReplayScenario
+	Loads CuttingTestScenario's level, replays a cut recording against it without input by way of 
+	terrain::benchmarks::CutReplayBenchmark, writes the phase timings to a results file and quits.
+	Main runs it in place of the usual scenario when launched with: --replay <recording.json> <results.json>
+*/
+
+class CutReplayScenario : public CuttingTestScenario
+{
+	public:
+	
+		CutReplayScenario( const fs::path &recordingPath, const fs::path &resultsPath );
+		virtual ~CutReplayScenario();
+
+		void update( const time_state &time );
+		
+	protected:
+	
+		fs::path _recordingPath, _resultsPath;
+		bool _replayed;
+		
+};
@@ -11,12 +11,14 @@
 #include <cinder/app/App.h>
 #include <cinder/ImageIO.h>
 #include <cinder/Utilities.h>
+#include <fstream>
 
 #include "Background.h"
 #include "Fluid.h"
 #include "GameConstants.h"
 #include "ParticleSystem.h"
 #include "Player.h"
+#include "TerrainBenchmarks.h"
 #include "ViewportController.h"
 
 using namespace ci;
@@ -518,6 +520,75 @@ bool CuttingTestScenario::keyDown( const app::KeyEvent &event )
 
 			return true;
 		}
+		
+		case app::KeyEvent::KEY_b:
+		{
+			const terrain::Terrain::init &terrainInit = level->terrain()->initializer();
+			const Surface levelImage = level->resourceManager()->getSurface( terrainInit.levelImage );
+
+			terrain::benchmarks::VoxelStoreBenchmark( levelImage, terrainInit.scale, app::console() );
+			terrain::benchmarks::PerimeterLinkerBenchmark( levelImage, terrainInit.sectorSize, app::console() );
+			terrain::benchmarks::ComponentLabelingBenchmark( levelImage, terrainInit.scale, app::console() );
+			terrain::benchmarks::TriangulationBenchmark( app::console() );
+
+			// restoring replaces the terrain's bodies, so don't pull them out from under the mouse joint
+			if ( !_mouseJoint )
+			{
+				terrain::benchmarks::SnapshotBenchmark( level->terrain(), app::console() );
+			}
+
+			return true;
+		}
+		
+		case app::KeyEvent::KEY_r:
+		{
+			//
+			//	Toggle recording cuts; recording starts from the loaded terrain, so the recording can be replayed against it
+			//
+
+			terrain::Terrain *levelTerrain = level->terrain();
+			const fs::path recordingPath = getHomeDirectory() / "Desktop" / "CuttingTestScenario-cuts.json";
+
+			if ( !levelTerrain->cutRecording() )
+			{
+				if ( !_mouseJoint )
+				{
+					levelTerrain->restore( levelTerrain->loadedState() );
+					_cutRecording.clear();
+					levelTerrain->setCutRecording( &_cutRecording );
+					app::console() << "Recording cuts" << std::endl;
+				}
+			}
+			else
+			{
+				levelTerrain->setCutRecording( NULL );
+
+				std::ofstream recording( recordingPath.string().c_str() );
+				terrain::benchmarks::WriteCutRecording( _cutRecording, recording );
+				app::console() << "Recorded " << _cutRecording.size() << " cuts to " << recordingPath << std::endl;
+			}
+
+			return true;
+		}
+
+		case app::KeyEvent::KEY_p:
+		{
+			//
+			//	Replay the saved cut recording as a benchmark
+			//
+
+			terrain::Terrain *levelTerrain = level->terrain();
+			const fs::path 
+				recordingPath = getHomeDirectory() / "Desktop" / "CuttingTestScenario-cuts.json",
+				resultsPath = getHomeDirectory() / "Desktop" / "CuttingTestScenario-replay.json";
+
+			if ( !_mouseJoint && !levelTerrain->cutRecording() && fs::exists( recordingPath ))
+			{
+				terrain::benchmarks::ReplayCutRecordingFile( levelTerrain, recordingPath, resultsPath, app::console() );
+			}
+
+			return true;
+		}
 
 		default: break;
 	}
@@ -62,4 +62,6 @@ class CuttingTestScenario : public game::GameScenario, public core::InputListene
 				
 		Vec2rVec _cut;			
 		Font _font;
+		
+		std::vector< game::terrain::recorded_cut > _cutRecording;
 };
\ No newline at end of file
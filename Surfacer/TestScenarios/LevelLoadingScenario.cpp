@@ -152,6 +152,23 @@ bool LevelLoadingScenario::keyDown( const app::KeyEvent &event )
 			break;
 		}
 
+		case app::KeyEvent::KEY_k:
+		{
+			//
+			//	Cook the level's terrain as loaded, to be committed beside its levelImage
+			//
+
+			terrain::Terrain *levelTerrain = gameLevel()->terrain();
+			if ( levelTerrain && !levelTerrain->cutRecording() )
+			{
+				levelTerrain->restore( levelTerrain->loadedState() );
+				app::console() << ( levelTerrain->cook() ? "Cooked" : "Unable to cook" ) << " terrain to \"" 
+					<< levelTerrain->initializer().cookedTerrain << "\"" << std::endl;
+			}
+
+			return true;
+		}
+
 		default: break;
 	}
 	
@@ -0,0 +1,916 @@
+//
+//  TerrainBenchmarks.cpp
+//  Surfacer
+//
+//  Created by Shamyl Zakariya on 10/17/12.
+//  Copyright 2012 TomorrowPlusX. All rights reserved.
+//
+
+#include "TerrainBenchmarks.h"
+
+#include <cinder/DataSource.h>
+#include <cinder/Rand.h>
+#include <cinder/Triangulate.h>
+
+#include "ComponentLabeling.h"
+#include "FloodFill.h"
+#include "Level.h"
+#include "MarchingSquares.h"
+#include "PackedVoxelStore.h"
+#include "Stopwatch.h"
+#include "Triangulation.h"
+#include "VoxelCutting.h"
+#include "WorkerPool.h"
+
+#include <boost/bind.hpp>
+#include <fstream>
+#include <sstream>
+
+using namespace ci;
+using namespace core;
+namespace game { namespace terrain { namespace benchmarks {
+
+namespace {
+
+	const int
+		CutCount = 512,
+		CutLength = 48;
+
+	const int SnapshotCutCount = 32;
+
+	const unsigned int RandomSeed = 1234;
+
+	/**
+		Populate @a store from the RGB level image, using the same channel conventions and
+		y-axis flip as Island's initialization constructor. As with Island, only occupied voxels are allocated.
+	*/
+	void LoadStore( const Surface &constLevelImage, real scale, OrdinalVoxelStore &store )
+	{
+		Surface levelImage( constLevelImage );
+		store.set( levelImage.getWidth(), levelImage.getHeight(), scale );
+
+		const int extentY = levelImage.getHeight() - 1;
+		const uint8_t pixelInc = levelImage.getPixelInc();
+
+		for ( int y = 0; y < store.height(); y++ )
+		{
+			uint8_t *bytes = levelImage.getData( Vec2i( 0, extentY - y ));
+			for ( int x = 0; x < store.width(); x++, bytes += pixelInc )
+			{
+				if ( bytes[0] == 0 ) continue;
+			
+				Voxel *voxel = store.allocate(x,y);
+				voxel->occupation = bytes[0];
+				voxel->strength = bytes[1];
+				voxel->id = bytes[2];
+			}
+		}
+	}
+
+	struct cut_line {
+		Vec2r a, b;
+		Recti bounds;
+	};
+
+	void GenerateCuts( const Vec2i &size, real scale, real thickness, std::vector< cut_line > &cuts )
+	{
+		Rand rand( RandomSeed );
+		const int outset = int( std::ceil( thickness / scale )) + 1;
+
+		for ( int i = 0; i < CutCount; i++ )
+		{
+			Vec2r a( rand.nextFloat( size.x ), rand.nextFloat( size.y )),
+			      b( a + rand.nextVec2f() * CutLength );
+
+			cut_line cut;
+			cut.a = a * scale;
+			cut.b = b * scale;
+			cut.bounds.x1 = std::max( int( std::min( a.x, b.x )) - outset, 0 );
+			cut.bounds.y1 = std::max( int( std::min( a.y, b.y )) - outset, 0 );
+			cut.bounds.x2 = std::min( int( std::max( a.x, b.x )) + outset, size.x - 1 );
+			cut.bounds.y2 = std::min( int( std::max( a.y, b.y )) + outset, size.y - 1 );
+
+			cuts.push_back( cut );
+		}
+	}
+
+	struct occupied_voxel_test
+	{
+		inline bool operator()( Voxel *v ) const { return v && v->occupation >= MinimumVoxelOccupation; }
+	};
+
+	struct occupied_packed_voxel_test
+	{
+		const PackedVoxelStore &store;
+		occupied_packed_voxel_test( const PackedVoxelStore &s ):store(s){}
+
+		inline bool operator()( int i ) const { return i >= 0 && store.occupation(i) >= MinimumVoxelOccupation; }
+	};
+
+	const int LinkerRepetitions = 20;
+	const real LinkerVertexScale = 256;
+
+	/**
+		A marching squares segment, collected once so both linkers are timed against identical input
+	*/
+	struct linker_segment
+	{
+		Vec2i a, b;
+		int edgeA, edgeB;
+	};
+
+	struct linker_segment_collector
+	{
+		std::vector< linker_segment > &segments;
+		linker_segment_collector( std::vector< linker_segment > &s ):segments(s){}
+		
+		inline void operator()( int x, int y, const marching_squares::segment &seg )
+		{
+			linker_segment ls;
+			ls.a = Vec2i( lrintf( LinkerVertexScale * seg.a.x ), lrintf( LinkerVertexScale * seg.a.y ));
+			ls.b = Vec2i( lrintf( LinkerVertexScale * seg.b.x ), lrintf( LinkerVertexScale * seg.b.y ));
+			ls.edgeA = seg.edgeA;
+			ls.edgeB = seg.edgeB;
+			segments.push_back( ls );
+		}
+	};
+	
+	/**
+		Link by vertex through a std::map, as PerimeterGenerator does. Returns the number of loops.
+	*/
+	std::size_t MapLink( const std::vector< linker_segment > &segments, std::size_t &vertexCount )
+	{
+		typedef std::pair< Vec2i, Vec2i > Edge;
+		std::map< Vec2i, Edge, Vec2iComparator > edgesByFirstVertex;
+		
+		foreach( const linker_segment &s, segments )
+		{
+			if ( s.a != s.b ) edgesByFirstVertex[s.a] = Edge( s.a, s.b );
+		}
+		
+		std::size_t loops = 0;
+		while( !edgesByFirstVertex.empty() )
+		{
+			std::map< Vec2i, Edge, Vec2iComparator >::iterator it = edgesByFirstVertex.begin();
+			loops++;
+
+			while( it != edgesByFirstVertex.end() )
+			{
+				const Vec2i next = it->second.second;
+				edgesByFirstVertex.erase( it );
+				vertexCount++;
+				
+				it = edgesByFirstVertex.find( next );
+			}
+		}
+		
+		return loops;
+	}
+
+	/**
+		Link by cell edge id with edge_linker. Returns the number of loops.
+	*/
+	std::size_t EdgeIdLink( const std::vector< linker_segment > &segments, marching_squares::edge_linker &linker, std::size_t &vertexCount )
+	{
+		linker.clear();
+		foreach( const linker_segment &s, segments )
+		{
+			linker.add( s.edgeA, s.edgeB, s.a );
+		}
+		
+		std::vector< std::vector< Vec2i > > loops;
+		linker.link( loops );
+		
+		foreach( const std::vector< Vec2i > &loop, loops )
+		{
+			vertexCount += loop.size();
+		}
+		
+		return loops.size();
+	}
+
+	struct marking_visitor
+	{
+		std::vector< uint8_t > &seen;
+		int width;
+
+		marking_visitor( std::vector< uint8_t > &s, int w ):seen(s),width(w){}
+
+		inline bool operator()( Voxel *v ) { seen[ v->ordinalPosition.y * width + v->ordinalPosition.x ] = 1; return true; }
+		inline bool operator()( int i ) { seen[i] = 1; return true; }
+	};
+
+	const int LabelingRepetitions = 10;
+
+	// label @a store into @a labels, storing the component count in @a components; a WorkerPool job
+	void LabelStore( const PackedVoxelStore *store, std::vector< int > *labels, int *components )
+	{
+		occupied_packed_voxel_test test( *store );
+		*components = labeling::label( *store, test, *labels );
+	}
+
+}
+
+void VoxelStoreBenchmark( const ci::Surface &levelImage, real scale, std::ostream &out )
+{
+	OrdinalVoxelStore aos;
+	LoadStore( levelImage, scale, aos );
+
+	PackedVoxelStore soa;
+	soa.assign( aos );
+
+	const std::size_t count = std::size_t( aos.width() ) * std::size_t( aos.height() );
+
+	out << "VoxelStoreBenchmark - " << aos.width() << " x " << aos.height() << " (" << count << " voxels)" << std::endl;
+	out << "\tOrdinalVoxelStore bytes/voxel: " << sizeof( Voxel )
+	    << " dense MB: " << ( real( sizeof( Voxel ) * count ) / real( 1 << 20 ))
+	    << " allocated MB: " << ( real( aos.allocatedBytes() ) / real( 1 << 20 ))
+	    << " (" << aos.allocatedTileCount() << " of " << aos.tileCount() << " tiles)" << std::endl;
+	out << "\tPackedVoxelStore  bytes/voxel: " << PackedVoxelStore::bytesPerVoxel()
+	    << " total MB: " << ( real( PackedVoxelStore::bytesPerVoxel() * count ) / real( 1 << 20 )) << std::endl;
+
+	//
+	//	Line cuts - both stores visit the same ordinal rectangle for each cut, so we're measuring layout, not culling
+	//
+
+	const real
+		Thickness = 2 * scale,
+		Strength = 1,
+		VoxelRadius = scale * cutting::VoxelRadiusLocal,
+		MaxDist = (Thickness * 0.5) + VoxelRadius,
+		MinDist = (Thickness * 0.5) - VoxelRadius,
+		OneOverMaxMinusMin = 1.0 / ( MaxDist - MinDist ),
+		OneOverScale = 1 / scale;
+
+	std::vector< cut_line > cuts;
+	GenerateCuts( aos.size(), scale, Thickness, cuts );
+
+	Stopwatch timer;
+	unsigned int aosEffect = 0, soaEffect = 0;
+
+	timer.start();
+	foreach( const cut_line &cut, cuts )
+	{
+		// Voxel positions are ordinal, so the line and distances are scaled to ordinal space
+		util::line_segment line( cut.a * OneOverScale, cut.b * OneOverScale );
+		for ( int y = cut.bounds.y1; y <= cut.bounds.y2; y++ )
+		{
+			for ( int x = cut.bounds.x1; x <= cut.bounds.x2; x++ )
+			{
+				Voxel *v = aos.voxelAtUnsafe(x,y);
+				if ( v ) aosEffect |= cutting::LineVoxelCut( v, line, MinDist * OneOverScale, MaxDist * OneOverScale, OneOverMaxMinusMin * scale, Strength );
+			}
+		}
+	}
+	const seconds_t aosCutTime = timer.mark();
+
+	foreach( const cut_line &cut, cuts )
+	{
+		util::line_segment line( cut.a, cut.b );
+		for ( int y = cut.bounds.y1; y <= cut.bounds.y2; y++ )
+		{
+			for ( int x = cut.bounds.x1, i = soa.index( x, y ); x <= cut.bounds.x2; x++, i++ )
+			{
+				soaEffect |= cutting::LineVoxelCut( soa, i, Vec2r(x,y) * scale, line, MinDist, MaxDist, OneOverMaxMinusMin, Strength );
+			}
+		}
+	}
+	const seconds_t soaCutTime = timer.mark();
+
+	out << "\t" << cuts.size() << " line cuts - OrdinalVoxelStore: " << aosCutTime << "s PackedVoxelStore: " << soaCutTime
+	    << "s (" << ( aosCutTime / std::max( soaCutTime, seconds_t(1e-9))) << "x)"
+		<< ( aosEffect == soaEffect ? "" : " [EFFECT MISMATCH]" ) << std::endl;
+
+	//
+	//	Partition - flood fill every connected occupied region
+	//
+
+	std::vector< uint8_t > seen( count, 0 ), visited;
+	int aosRegions = 0, soaRegions = 0;
+
+	timer.start();
+	{
+		occupied_voxel_test test;
+		marking_visitor visitor( seen, aos.width() );
+		for ( int y = 0; y < aos.height(); y++ )
+		{
+			for ( int x = 0; x < aos.width(); x++ )
+			{
+				Voxel *v = aos.voxelAtUnsafe(x,y);
+				if ( !seen[ y * aos.width() + x ] && test(v) )
+				{
+					floodfill::visit( v, visitor, test );
+					aosRegions++;
+				}
+			}
+		}
+	}
+	const seconds_t aosPartitionTime = timer.mark();
+
+	seen.assign( count, 0 );
+	{
+		occupied_packed_voxel_test test( soa );
+		marking_visitor visitor( seen, soa.width() );
+		for ( int i = 0, N = soa.count(); i < N; i++ )
+		{
+			if ( !seen[i] && test(i) )
+			{
+				floodfill::visit( soa, i, visitor, test, visited );
+				soaRegions++;
+			}
+		}
+	}
+	const seconds_t soaPartitionTime = timer.mark();
+
+	out << "\tpartition - OrdinalVoxelStore: " << aosPartitionTime << "s (" << aosRegions << " regions) PackedVoxelStore: "
+	    << soaPartitionTime << "s (" << soaRegions << " regions) ("
+		<< ( aosPartitionTime / std::max( soaPartitionTime, seconds_t(1e-9))) << "x)" << std::endl;
+}
+
+void PerimeterLinkerBenchmark( const ci::Surface &constLevelImage, const Vec2i &sectorSize, std::ostream &out )
+{
+	namespace ms = marching_squares;
+	
+	Surface levelImage( constLevelImage );
+	const int 
+		width = levelImage.getWidth(), 
+		height = levelImage.getHeight(),
+		extentY = height - 1;
+
+	const Vec2i tileSize( sectorSize.x > 0 ? sectorSize.x : width, sectorSize.y > 0 ? sectorSize.y : height );
+	const uint8_t pixelInc = levelImage.getPixelInc();
+
+	//
+	//	March each sector once, with a one sample empty border as GatherIslandGrid does
+	//
+
+	std::vector< std::vector< linker_segment > > segmentsBySector;
+	std::size_t segmentCount = 0;
+	
+	for ( int sy = 0; sy < height; sy += tileSize.y )
+	{
+		for ( int sx = 0; sx < width; sx += tileSize.x )
+		{
+			const int 
+				w = std::min( tileSize.x, width - sx ),
+				h = std::min( tileSize.y, height - sy );
+				
+			ms::byte_grid grid;
+			grid.set( Vec2i( sx - 1, sy - 1 ), w + 2, h + 2 );
+
+			for ( int y = 0; y < h; y++ )
+			{
+				const uint8_t *bytes = levelImage.getData( Vec2i( sx, extentY - (sy + y) ));
+				for ( int x = 0; x < w; x++, bytes += pixelInc )
+				{
+					grid( x + 1, y + 1 ) = bytes[0];
+				}
+			}
+			
+			segmentsBySector.push_back( std::vector< linker_segment >() );
+			linker_segment_collector collector( segmentsBySector.back() );
+			ms::marchGrid< ms::isolevel<1,2> >( grid, collector );
+			segmentCount += segmentsBySector.back().size();
+		}
+	}
+	
+	out << "PerimeterLinkerBenchmark - " << segmentsBySector.size() << " sectors of " << tileSize.x << " x " << tileSize.y 
+	    << ", " << segmentCount << " segments, " << LinkerRepetitions << " repetitions" << std::endl;
+	
+	//
+	//	Time both linkers
+	//
+	
+	Stopwatch timer;
+	std::size_t mapLoops = 0, mapVertices = 0, edgeLoops = 0, edgeVertices = 0;
+	
+	timer.start();
+	for ( int r = 0; r < LinkerRepetitions; r++ )
+	{
+		foreach( const std::vector< linker_segment > &segments, segmentsBySector )
+		{
+			mapLoops += MapLink( segments, mapVertices );
+		}
+	}
+	const seconds_t mapTime = timer.mark();
+	
+	ms::edge_linker linker;
+	for ( int r = 0; r < LinkerRepetitions; r++ )
+	{
+		foreach( const std::vector< linker_segment > &segments, segmentsBySector )
+		{
+			edgeLoops += EdgeIdLink( segments, linker, edgeVertices );
+		}
+	}
+	const seconds_t edgeTime = timer.mark();
+	
+	out << "\tstd::map by vertex: " << mapTime << "s (" << mapLoops / LinkerRepetitions << " loops, " << mapVertices / LinkerRepetitions << " vertices)" << std::endl;
+	out << "\tedge_linker by cell edge id: " << edgeTime << "s (" << edgeLoops / LinkerRepetitions << " loops, " << edgeVertices / LinkerRepetitions << " vertices) ("
+	    << ( mapTime / std::max( edgeTime, seconds_t(1e-9))) << "x)" << std::endl;
+}
+
+void ComponentLabelingBenchmark( const ci::Surface &levelImage, real scale, std::ostream &out )
+{
+	//
+	//	Load the whole level as one island and split it with a long diagonal cut through both stores
+	//
+
+	OrdinalVoxelStore aos;
+	LoadStore( levelImage, scale, aos );
+
+	PackedVoxelStore soa;
+	soa.assign( aos );
+
+	const int count = soa.count();
+	const real
+		Thickness = 2 * scale,
+		VoxelRadius = scale * cutting::VoxelRadiusLocal,
+		MaxDist = (Thickness * 0.5) + VoxelRadius,
+		MinDist = (Thickness * 0.5) - VoxelRadius,
+		OneOverMaxMinusMin = 1.0 / ( MaxDist - MinDist );
+
+	util::line_segment 
+		cut( Vec2r( 0, 0 ), Vec2r( soa.width() - 1, soa.height() - 1 ) * scale ),
+		ordinalCut( Vec2r( 0, 0 ), Vec2r( soa.width() - 1, soa.height() - 1 ));
+
+	for ( int y = 0; y < soa.height(); y++ )
+	{
+		for ( int x = 0; x < soa.width(); x++ )
+		{
+			Voxel *v = aos.voxelAtUnsafe(x,y);
+			if ( v ) cutting::LineVoxelCut( v, ordinalCut, MinDist / scale, MaxDist / scale, OneOverMaxMinusMin * scale, 1 );
+			cutting::LineVoxelCut( soa, soa.index(x,y), Vec2r(x,y) * scale, cut, MinDist, MaxDist, OneOverMaxMinusMin, 1 );
+		}
+	}
+
+	out << "ComponentLabelingBenchmark - " << soa.width() << " x " << soa.height() << " (" << count << " voxels), split diagonally, "
+	    << LabelingRepetitions << " repetitions" << std::endl;
+
+	//
+	//	Flood fill from each unvisited occupied voxel, through Voxel pointers and through the packed store
+	//
+
+	Stopwatch timer;
+	std::vector< uint8_t > seen, visited;
+	int aosRegions = 0, soaRegions = 0;
+
+	timer.start();
+	for ( int r = 0; r < LabelingRepetitions; r++ )
+	{
+		seen.assign( count, 0 );
+		aosRegions = 0;
+
+		occupied_voxel_test test;
+		marking_visitor visitor( seen, aos.width() );
+		for ( int y = 0; y < aos.height(); y++ )
+		{
+			for ( int x = 0; x < aos.width(); x++ )
+			{
+				Voxel *v = aos.voxelAtUnsafe(x,y);
+				if ( !seen[ y * aos.width() + x ] && test(v) )
+				{
+					floodfill::visit( v, visitor, test );
+					aosRegions++;
+				}
+			}
+		}
+	}
+	const seconds_t aosFillTime = timer.mark();
+
+	for ( int r = 0; r < LabelingRepetitions; r++ )
+	{
+		seen.assign( count, 0 );
+		visited.clear();
+		soaRegions = 0;
+
+		occupied_packed_voxel_test test( soa );
+		marking_visitor visitor( seen, soa.width() );
+		for ( int i = 0; i < count; i++ )
+		{
+			if ( !seen[i] && test(i) )
+			{
+				floodfill::visit( soa, i, visitor, test, visited );
+				soaRegions++;
+			}
+		}
+	}
+	const seconds_t soaFillTime = timer.mark();
+
+	//
+	//	Label the packed store in one sweep
+	//
+
+	std::vector< int > labels;
+	int components = 0;
+
+	for ( int r = 0; r < LabelingRepetitions; r++ )
+	{
+		LabelStore( &soa, &labels, &components );
+	}
+	const seconds_t labelTime = timer.mark();
+
+	//
+	//	Label a copy of the store per pool thread at once, as partitioning does with several islands
+	//
+
+	WorkerPool pool;
+	const std::size_t concurrent = pool.threadCount() + 1;
+	std::vector< std::vector< int > > concurrentLabels( concurrent );
+	std::vector< int > concurrentComponents( concurrent, 0 );
+
+	timer.mark();
+	for ( int r = 0; r < LabelingRepetitions; r++ )
+	{
+		for ( std::size_t i = 0; i < concurrent; i++ )
+		{
+			pool.add( boost::bind( &LabelStore, &soa, &concurrentLabels[i], &concurrentComponents[i] ));
+		}
+
+		pool.wait();
+	}
+	const seconds_t concurrentLabelTime = timer.mark();
+
+	bool concurrentMatch = true;
+	for ( std::size_t i = 0; i < concurrent; i++ )
+	{
+		concurrentMatch = concurrentMatch && concurrentComponents[i] == components && concurrentLabels[i] == labels;
+	}
+
+	out << "\tfloodfill::visit OrdinalVoxelStore: " << aosFillTime << "s (" << aosRegions << " regions)" << std::endl;
+	out << "\tfloodfill::visit PackedVoxelStore: " << soaFillTime << "s (" << soaRegions << " regions)" << std::endl;
+	out << "\tlabeling::label PackedVoxelStore: " << labelTime << "s (" << components << " components) ("
+	    << ( aosFillTime / std::max( labelTime, seconds_t(1e-9))) << "x)"
+	    << ( components == aosRegions && components == soaRegions ? "" : " [COMPONENT COUNT MISMATCH]" ) << std::endl;
+	out << "\tlabeling::label x " << concurrent << " concurrently: " << concurrentLabelTime << "s ("
+	    << ( concurrentLabelTime / std::max( labelTime, seconds_t(1e-9))) << "x single store time)"
+	    << ( concurrentMatch ? "" : " [LABEL MISMATCH]" ) << std::endl;
+}
+
+void SnapshotBenchmark( Terrain *terrain, std::ostream &out )
+{
+	const Vec2i size = terrain->size();
+	const real scale = terrain->voxelStore().scale(), Thickness = 2 * scale;
+	const std::size_t rawBytes = std::size_t( size.x ) * size.y * 4;
+
+	std::vector< cut_line > cuts;
+	GenerateCuts( size, scale, Thickness, cuts );
+	cuts.resize( SnapshotCutCount );
+
+	out << "SnapshotBenchmark - " << size.x << " x " << size.y << " (" << rawBytes << " bytes of raw voxel planes), "
+	    << terrain->allIslands().size() << " islands" << std::endl;
+
+	//
+	//	Snapshot as it stands, then after cutting
+	//
+
+	Stopwatch timer;
+	terrain_snapshot initial, cut;
+
+	timer.start();
+	terrain->snapshot( initial );
+	const seconds_t initialSnapshotTime = timer.mark();
+
+	foreach( const cut_line &line, cuts )
+	{
+		terrain->cutLine( line.a, line.b, Thickness, 1, TerrainCutType::MANUAL );
+	}
+
+	timer.mark();
+	terrain->snapshot( cut );
+	const seconds_t cutSnapshotTime = timer.mark();
+	const std::size_t cutIslandCount = terrain->allIslands().size();
+
+	//
+	//	Restore each; snapshot() above completed the cuts' repartitioning, so only restoration is timed
+	//
+
+	const bool restoredInitial = terrain->restore( initial );
+	const seconds_t initialRestoreTime = timer.mark();
+
+	const bool restoredCut = terrain->restore( cut );
+	const seconds_t cutRestoreTime = timer.mark();
+	const bool cutIslandsMatch = terrain->allIslands().size() == cutIslandCount;
+
+	terrain->restore( initial );
+
+	out << "\tinitial: " << initial.size() << " bytes (" << ( double( rawBytes ) / std::max< std::size_t >( initial.size(), 1 )) << "x smaller), "
+	    << "snapshot " << initialSnapshotTime << "s, restore " << initialRestoreTime << "s"
+	    << ( restoredInitial ? "" : " [RESTORE FAILED]" ) << std::endl;
+	out << "\tafter " << cuts.size() << " cuts: " << cut.size() << " bytes (" << ( double( rawBytes ) / std::max< std::size_t >( cut.size(), 1 )) << "x smaller), "
+	    << "snapshot " << cutSnapshotTime << "s, restore " << cutRestoreTime << "s"
+	    << ( restoredCut ? "" : " [RESTORE FAILED]" ) << ( cutIslandsMatch ? "" : " [ISLAND COUNT MISMATCH]" ) << std::endl;
+}
+
+namespace {
+
+	const int TriangulationRepetitions = 1000;
+
+	/**
+		A set of loops to triangulate, and the area they should cover
+	*/
+	struct triangulation_case
+	{
+		std::string name;
+		std::vector< Vec2rVec > loops;
+		double area;
+		
+		triangulation_case( const std::string &n, double a ):
+			name( n ),
+			area( a )
+		{}
+		
+		triangulation_case &loop( const real *xy, std::size_t count )
+		{
+			loops.push_back( Vec2rVec() );
+			for ( std::size_t i = 0; i < count; i++ )
+			{
+				loops.back().push_back( Vec2r( xy[ 2*i ], xy[ 2*i + 1 ] ));
+			}
+			
+			return *this;
+		}
+	};
+	
+	double TrianglesArea( const Vec2rVec &triangles )
+	{
+		double area = 0;
+		for ( std::size_t i = 0, N = triangles.size(); i + 2 < N; i += 3 )
+		{
+			const Vec2r ab = triangles[i+1] - triangles[i], ac = triangles[i+2] - triangles[i];
+			area += std::abs( ab.x * ac.y - ab.y * ac.x ) * 0.5;
+		}
+		
+		return area;
+	}
+
+	/**
+		Triangulate @a loops as Island falls back to doing when util::triangulation rejects them
+	*/
+	void TriangulateCinder( const std::vector< Vec2rVec > &loops, Vec2rVec &triangles )
+	{
+		Triangulator triangulator;
+		foreach( const Vec2rVec &loop, loops )
+		{
+			Path2d path;
+			path.moveTo( loop.front() );
+			for( Vec2rVec::const_iterator it( loop.begin() + 1 ), end( loop.end()); it != end; ++it )
+			{
+				path.lineTo( *it );
+			}
+
+			path.close();
+			triangulator.addPath( path, 1 );
+		}
+
+		TriMesh2d mesh( triangulator.calcMesh( Triangulator::WINDING_POSITIVE ));
+		for ( std::size_t i = 0, N = mesh.getNumTriangles(); i < N; i++ )
+		{
+			ci::Vec2f a,b,c;
+			mesh.getTriangleVertices( i, &a, &b, &c );
+
+			triangles.push_back( a );
+			triangles.push_back( b );
+			triangles.push_back( c );
+		}
+	}
+
+}
+
+void TriangulationBenchmark( std::ostream &out )
+{
+	//
+	//	Each case's area is that of its outer boundaries less their holes. The bowtie crosses itself, so
+	//	util::triangulation must reject it; cinder's positive winding rule then fills only its counter-clockwise lobe.
+	//
+
+	const real
+		outer[] = { 0,0, 64,0, 64,64, 0,64 },
+		hole[] = { 16,16, 16,48, 48,48, 48,16 },
+		islandInHole[] = { 24,24, 40,24, 40,40, 24,40 },
+		touching[] = { 0,0, 32,0, 32,32, 64,32, 64,64, 32,64, 32,32, 0,32 },
+		bowtie[] = { 0,0, 64,64, 64,0, 0,64 };
+
+	std::vector< triangulation_case > cases;
+	cases.push_back( triangulation_case( "holed square", 64*64 - 32*32 ).loop( outer, 4 ).loop( hole, 4 ));
+	cases.push_back( triangulation_case( "island in hole", 64*64 - 32*32 + 16*16 ).loop( outer, 4 ).loop( hole, 4 ).loop( islandInHole, 4 ));
+	cases.push_back( triangulation_case( "self-touching", 2 * 32*32 ).loop( touching, 8 ));
+	cases.push_back( triangulation_case( "self-crossing bowtie", 32*32 ).loop( bowtie, 4 ));
+
+	out << "TriangulationBenchmark - " << cases.size() << " cases, " << TriangulationRepetitions << " repetitions" << std::endl;
+
+	Stopwatch timer;
+	foreach( const triangulation_case &c, cases )
+	{
+		//
+		//	Triangulate as Island does, falling back to cinder when util::triangulation rejects the loops
+		//
+
+		Vec2rVec triangles;
+		const bool monotone = util::triangulation::triangulate( c.loops, triangles );
+		if ( !monotone ) TriangulateCinder( c.loops, triangles );
+
+		const double area = TrianglesArea( triangles ), error = std::abs( area - c.area ) / c.area;
+
+		//
+		//	Time both triangulators
+		//
+
+		Vec2rVec scratch;
+		timer.start();
+		for ( int r = 0; r < TriangulationRepetitions; r++ )
+		{
+			scratch.clear();
+			util::triangulation::triangulate( c.loops, scratch );
+		}
+		const seconds_t monotoneTime = timer.mark();
+
+		for ( int r = 0; r < TriangulationRepetitions; r++ )
+		{
+			scratch.clear();
+			TriangulateCinder( c.loops, scratch );
+		}
+		const seconds_t cinderTime = timer.mark();
+
+		out << "\t" << c.name << ": " << ( monotone ? "util::triangulation" : "cinder fallback" ) << ", " << triangles.size() / 3 << " triangles, "
+		    << "area " << area << " of " << c.area << ( error > 1e-4 ? " [AREA MISMATCH]" : "" ) << std::endl;
+		out << "\t\tutil::triangulation " << monotoneTime << "s, cinder " << cinderTime << "s ("
+		    << ( cinderTime / std::max( monotoneTime, seconds_t(1e-9))) << "x)" << std::endl;
+	}
+}
+
+namespace {
+
+	void WriteVec2( std::ostream &out, const Vec2r &v )
+	{
+		out << "{ \"x\" : " << v.x << ", \"y\" : " << v.y << " }";
+	}
+	
+	void WriteVec2( std::ostream &out, const Vec2i &v )
+	{
+		out << "{ \"x\" : " << v.x << ", \"y\" : " << v.y << " }";
+	}
+
+}
+
+void WriteCutRecording( const std::vector< recorded_cut > &cuts, std::ostream &out )
+{
+	const std::streamsize precision = out.precision( 17 );
+
+	out << "{" << std::endl << "\t\"cuts\" : [" << std::endl;
+	
+	for ( std::size_t i = 0, N = cuts.size(); i < N; i++ )
+	{
+		const recorded_cut &cut = cuts[i];
+
+		out << "\t\t{ \"type\" : \"" << recorded_cut::typeName( cut.type ) << "\""
+		    << ", \"time\" : " << cut.time
+		    << ", \"start\" : "; WriteVec2( out, cut.start );
+		out << ", \"end\" : "; WriteVec2( out, cut.end );
+		out << ", \"size\" : " << cut.size
+		    << ", \"strength\" : " << cut.strength
+		    << ", \"cutType\" : " << int( cut.cutType )
+		    << ", \"restrictToIsland\" : "; WriteVec2( out, cut.restrictToIsland );
+		out << ", \"cuttingIsland\" : "; WriteVec2( out, cut.cuttingIsland );
+		out << ", \"poses\" : [";
+
+		for ( std::size_t j = 0, M = cut.poses.size(); j < M; j++ )
+		{
+			const recorded_group_pose &pose = cut.poses[j];
+			out << ( j > 0 ? ", " : " " ) << "{ \"island\" : "; WriteVec2( out, pose.island );
+			out << ", \"position\" : "; WriteVec2( out, pose.position );
+			out << ", \"angle\" : " << pose.angle << " }";
+		}
+
+		out << ( cut.poses.empty() ? "]" : " ]" ) << " }" << ( i + 1 < N ? "," : "" ) << std::endl;
+	}
+
+	out << "\t]" << std::endl << "}" << std::endl;
+	out.precision( precision );
+}
+
+void ReadCutRecording( const ci::JsonTree &json, std::vector< recorded_cut > &cuts )
+{
+	const ci::JsonTree CutsArray = json["cuts"];
+	for ( ci::JsonTree::ConstIter child(CutsArray.begin()),end(CutsArray.end()); child != end; ++child )
+	{
+		recorded_cut cut;
+		cut.initialize( *child );
+		cuts.push_back( cut );
+	}
+}
+
+namespace {
+
+	/**
+		Greeble every island, as drawing them all at @a zoom would after a geometry update
+	*/
+	void GreebleIslands( Terrain *terrain, real zoom )
+	{
+		foreach( Island *island, terrain->allIslands() )
+		{
+			island->updatePerimeterGreebling( zoom );
+		}
+	}
+
+}
+
+void CutReplayBenchmark( Terrain *terrain, const std::vector< recorded_cut > &cuts, std::ostream &out )
+{
+	const Vec2i size = terrain->size();
+	const bool restored = terrain->restore( terrain->loadedState() );
+	const real zoom = terrain->level()->camera().zoom();
+
+	GreebleIslands( terrain, zoom );
+	terrain->resetPhaseTimings();
+
+	std::size_t counts[3] = { 0, 0, 0 }, effective = 0;
+	seconds_t pendingSince = -1;
+
+	Stopwatch timer;
+	
+	foreach( const recorded_cut &cut, cuts )
+	{
+		//
+		//	In play, updateGeometry partitions once the deferral time has passed since the first cut awaiting it
+		//
+	
+		if ( pendingSince >= 0 && cut.time - pendingSince >= terrain->geometryUpdateDeferralTime() )
+		{
+			terrain->completeGeometryUpdates();
+			GreebleIslands( terrain, zoom );
+			pendingSince = -1;
+		}
+		
+		const unsigned int result = terrain->replayCut( cut );
+		
+		counts[ cut.type ]++;
+		if ( result ) effective++;
+		
+		if (( result & ( Terrain::CUT_AFFECTED_VOXELS | Terrain::CUT_AFFECTED_ISLAND_CONNECTIVITY )) && pendingSince < 0 )
+		{
+			pendingSince = cut.time;
+		}
+	}
+	
+	terrain->completeGeometryUpdates();
+	GreebleIslands( terrain, zoom );
+
+	const seconds_t elapsed = timer.mark();
+	const terrain_phase_timings &phases = terrain->phaseTimings();
+
+	out << "{" << std::endl
+	    << "\t\"benchmark\" : \"CutReplay\"," << std::endl
+	    << "\t\"size\" : "; WriteVec2( out, size ); 
+	out << "," << std::endl
+	    << "\t\"restored\" : " << ( restored ? "true" : "false" ) << "," << std::endl
+	    << "\t\"cuts\" : { \"line\" : " << counts[ recorded_cut::LINE ] 
+	    << ", \"disk\" : " << counts[ recorded_cut::DISK ]
+	    << ", \"terrain\" : " << counts[ recorded_cut::TERRAIN ]
+	    << ", \"effective\" : " << effective << " }," << std::endl
+	    << "\t\"elapsed\" : " << elapsed << "," << std::endl
+	    << "\t\"phases\" : {" << std::endl
+	    << "\t\t\"cutApplication\" : " << phases.cutApplication << "," << std::endl
+	    << "\t\t\"partition\" : " << phases.partition << "," << std::endl
+	    << "\t\t\"perimeters\" : " << phases.perimeters << "," << std::endl
+	    << "\t\t\"triangulation\" : " << phases.triangulation << "," << std::endl
+	    << "\t\t\"greebling\" : " << phases.greebling << "," << std::endl
+	    << "\t\t\"collisionPolygons\" : " << phases.collisionPolygons << "," << std::endl
+	    << "\t\t\"collisionShapes\" : " << phases.collisionShapes << std::endl
+	    << "\t}," << std::endl
+	    << "\t\"partitions\" : " << phases.partitions << "," << std::endl
+	    << "\t\"islandsPrepared\" : " << phases.islandsPrepared << "," << std::endl
+	    << "\t\"islands\" : " << terrain->allIslands().size() << std::endl
+	    << "}" << std::endl;
+}
+
+bool ReplayCutRecordingFile( Terrain *terrain, const ci::fs::path &recordingPath, const ci::fs::path &resultsPath, std::ostream &log )
+{
+	std::vector< recorded_cut > cuts;
+
+	try
+	{
+		ReadCutRecording( ci::JsonTree( loadFile( recordingPath )), cuts );
+	}
+	catch( std::exception &e )
+	{
+		log << "Unable to read cut recording " << recordingPath << " ERROR: " << e.what() << std::endl;
+		return false;
+	}
+
+	std::stringstream results;
+	CutReplayBenchmark( terrain, cuts, results );
+	log << results.str();
+
+	std::ofstream resultsFile( resultsPath.string().c_str() );
+	resultsFile << results.str();
+
+	if ( !resultsFile )
+	{
+		log << "Unable to write replay results to " << resultsPath << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+}}} // end namespace game::terrain::benchmarks
@@ -0,0 +1,92 @@
+#pragma once
+
+//
+//  TerrainBenchmarks.h
+//  Surfacer
+//
+//  Created by Shamyl Zakariya on 10/17/12.
+//  Copyright 2012 TomorrowPlusX. All rights reserved.
+//
+
+#include "Terrain.h"
+
+#include <iostream>
+
+namespace game { namespace terrain { namespace benchmarks {
+
+/**
+	Compare the OrdinalVoxelStore ( array-of-structs ) and PackedVoxelStore ( struct-of-arrays ) voxel layouts.
+	Both stores are populated from @a levelImage, and the benchmark reports bytes per voxel, then times a fixed,
+	seeded sequence of line cuts and a full partition ( flood fill of every connected region ) against each.
+
+	Results are written to @a out.
+*/
+void VoxelStoreBenchmark( const ci::Surface &levelImage, real scale, std::ostream &out );
+
+/**
+	Compare linking marching squares segments into perimeters by vertex, through a std::map ( as PerimeterGenerator does ), 
+	against linking by cell edge id with marching_squares::edge_linker. The occupation of @a levelImage is marched 
+	in @a sectorSize tiles, as Terrain partitions it into Islands, and each tile's segments are linked repeatedly by both.
+
+	Results are written to @a out.
+*/
+void PerimeterLinkerBenchmark( const ci::Surface &levelImage, const Vec2i &sectorSize, std::ostream &out );
+
+/**
+	Compare partitioning by flood fill against two-pass union-find labeling with labeling::label. All of @a levelImage
+	is loaded as a single island and split by a long diagonal cut, then its components are found by floodfill::visit
+	over both voxel stores, and by labeling::label over the PackedVoxelStore, alone and several at once on a WorkerPool.
+
+	Results are written to @a out.
+*/
+void ComponentLabelingBenchmark( const ci::Surface &levelImage, real scale, std::ostream &out );
+
+/**
+	Measure Terrain::snapshot and Terrain::restore against the live @a terrain. The terrain is snapshotted as it stands,
+	cut by a seeded set of lines and snapshotted again, and then restored to each snapshot in turn, ending as it started.
+	Reports each snapshot's encoded size against the raw size of its voxel planes, and the time to capture and restore it.
+
+	Results are written to @a out.
+*/
+void SnapshotBenchmark( Terrain *terrain, std::ostream &out );
+
+/**
+	Check and time util::triangulation::triangulate against a holed square, an island within a hole, a self-touching
+	loop and a self-crossing one. Each is triangulated as Island does, falling back to cinder's triangulator when
+	util::triangulation rejects the loops, and the sum of the triangles' areas is checked against the area of the
+	outer boundaries less their holes. Both triangulators are then timed on each case.
+
+	Results are written to @a out.
+*/
+void TriangulationBenchmark( std::ostream &out );
+
+/**
+	Write @a cuts, as recorded by Terrain::setCutRecording, to @a out as JSON which ReadCutRecording reads back
+*/
+void WriteCutRecording( const std::vector< recorded_cut > &cuts, std::ostream &out );
+
+/**
+	Read cuts written by WriteCutRecording from @a json, appending them to @a cuts
+*/
+void ReadCutRecording( const ci::JsonTree &json, std::vector< recorded_cut > &cuts );
+
+/**
+	Replay recorded @a cuts against @a terrain, restored to its loaded state, without any input, rendering or physics in 
+	the loop; Terrain::replayCut moves dynamic groups to the poses recorded with each cut instead.
+	Geometry updates are completed whenever the recorded time since the first cut awaiting one reaches the terrain's
+	deferral time, as they would be in play, and once more at the end. Every island is greebled at the level camera's zoom
+	after each geometry update, as if all were visible. Reports the elapsed time and the time spent in each
+	phase of cutting, geometry updates and greebling, per Terrain::phaseTimings.
+
+	Results are written to @a out as JSON. The terrain is left as the cuts left it.
+*/
+void CutReplayBenchmark( Terrain *terrain, const std::vector< recorded_cut > &cuts, std::ostream &out );
+
+/**
+	Read the cuts recorded to @a recordingPath by WriteCutRecording, replay them against @a terrain with CutReplayBenchmark,
+	and write its results to @a resultsPath, echoing them to @a log. Returns false, with the reason written to @a log, 
+	if the recording can't be read or the results can't be written.
+*/
+bool ReplayCutRecordingFile( Terrain *terrain, const ci::fs::path &recordingPath, const ci::fs::path &resultsPath, std::ostream &log );
+
+}}} // end namespace game::terrain::benchmarks
@@ -247,7 +247,6 @@ bool Sensor::_islandTriggers( terrain::Island *island )
 	bool someVoxelsMatch = false;
 
 	terrain::IslandGroup *group = island->group();
-	const Mat4r mv(group->modelview());
 	
 	for( std::vector< terrain::Voxel* >::const_iterator voxel(island->voxels().begin()), end( island->voxels().end()); voxel != end; ++voxel )
 	{
@@ -255,7 +254,7 @@ bool Sensor::_islandTriggers( terrain::Island *island )
 		if ( v->id == VoxelId )
 		{
 			someVoxelsMatch = true;
-			if ( cpShapePointQuery( _shape, cpv( mv * v->centroidRelativePosition )))
+			if ( cpShapePointQuery( _shape, cpv( group->worldPosition( v ))))
 			{
 				return true;
 			}
@@ -9,6 +9,7 @@
  *
  */
 
+#include <map>
 #include <cinder/Vector.h>
 #include "Common.h"
 #include "LineSegment.h"
@@ -179,4 +180,161 @@ namespace core { namespace util { namespace shape_optimization
 		dedup( collector, out, 1 );
 	}
 	
+	namespace detail {
+	
+		struct vec2_less
+		{
+			inline bool operator()( const Vec2r &a, const Vec2r &b ) const
+			{
+				return a.x < b.x || ( a.x == b.x && a.y < b.y );
+			}
+		};
+		
+		inline real turn( const Vec2r &a, const Vec2r &b, const Vec2r &c )
+		{
+			return ( b.x - a.x ) * ( c.y - b.y ) - ( b.y - a.y ) * ( c.x - b.x );
+		}
+	
+	}
+	
+	/**
+		Hertel-Mehlhorn convex partitioning. Merge the triangles of a triangulation into convex polygons by removing 
+		diagonals ( edges shared by two polygons ) whose removal leaves both of the diagonal's endpoints convex.
+		The result has at most four times the minimum possible number of convex pieces.
+		
+		@param triangles triangle vertices, three per triangle, all wound the same way. Vertices shared between triangles 
+			must be exactly equal, as they are when produced by a triangulator.
+		@param polygons receives the convex polygons, wound the same way as the triangles
+		@param maxVertices merges which would produce a polygon with more vertices than this are skipped
+	*/
+	inline void hertelMehlhorn( const Vec2rVec &triangles, std::vector< Vec2rVec > &polygons, std::size_t maxVertices = 8 )
+	{
+		typedef std::map< Vec2r, int, detail::vec2_less > VertexIndexMap;
+		typedef std::pair< int, int > Edge;
+		typedef std::map< Edge, Edge > EdgeOwnerMap;
+	
+		//
+		//	Index vertices, and make a ring of indices for each non-degenerate triangle
+		//
+		
+		const std::size_t triangleCount = triangles.size() / 3;
+		VertexIndexMap indices;
+		Vec2rVec vertices;
+		std::vector< std::vector< int > > rings;
+		rings.reserve( triangleCount );
+		
+		real winding = 0;
+		
+		for ( std::size_t t = 0; t < triangleCount; t++ )
+		{
+			int tri[3];
+			for ( int k = 0; k < 3; k++ )
+			{
+				const Vec2r &v = triangles[t*3+k];
+				VertexIndexMap::iterator pos = indices.find( v );
+				if ( pos == indices.end() )
+				{
+					pos = indices.insert( std::make_pair( v, int(vertices.size()) )).first;
+					vertices.push_back( v );
+				}
+
+				tri[k] = pos->second;
+			}
+			
+			const real turn = detail::turn( vertices[tri[0]], vertices[tri[1]], vertices[tri[2]] );
+			if ( turn == 0 ) continue;
+			if ( winding == 0 ) winding = turn > 0 ? 1 : -1;
+
+			rings.push_back( std::vector< int >( tri, tri + 3 ));
+		}
+		
+		//
+		//	Find the edges shared by two triangles - the diagonals
+		//
+		
+		EdgeOwnerMap owners;
+		for ( std::size_t r = 0, N = rings.size(); r < N; r++ )
+		{
+			for ( int k = 0; k < 3; k++ )
+			{
+				const int a = rings[r][k], b = rings[r][(k+1)%3];
+				const Edge edge( std::min(a,b), std::max(a,b) );
+				
+				EdgeOwnerMap::iterator pos = owners.find( edge );
+				if ( pos == owners.end() )
+				{
+					owners[edge] = Edge( int(r), -1 );
+				}
+				else
+				{
+					pos->second.second = int(r);
+				}
+			}
+		}
+		
+		//
+		//	Remove diagonals where possible. Merged rings are emptied, and point to the ring they were merged into.
+		//
+		
+		std::vector< int > mergedInto( rings.size() );
+		for ( std::size_t r = 0, N = rings.size(); r < N; r++ ) mergedInto[r] = int(r);
+		
+		for ( EdgeOwnerMap::const_iterator it( owners.begin()), end( owners.end()); it != end; ++it )
+		{
+			if ( it->second.second < 0 ) continue;
+			
+			int p = it->second.first, q = it->second.second;
+			while( mergedInto[p] != p ) p = mergedInto[p];
+			while( mergedInto[q] != q ) q = mergedInto[q];
+			if ( p == q ) continue;
+			
+			std::vector< int > &P = rings[p], &Q = rings[q];
+			const int nP = int(P.size()), nQ = int(Q.size());
+			if ( std::size_t( nP + nQ - 2 ) > maxVertices ) continue;
+
+			//
+			//	P runs x->y along the diagonal and Q runs y->x, since they're wound the same way
+			//
+
+			int i = 0, j = 0;
+			while( i < nP && !( ( P[i] == it->first.first || P[i] == it->first.second ) && 
+			                    ( P[(i+1)%nP] == it->first.first || P[(i+1)%nP] == it->first.second ))) i++;
+
+			const int x = P[i], y = P[(i+1)%nP];
+			while( j < nQ && !( Q[j] == y && Q[(j+1)%nQ] == x )) j++;
+			if ( i == nP || j == nQ ) continue;
+
+			//
+			//	Both diagonal endpoints must remain strictly convex
+			//
+			
+			if ( detail::turn( vertices[P[(i+nP-1)%nP]], vertices[x], vertices[Q[(j+2)%nQ]] ) * winding <= 0 ||
+			     detail::turn( vertices[Q[(j+nQ-1)%nQ]], vertices[y], vertices[P[(i+2)%nP]] ) * winding <= 0 )
+			{
+				continue;
+			}
+			
+			std::vector< int > merged;
+			merged.reserve( nP + nQ - 2 );
+			for ( int k = 1; k <= nP; k++ ) merged.push_back( P[(i+k)%nP] );
+			for ( int k = 2; k < nQ; k++ ) merged.push_back( Q[(j+k)%nQ] );
+
+			P.swap( merged );
+			Q.clear();
+			mergedInto[q] = p;
+		}
+		
+		foreach( const std::vector< int > &ring, rings )
+		{
+			if ( ring.empty() ) continue;
+		
+			polygons.push_back( Vec2rVec() );
+			polygons.back().reserve( ring.size() );
+			foreach( int v, ring )
+			{
+				polygons.back().push_back( vertices[v] );
+			}
+		}
+	}
+	
 }}} // end namespace core::util::shape_optimization
@@ -0,0 +1,634 @@
+//
+//  Triangulation.cpp
+//  Surfacer
+//
+//  Created by Shamyl Zakariya on 10/17/12.
+//  Copyright 2012 TomorrowPlusX. All rights reserved.
+//
+
+#include "Triangulation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+
+namespace core { namespace util { namespace triangulation {
+
+namespace {
+
+	/**
+		The sweep runs in a frame rotated by this many radians. Marching squares emits long axis-aligned runs,
+		and the rotation keeps them from putting whole rows of vertices at the same sweep height.
+	*/
+	const double SweepFrameRotation = 0.0137;
+
+	/**
+		The triangles must cover the loops' area to within this fraction, else the triangulation is rejected
+	*/
+	const double AreaTolerance = 1e-4;
+
+	enum vertex_type {
+		START,
+		END,
+		SPLIT,
+		MERGE,
+		REGULAR
+	};
+
+	struct vertex
+	{
+		Vec2r position;
+
+		// position in the sweep frame
+		double x, y;
+
+		// neighbors along the vertex's loop, which is wound so the interior is on the left
+		int prev, next;
+
+		vertex_type type;
+	};
+
+	typedef std::vector< vertex > VertexVec;
+
+	inline double cross( const vertex &o, const vertex &a, const vertex &b )
+	{
+		return ( a.x - o.x ) * ( b.y - o.y ) - ( a.y - o.y ) * ( b.x - o.x );
+	}
+
+	inline double signedArea( const Vec2rVec &loop )
+	{
+		double area = 0;
+		for ( std::size_t i = 0, N = loop.size(), j = N - 1; i < N; j = i++ )
+		{
+			area += double( loop[j].x ) * loop[i].y - double( loop[i].x ) * loop[j].y;
+		}
+
+		return area * 0.5;
+	}
+
+	inline bool contains( const Vec2rVec &loop, const Vec2r &point )
+	{
+		bool inside = false;
+		for ( std::size_t i = 0, N = loop.size(), j = N - 1; i < N; j = i++ )
+		{
+			const Vec2r &a = loop[i], &b = loop[j];
+			if (( a.y > point.y ) != ( b.y > point.y ) &&
+			    point.x < a.x + ( b.x - a.x ) * ( point.y - a.y ) / ( b.y - a.y ))
+			{
+				inside = !inside;
+			}
+		}
+
+		return inside;
+	}
+
+	/**
+		Copy @a loop to @a cleaned without repeated vertices, or spikes which double back on themselves
+	*/
+	void clean( const Vec2rVec &loop, Vec2rVec &cleaned )
+	{
+		cleaned.clear();
+		foreach( const Vec2r &v, loop )
+		{
+			if ( cleaned.empty() || cleaned.back() != v ) cleaned.push_back( v );
+		}
+
+		bool changed = true;
+		while( changed && cleaned.size() > 2 )
+		{
+			changed = false;
+			for ( std::size_t i = 0; i < cleaned.size() && cleaned.size() > 2; )
+			{
+				const std::size_t N = cleaned.size();
+				const Vec2r &p = cleaned[ ( i + N - 1 ) % N ], &v = cleaned[i], &n = cleaned[ ( i + 1 ) % N ];
+				const Vec2r in = v - p, out = n - v;
+
+				if ( p == n || v == n || ( in.x * out.y - in.y * out.x == 0 && in.dot( out ) < 0 ))
+				{
+					cleaned.erase( cleaned.begin() + i );
+					changed = true;
+				}
+				else
+				{
+					i++;
+				}
+			}
+		}
+
+		if ( cleaned.size() < 3 ) cleaned.clear();
+	}
+
+	/**
+		Strict total order of the sweep, which runs from top to bottom, then from left to right
+	*/
+	struct sweep_order
+	{
+		const VertexVec *vertices;
+
+		sweep_order( const VertexVec &v ):
+			vertices( &v )
+		{}
+
+		bool operator()( int a, int b ) const
+		{
+			const vertex &va = (*vertices)[a], &vb = (*vertices)[b];
+			if ( va.y != vb.y ) return va.y > vb.y;
+			if ( va.x != vb.x ) return va.x < vb.x;
+			return a < b;
+		}
+	};
+
+	/**
+		State of the sweep line, shared by the status comparator
+	*/
+	struct sweep_line
+	{
+		const VertexVec *vertices;
+		double y, probeX;
+
+		/**
+			x where the edge starting at vertex @a edge crosses height @a atY, or the probe's x for a negative @a edge
+		*/
+		double x( int edge, double atY ) const
+		{
+			if ( edge < 0 ) return probeX;
+
+			const vertex &a = (*vertices)[edge], &b = (*vertices)[ (*vertices)[edge].next ];
+			if ( a.y == b.y ) return std::max( a.x, b.x );
+
+			const double t = std::min( std::max(( a.y - atY ) / ( a.y - b.y ), 0.0 ), 1.0 );
+			return a.x + ( b.x - a.x ) * t;
+		}
+	};
+
+	/**
+		Orders the edges crossing the sweep line from left to right. Edges are identified by their upper vertex,
+		and -1 is a probe at the sweep line's probeX, for finding the edge left of a vertex.
+	*/
+	struct status_order
+	{
+		const sweep_line *line;
+
+		status_order( const sweep_line &l ):
+			line( &l )
+		{}
+
+		bool operator()( int a, int b ) const
+		{
+			const double xa = line->x( a, line->y ), xb = line->x( b, line->y );
+			if ( xa != xb ) return xa < xb;
+			if ( a < 0 || b < 0 ) return false;
+
+			//
+			//	Edges meeting at the sweep line are ordered where they're still both defined, just below it
+			//
+
+			const VertexVec &v = *line->vertices;
+			const double below = std::max( v[ v[a].next ].y, v[ v[b].next ].y ),
+			             xaBelow = line->x( a, below ),
+			             xbBelow = line->x( b, below );
+
+			if ( xaBelow != xbBelow ) return xaBelow < xbBelow;
+			return a < b;
+		}
+	};
+
+	typedef std::set< int, status_order > Status;
+
+	struct neighbor
+	{
+		int vertex;
+		double angle;
+		bool traversable, visited;
+
+		bool operator < ( const neighbor &other ) const { return angle < other.angle; }
+	};
+
+	typedef std::vector< neighbor > NeighborVec;
+
+	/**
+		Plane sweep which adds diagonals splitting the polygon into y-monotone pieces, returning false
+		if the status becomes inconsistent ( which only happens if loops cross )
+	*/
+	bool makeMonotone( const VertexVec &vertices, const std::vector< int > &order, std::vector< std::pair< int, int > > &diagonals )
+	{
+		const int count = int(vertices.size());
+
+		sweep_line line;
+		line.vertices = &vertices;
+		line.y = 0;
+		line.probeX = 0;
+
+		Status status = Status( status_order( line ));
+		std::vector< Status::iterator > positions( count, status.end() );
+		std::vector< int > helpers( count, -1 );
+
+		foreach( int i, order )
+		{
+			const vertex &v = vertices[i];
+			line.y = v.y;
+			line.probeX = v.x;
+
+			const int incoming = v.prev;
+			int left = -1;
+
+			//
+			//	End, merge, and regular vertices on a left boundary finish their incoming edge
+			//
+
+			const bool leftBoundary = v.type == REGULAR && sweep_order( vertices )( v.prev, i );
+			if ( v.type == END || v.type == MERGE || leftBoundary )
+			{
+				if ( positions[incoming] == status.end() ) return false;
+
+				if ( vertices[ helpers[incoming] ].type == MERGE )
+				{
+					diagonals.push_back( std::make_pair( i, helpers[incoming] ));
+				}
+
+				status.erase( positions[incoming] );
+				positions[incoming] = status.end();
+			}
+
+			//
+			//	Split, merge and regular vertices on a right boundary update the edge to their left
+			//
+
+			if ( v.type == SPLIT || v.type == MERGE || ( v.type == REGULAR && !leftBoundary ))
+			{
+				Status::iterator it = status.lower_bound( -1 );
+				if ( it == status.begin() ) return false;
+
+				left = *(--it);
+
+				if ( v.type == SPLIT || vertices[ helpers[left] ].type == MERGE )
+				{
+					diagonals.push_back( std::make_pair( i, helpers[left] ));
+				}
+
+				helpers[left] = i;
+			}
+
+			//
+			//	Start, split, and regular vertices on a left boundary begin their outgoing edge
+			//
+
+			if ( v.type == START || v.type == SPLIT || leftBoundary )
+			{
+				positions[i] = status.insert( i ).first;
+				helpers[i] = i;
+			}
+		}
+
+		return status.empty();
+	}
+
+	/**
+		Triangulate the y-monotone polygon @a polygon, wound counter-clockwise, returning false if it isn't monotone
+	*/
+	bool triangulateMonotone( const VertexVec &vertices, const std::vector< int > &polygon, std::vector< int > &triangles )
+	{
+		const std::size_t count = polygon.size();
+		if ( count < 3 ) return false;
+
+		const sweep_order above( vertices );
+		std::size_t top = 0, bottom = 0;
+		for ( std::size_t i = 1; i < count; i++ )
+		{
+			if ( above( polygon[i], polygon[top] )) top = i;
+			if ( above( polygon[bottom], polygon[i] )) bottom = i;
+		}
+
+		//
+		//	Walking counter-clockwise from the top descends the left chain to the bottom. Merge the chains
+		//	into sweep order.
+		//
+
+		std::vector< int > sorted;
+		std::vector< bool > onLeft;
+		sorted.reserve( count );
+		onLeft.reserve( count );
+
+		std::size_t l = top, r = top;
+		sorted.push_back( polygon[top] );
+		onLeft.push_back( true );
+
+		for ( std::size_t n = 1; n < count; n++ )
+		{
+			const std::size_t nextLeft = ( l + 1 ) % count, nextRight = ( r + count - 1 ) % count;
+			const bool takeLeft = l != bottom && ( r == bottom || above( polygon[nextLeft], polygon[nextRight] ));
+
+			if ( takeLeft )
+			{
+				l = nextLeft;
+				sorted.push_back( polygon[l] );
+				onLeft.push_back( true );
+			}
+			else
+			{
+				r = nextRight;
+				sorted.push_back( polygon[r] );
+				onLeft.push_back( false );
+			}
+		}
+
+		for ( std::size_t n = 1; n < count; n++ )
+		{
+			if ( above( sorted[n], sorted[n-1] )) return false;
+		}
+
+		//
+		//	The standard stack walk - the stack holds a reflex chain awaiting the vertex which can see past it
+		//
+
+		std::vector< std::size_t > stack;
+		stack.push_back( 0 );
+		stack.push_back( 1 );
+
+		for ( std::size_t j = 2; j + 1 < count; j++ )
+		{
+			if ( onLeft[j] != onLeft[ stack.back() ] )
+			{
+				while( stack.size() > 1 )
+				{
+					const std::size_t a = stack.back();
+					stack.pop_back();
+
+					triangles.push_back( sorted[j] );
+					triangles.push_back( sorted[a] );
+					triangles.push_back( sorted[ stack.back() ] );
+				}
+
+				stack.clear();
+				stack.push_back( j - 1 );
+				stack.push_back( j );
+			}
+			else
+			{
+				std::size_t last = stack.back();
+				stack.pop_back();
+
+				while( !stack.empty() )
+				{
+					const double turn = cross( vertices[ sorted[j] ], vertices[ sorted[last] ], vertices[ sorted[ stack.back() ]] );
+					if ( onLeft[j] ? turn >= 0 : turn <= 0 ) break;
+
+					triangles.push_back( sorted[j] );
+					triangles.push_back( sorted[last] );
+					triangles.push_back( sorted[ stack.back() ] );
+
+					last = stack.back();
+					stack.pop_back();
+				}
+
+				stack.push_back( last );
+				stack.push_back( j );
+			}
+		}
+
+		//
+		//	The bottom vertex sees the whole remaining stack
+		//
+
+		const std::size_t j = count - 1;
+		while( stack.size() > 1 )
+		{
+			const std::size_t a = stack.back();
+			stack.pop_back();
+
+			triangles.push_back( sorted[j] );
+			triangles.push_back( sorted[a] );
+			triangles.push_back( sorted[ stack.back() ] );
+		}
+
+		return true;
+	}
+
+}
+
+bool triangulate( const std::vector< Vec2rVec > &loops, Vec2rVec &triangles )
+{
+	//
+	//	Drop degenerate loops, and record the bounds and area of the rest
+	//
+
+	std::vector< Vec2rVec > cleaned;
+	std::vector< double > areas;
+	std::vector< std::pair< Vec2r, Vec2r > > bounds;
+
+	foreach( const Vec2rVec &loop, loops )
+	{
+		Vec2rVec c;
+		clean( loop, c );
+
+		const double area = c.empty() ? 0 : signedArea( c );
+		if ( area == 0 ) continue;
+
+		Vec2r lo( c.front() ), hi( c.front() );
+		foreach( const Vec2r &v, c )
+		{
+			lo.x = std::min( lo.x, v.x ); lo.y = std::min( lo.y, v.y );
+			hi.x = std::max( hi.x, v.x ); hi.y = std::max( hi.y, v.y );
+		}
+
+		cleaned.push_back( Vec2rVec() );
+		cleaned.back().swap( c );
+		areas.push_back( area );
+		bounds.push_back( std::make_pair( lo, hi ));
+	}
+
+	if ( cleaned.empty() ) return false;
+
+	//
+	//	Classify by nesting depth, and build the vertex rings, with outer boundaries wound counter-clockwise
+	//	and holes clockwise so the interior is always on the left
+	//
+
+	const double sinRotation = std::sin( SweepFrameRotation ), cosRotation = std::cos( SweepFrameRotation );
+	const std::size_t loopCount = cleaned.size();
+
+	VertexVec vertices;
+	double totalArea = 0;
+
+	for ( std::size_t i = 0; i < loopCount; i++ )
+	{
+		int depth = 0;
+		for ( std::size_t j = 0; j < loopCount; j++ )
+		{
+			if ( j == i || std::abs( areas[j] ) <= std::abs( areas[i] )) continue;
+
+			if ( bounds[j].first.x <= bounds[i].first.x && bounds[j].first.y <= bounds[i].first.y &&
+			     bounds[j].second.x >= bounds[i].second.x && bounds[j].second.y >= bounds[i].second.y &&
+			     contains( cleaned[j], cleaned[i].front() ))
+			{
+				depth++;
+			}
+		}
+
+		const bool hole = depth % 2 == 1,
+		           reverse = hole == ( areas[i] > 0 );
+
+		totalArea += hole ? -std::abs( areas[i] ) : std::abs( areas[i] );
+
+		const Vec2rVec &loop = cleaned[i];
+		const int first = int(vertices.size()), N = int(loop.size());
+
+		for ( int k = 0; k < N; k++ )
+		{
+			vertex v;
+			v.position = loop[ reverse ? N - 1 - k : k ];
+			v.x = v.position.x * cosRotation - v.position.y * sinRotation;
+			v.y = v.position.x * sinRotation + v.position.y * cosRotation;
+			v.prev = first + ( k + N - 1 ) % N;
+			v.next = first + ( k + 1 ) % N;
+			v.type = REGULAR;
+
+			vertices.push_back( v );
+		}
+	}
+
+	if ( totalArea <= 0 ) return false;
+
+	//
+	//	Classify vertices, and sort them into sweep order
+	//
+
+	const int count = int(vertices.size());
+	const sweep_order above( vertices );
+	std::vector< int > order( count );
+
+	for ( int i = 0; i < count; i++ )
+	{
+		vertex &v = vertices[i];
+		const bool prevBelow = above( i, v.prev ), nextBelow = above( i, v.next );
+		const bool convex = cross( vertices[ v.prev ], v, vertices[ v.next ] ) > 0;
+
+		if ( prevBelow && nextBelow ) v.type = convex ? START : SPLIT;
+		else if ( !prevBelow && !nextBelow ) v.type = convex ? END : MERGE;
+		else v.type = REGULAR;
+
+		order[i] = i;
+	}
+
+	std::sort( order.begin(), order.end(), above );
+
+	std::vector< std::pair< int, int > > diagonals;
+	if ( !makeMonotone( vertices, order, diagonals )) return false;
+
+	//
+	//	Split into the monotone pieces by walking the faces of the planar graph of loops and diagonals.
+	//	Arriving at a vertex, the face continues along the next edge clockwise from the one arrived along.
+	//	Only loop edges in their own direction, and diagonals in either, have the interior on their left.
+	//
+
+	std::vector< NeighborVec > neighbors( count );
+	for ( int i = 0; i < count; i++ )
+	{
+		neighbor n = { vertices[i].next, 0, true, false };
+		neighbors[i].push_back( n );
+
+		n.vertex = vertices[i].prev;
+		n.traversable = false;
+		neighbors[i].push_back( n );
+	}
+
+	for ( std::size_t d = 0, N = diagonals.size(); d < N; d++ )
+	{
+		const int a = diagonals[d].first, b = diagonals[d].second;
+		bool duplicate = false;
+
+		foreach( const neighbor &n, neighbors[a] )
+		{
+			if ( n.vertex == b ) duplicate = true;
+		}
+
+		if ( !duplicate )
+		{
+			neighbor n = { b, 0, true, false };
+			neighbors[a].push_back( n );
+			n.vertex = a;
+			neighbors[b].push_back( n );
+		}
+	}
+
+	for ( int i = 0; i < count; i++ )
+	{
+		foreach( neighbor &n, neighbors[i] )
+		{
+			n.angle = std::atan2( vertices[ n.vertex ].y - vertices[i].y, vertices[ n.vertex ].x - vertices[i].x );
+		}
+
+		std::sort( neighbors[i].begin(), neighbors[i].end() );
+	}
+
+	std::vector< int > indices, polygon;
+	indices.reserve( ( count + 2 * diagonals.size() ) * 3 );
+
+	for ( int start = 0; start < count; start++ )
+	{
+		for ( std::size_t s = 0; s < neighbors[start].size(); s++ )
+		{
+			if ( !neighbors[start][s].traversable || neighbors[start][s].visited ) continue;
+
+			polygon.clear();
+			int from = start;
+			std::size_t slot = s;
+
+			do
+			{
+				neighbor &edge = neighbors[from][slot];
+				if ( !edge.traversable || edge.visited || polygon.size() > std::size_t(count) ) return false;
+
+				edge.visited = true;
+				polygon.push_back( from );
+
+				//
+				//	Find where we arrived from in the next vertex's neighbors, and turn clockwise
+				//
+
+				const int to = edge.vertex;
+				const NeighborVec &around = neighbors[to];
+				std::size_t back = 0;
+				while( back < around.size() && around[back].vertex != from ) back++;
+				if ( back == around.size() ) return false;
+
+				from = to;
+				slot = ( back + around.size() - 1 ) % around.size();
+			}
+			while( from != start || slot != s );
+
+			if ( !triangulateMonotone( vertices, polygon, indices )) return false;
+		}
+	}
+
+	//
+	//	Triangles which overlap, or leave gaps, won't sum to the loops' area
+	//
+
+	double triangulatedArea = 0;
+	for ( std::size_t i = 0, N = indices.size(); i < N; i += 3 )
+	{
+		triangulatedArea += std::abs( cross( vertices[ indices[i] ], vertices[ indices[i+1] ], vertices[ indices[i+2] ] )) * 0.5;
+	}
+
+	if ( std::abs( triangulatedArea - totalArea ) > AreaTolerance * totalArea ) return false;
+
+	triangles.reserve( triangles.size() + indices.size() );
+	for ( std::size_t i = 0, N = indices.size(); i < N; i += 3 )
+	{
+		//
+		//	Wind each counter-clockwise
+		//
+
+		const vertex &a = vertices[ indices[i] ], &b = vertices[ indices[i+1] ], &c = vertices[ indices[i+2] ];
+		const bool ccw = cross( a, b, c ) > 0;
+
+		triangles.push_back( a.position );
+		triangles.push_back( ccw ? b.position : c.position );
+		triangles.push_back( ccw ? c.position : b.position );
+	}
+
+	return true;
+}
+
+}}} // end namespace core::util::triangulation
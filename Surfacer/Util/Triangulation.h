@@ -0,0 +1,34 @@
+#pragma once
+
+//
+//  Triangulation.h
+//  Surfacer
+//
+//  Created by Shamyl Zakariya on 10/17/12.
+//  Copyright 2012 TomorrowPlusX. All rights reserved.
+//
+
+#include "Common.h"
+
+#include <vector>
+
+namespace core { namespace util { namespace triangulation {
+
+/**
+	Triangulate the region bounded by the closed polygons @a loops, appending three vertices per triangle,
+	wound counter-clockwise, to @a triangles.
+
+	Loops may be wound either way, and needn't repeat their first vertex. Each is classified by nesting: a loop
+	inside an even number of the others is an outer boundary, a loop inside an odd number is a hole in the loop
+	which directly encloses it. Loops must not cross themselves or each other.
+
+	The region is split into y-monotone pieces by a plane sweep, and each piece is triangulated in linear time,
+	so triangulation is O(n log n) in the total vertex count. Classifying loops adds one point-in-polygon test
+	per pair of loops whose bounds nest.
+
+	Returns false, leaving @a triangles untouched, if the loops are degenerate in a way the sweep can't resolve
+	- say, they cross - so the caller can fall back to a more forgiving triangulator.
+*/
+bool triangulate( const std::vector< Vec2rVec > &loops, Vec2rVec &triangles );
+
+}}} // end namespace core::util::triangulation
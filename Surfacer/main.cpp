@@ -8,6 +8,7 @@
 // Testing Scenarios
 
 #include "CuttingTestScenario.h"
+#include "CutReplayScenario.h"
 #include "LevelLoadingScenario.h"
 #include "MonsterPlaygroundScenario.h"
 #include "UIPlaygroundScenario.h"
@@ -42,6 +43,21 @@ class Main : public game::SurfacerApp
 		
 		void setup()
 		{
+			//
+			//	--replay <recording.json> <results.json> replays a cut recording without input, writes its results and quits
+			//
+
+			const std::vector< std::string > &args = getArgs();
+			for ( std::size_t i = 1; i + 2 < args.size(); i++ )
+			{
+				if ( args[i] == "--replay" )
+				{
+					setGameScenario( new CutReplayScenario( args[i+1], args[i+2] ));
+					SurfacerApp::setup();
+					return;
+				}
+			}
+
 			//setGameScenario( new CuttingTestScenario() );
 			//setGameScenario( new MonsterPlaygroundScenario() );
 			//setGameScenario( new UIPlaygroundScenario() );